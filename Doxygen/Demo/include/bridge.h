@@ -0,0 +1,106 @@
+/**
+ * @file include/bridge.h
+ * @brief Definition the serial bridge to services on another processor.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BRIDGE_H__
+#define __BRIDGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Byte stream port used by the bridge.
+ */
+typedef struct
+{
+    int32_t (* write)(void* ctx, const uint8_t* data, uint32_t len);                /**< Write all bytes, returns 0 or a negative error code. */
+    int32_t (* read)(void* ctx, uint8_t* data, uint32_t len, uint32_t timeout);     /**< Read up to len bytes, returns the count, 0 on timeout. */
+    void*   ctx;                                                                    /**< Port private data. */
+} bridge_port_t;
+
+/**
+ * @brief   Bridge statistics structure.
+ */
+typedef struct
+{
+    uint32_t    tx_frames;      /**< Frames sent. */
+    uint32_t    tx_messages;    /**< Messages sent. */
+    uint32_t    tx_bytes;       /**< Bytes written to the port, framing included. */
+    uint32_t    rx_frames;      /**< Valid frames received. */
+    uint32_t    rx_messages;    /**< Messages received. */
+    uint32_t    rx_errors;      /**< Frames dropped on CRC or format errors. */
+    uint32_t    rx_unknown;     /**< Messages for services that do not exist here. */
+    uint32_t    rx_dropped;     /**< Messages dropped on a full local queue. */
+} bridge_stats_t;
+
+/**
+ * @brief   Proxy of a service on the other processor.
+ */
+typedef struct
+{
+    uint32_t    hash;           /**< Hash of the service name, computed at probe. */
+} bridge_proxy_t;
+
+extern const service_transport_t bridge_transport;
+
+extern int32_t bridge_proxy_probe(const object* obj);
+extern int32_t bridge_start(const bridge_port_t* port);
+extern int32_t bridge_flush(void);
+extern int32_t bridge_get_stats(bridge_stats_t* stats);
+
+#ifdef __linux__
+/**
+ * @brief   File descriptor pair for the Linux port, e.g. a pipe or a pty.
+ */
+typedef struct
+{
+    int rfd;    /**< Descriptor to read from. */
+    int wfd;    /**< Descriptor to write to. */
+} bridge_fd_t;
+
+extern void bridge_port_fd_init(bridge_port_t* port, bridge_fd_t* fds);
+#endif
+
+/**
+ * Helper macro for a service on the other processor.
+ *
+ * The proxy has the same name as the remote service, object_get_binding()
+ * returns it like a local service and service_unicast_message() to it is
+ * carried over the bridge. Proxies do not receive local broadcasts.
+ */
+#define DECLARE_BRIDGE_SERVICE(service_name, service_label) \
+    static bridge_proxy_t __bridge_proxy_ ## service_label; \
+    static service_t __bridge_svc_ ## service_label = { \
+        .transport      = &bridge_transport, \
+        .transport_ctx  = &__bridge_proxy_ ## service_label }; \
+    module_service(service_name, \
+                   service_label, \
+                   bridge_proxy_probe, \
+                   NULL, \
+                   &service_intf, \
+                   &__bridge_svc_ ## service_label, \
+                   NULL)
+
+#endif /* __BRIDGE_H__ */
@@ -63,5 +63,6 @@
 #define EEMPTY      102 /**< Device buffer is empty */
 #define EFULL       103 /**< Device buffer is full */
 #define ENOCHANGE   104 /**< Data is not changed */
+#define ETIMEOUT    105 /**< Operation timed out */
 
 #endif /* __ERR_H__ */
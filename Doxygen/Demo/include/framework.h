@@ -33,6 +33,7 @@
 #include "version.h"
 #include "log.h"
 #include "message.h"
+#include "payload.h"
 #include "service.h"
 
 #endif /* __FRAMEWORK_H__ */
@@ -0,0 +1,104 @@
+/**
+ * @file include/interceptor.h
+ * @brief Definition the message interceptor chain.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INTERCEPTOR_H__
+#define __INTERCEPTOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Points of the message path where interceptors are called.
+ */
+typedef enum
+{
+    INTERCEPT_POINT_UNICAST = 0,    /**< service_unicast_message(), before enqueue. */
+    INTERCEPT_POINT_BROADCAST,      /**< service_broadcast_message() and service_multicast_message(), before the fan-out. */
+    INTERCEPT_POINT_DISPATCH,       /**< service_routine_thread(), before the message handler. */
+} intercept_point_e;
+
+/**
+ * @brief   Interceptor verdicts.
+ */
+typedef enum
+{
+    INTERCEPT_PASS = 0,             /**< Continue with the next interceptor, the message may have been modified. */
+    INTERCEPT_DROP,                 /**< Discard the message silently. */
+    INTERCEPT_REDIRECT,             /**< Unicast the message to the service stored in *svc instead, at dispatch never to the service itself. */
+} intercept_action_e;
+
+/**
+ * @brief   Interceptor hook.
+ *
+ * @param   point Where on the message path the hook is called.
+ * @param   svc Pointer to the destination service, NULL for broadcast.
+ *              Set it to a new destination and return INTERCEPT_REDIRECT to redirect.
+ * @param   message Pointer to a writable copy of the message, the id
+ *                  still carries the framework flags (MSG_ID_FLAGS_MASK).
+ *
+ * @retval  Returns the verdict for this message.
+ */
+typedef intercept_action_e (* intercept_fn)(intercept_point_e   point,
+                                            const service_t**   svc,
+                                            message_t*          message);
+
+/**
+ * @brief   Interceptor definitions.
+ */
+typedef struct
+{
+    const char* const   name;       /**< Interceptor name. */
+    int32_t             priority;   /**< Lower values run first. */
+    intercept_fn        hook;       /**< Point to the hook. */
+} interceptor_t;
+
+extern intercept_action_e interceptor_run(intercept_point_e point,
+                                          const service_t** svc,
+                                          message_t* message);
+
+#if CONFIG_INTERCEPTOR_ENABLE
+/** Helper macro for interceptor, placed in the module_interceptor section. */
+#define DECLARE_INTERCEPTOR(interceptor_name, \
+                            interceptor_label, \
+                            interceptor_priority, \
+                            hook_fn) \
+    static const interceptor_t __interceptor_def_ ## interceptor_label \
+    __attribute__((used, section("module_interceptor"))) = { \
+        .name       = (interceptor_name), \
+        .priority   = (interceptor_priority), \
+        .hook       = (hook_fn) }
+
+/** Run the interceptor chain. */
+#define INTERCEPTOR_RUN(point, svc, message) interceptor_run(point, svc, message)
+#else
+#define DECLARE_INTERCEPTOR(interceptor_name, \
+                            interceptor_label, \
+                            interceptor_priority, \
+                            hook_fn)
+#define INTERCEPTOR_RUN(point, svc, message) INTERCEPT_PASS
+#endif
+
+#endif /* __INTERCEPTOR_H__ */
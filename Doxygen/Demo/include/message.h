@@ -26,7 +26,47 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "framework_conf.h"
 
+#if CONFIG_MSG_DEADLINE_ENABLE && !CONFIG_MSG_LAYOUT_ALIGNED
+#error "CONFIG_MSG_DEADLINE_ENABLE needs CONFIG_MSG_LAYOUT_ALIGNED"
+#endif
+
+#if CONFIG_MSG_LAYOUT_ALIGNED
+/**
+ * @brief   Message structure definition, naturally aligned layout.
+ *
+ * Each message is 32 bytes, so every field is a single aligned word
+ * access. The 32 bytes alignment holds for the copies the application
+ * and the framework keep, e.g. on the stack or in arrays, not for the
+ * slots of a message queue: the RTOS lays these out, may add its own
+ * header per message and copies in and out without a cache line promise.
+ * The padding carries a send sequence number, the enqueue tick and the
+ * deadline tick, filled by the framework on the send path.
+ *
+ * ABI note: The layout differs from the packed one in size (32 vs 20
+ * bytes) and alignment, the offsets of id and param0..param3 are the
+ * same. Libraries and applications must be built with the same
+ * CONFIG_MSG_LAYOUT_ALIGNED value, and a message_t must never be
+ * exchanged as raw bytes with a peer built with the other layout.
+ */
+typedef struct
+{
+    uint32_t    id;         /**< Message identifier */
+
+    uint32_t    param0;     /**< Message param 0 */
+    uint32_t    param1;     /**< Message param 1 */
+    uint32_t    param2;     /**< Message param 2 */
+    uint32_t    param3;     /**< Message param 3 */
+
+    uint32_t    seq;        /**< Send sequence number, filled by the framework */
+    uint32_t    timestamp;  /**< Enqueue tick, filled by the framework */
+    uint32_t    deadline;   /**< Deadline tick, 0 for none, see msg_set_deadline() */
+} __attribute__((aligned(32))) message_t;
+
+_Static_assert(sizeof(message_t) == 32, "message_t must fill one 32 bytes slot");
+_Static_assert(_Alignof(message_t) == 32, "message_t must be 32 bytes aligned");
+#else
 /**
  * @brief   Message structure definition.
  */
@@ -40,6 +80,69 @@ typedef struct
     uint32_t    param3;     /**< Message param 3 */
 } __attribute__((packed)) message_t;
 
+_Static_assert(sizeof(message_t) == 20, "packed message_t must be 20 bytes");
+#endif
+
+_Static_assert(offsetof(message_t, id) == 0, "message_t id offset changed");
+_Static_assert(offsetof(message_t, param0) == 4, "message_t param0 offset changed");
+_Static_assert(offsetof(message_t, param3) == 16, "message_t param3 offset changed");
+
+/**
+ * @brief   Mask of the message id bits reserved for framework flags.
+ *
+ * The flags are set by the framework on the send path and stripped
+ * before the message reaches the service message handler.
+ */
+#define MSG_ID_FLAGS_MASK   0xFFFF0000
+
+/**
+ * @brief   The message carries a payload handle in param3.
+ *
+ * The receiving service drops its payload reference after the message
+ * handler returns, use @ref msg_get_payload to access the data.
+ */
+#define MSG_ID_FLAG_PAYLOAD 0x80000000
+
+/**
+ * @brief   The message is a request, the id carries its correlation tag.
+ *
+ * The message handler answers with @ref service_reply, see
+ * @ref service_request.
+ */
+#define MSG_ID_FLAG_REQUEST 0x40000000
+
+/**
+ * @brief   The message consumed a flow control credit, the id carries its channel.
+ *
+ * The credit returns to the producer after the message handler, see
+ * @ref service_credit_send.
+ */
+#define MSG_ID_FLAG_CREDIT  0x10000000
+
+/**
+ * @brief   The message is a stream notification, the id carries its stream.
+ *
+ * The stream is armed for the next notification after the message
+ * handler, see @ref service_stream_init.
+ */
+#define MSG_ID_FLAG_STREAM  0x20000000
+
+#ifndef DOC_HIDDEN
+/* Correlation tag of a request, in the framework flag bits. */
+#define MSG_ID_REQUEST_TAG_MASK     0x0FFF0000
+#define MSG_ID_REQUEST_TAG_SHIFT    16
+#define MSG_ID_REQUEST_TAG(id)      (((id) & MSG_ID_REQUEST_TAG_MASK) >> MSG_ID_REQUEST_TAG_SHIFT)
+
+/* Credit channel index, in the tag bits, never set along with MSG_ID_FLAG_REQUEST. */
+#define MSG_ID_CREDIT_CHANNEL(id)   MSG_ID_REQUEST_TAG(id)
+
+/* Stream index, in the tag bits, never set along with the other tagged flags. */
+#define MSG_ID_STREAM_INDEX(id)     MSG_ID_REQUEST_TAG(id)
+
+/* Flags naming a single receiver, a broadcast or multicast carrying one is refused. */
+#define MSG_ID_FLAGS_UNICAST        (MSG_ID_FLAG_REQUEST | MSG_ID_FLAG_CREDIT | MSG_ID_FLAG_STREAM)
+#endif
+
 #ifndef DOC_HIDDEN
 /* Notes: These macros are used internally, and we need to hide it in the document. */
 /* System type message */
@@ -82,6 +185,53 @@ typedef struct
  */
 #define MSG_ID_SYS_RUN_AUTOMATIC_TEST (MSG_ID_SYS_BASE | 0x02)
 
+/**
+ * @brief           Notify a message handler ran over its time budget.
+ *
+ * Sent to the services subscribed with service_watchdog_subscribe().
+ *
+ * Example:
+ * @code
+ *  message.id      MSG_ID_SYS_HANDLER_OVERRUN
+ *  message.param0  Index of the service in the module_service section.
+ *  message.param1  Message id being handled.
+ *  message.param2  Handler time in ms, so far if still running.
+ *  message.param3  Budget in ms.
+ * @endcode
+ */
+#define MSG_ID_SYS_HANDLER_OVERRUN (MSG_ID_SYS_BASE | 0x03)
+
+/**
+ * @brief           Notify a state slot changed, see service_state_subscribe().
+ *
+ * Example:
+ * @code
+ *  message.id      MSG_ID_SYS_STATE_CHANGED
+ *  message.param0  service_state_id_e.
+ *  message.param1  Version written.
+ *  message.param2  None.
+ *  message.param3  None.
+ * @endcode
+ */
+#define MSG_ID_SYS_STATE_CHANGED (MSG_ID_SYS_BASE | 0x04)
+
+/**
+ * @brief           Wake the coroutines of a service, an await timed out.
+ *
+ * Sent by the service thread to itself, feed it to the coroutines with
+ * service_co_feed().
+ *
+ * Example:
+ * @code
+ *  message.id      MSG_ID_SYS_CO_TIMEOUT
+ *  message.param0  None.
+ *  message.param1  None.
+ *  message.param2  None.
+ *  message.param3  None.
+ * @endcode
+ */
+#define MSG_ID_SYS_CO_TIMEOUT (MSG_ID_SYS_BASE | 0x05)
+
 /**
  * @brief           Set LED type.
  *
@@ -182,5 +332,14 @@ typedef struct
 
 extern const char* msg_id_to_str(uint32_t id);
 extern int32_t msg_sys_startup_completed(void);
+extern void* msg_get_payload(const message_t* message);
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+extern int32_t msg_id_to_signal(uint32_t id);
+extern uint32_t msg_signal_to_id(uint32_t bit);
+#endif
+#if CONFIG_MSG_DEADLINE_ENABLE
+extern uint32_t msg_id_to_ttl(uint32_t id);
+extern void msg_set_deadline(message_t* message, uint32_t ttl_ms);
+#endif
 
 #endif /* __MESSAGE_H__ */
@@ -0,0 +1,66 @@
+/**
+ * @file include/payload.h
+ * @brief Definition the message payload pool.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PAYLOAD_H__
+#define __PAYLOAD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   Invalid payload handle.
+ */
+#define PAYLOAD_HANDLE_INVALID 0
+
+/**
+ * @brief   Payload pool size classes.
+ */
+typedef enum
+{
+    PAYLOAD_CLASS_SMALL = 0,    /**< Small blocks, CONFIG_PAYLOAD_SMALL_SIZE bytes. */
+    PAYLOAD_CLASS_MEDIUM,       /**< Medium blocks, CONFIG_PAYLOAD_MEDIUM_SIZE bytes. */
+    PAYLOAD_CLASS_LARGE,        /**< Large blocks, CONFIG_PAYLOAD_LARGE_SIZE bytes. */
+    PAYLOAD_CLASS_NUM,
+} payload_class_e;
+
+/**
+ * @brief   Payload pool statistics structure.
+ */
+typedef struct
+{
+    uint32_t    block_size;     /**< Usable bytes of each block. */
+    uint32_t    block_count;    /**< Number of blocks in the class. */
+    uint32_t    used;           /**< Blocks currently allocated. */
+    uint32_t    peak;           /**< Highest number of blocks allocated at once. */
+    uint32_t    failed;         /**< Allocations that found the class exhausted. */
+} payload_stats_t;
+
+extern void* payload_alloc(uint32_t size);
+extern void payload_ref(void* payload);
+extern void payload_release(void* payload);
+extern uint32_t payload_get_size(const void* payload);
+extern uint32_t payload_to_handle(const void* payload);
+extern void* payload_from_handle(uint32_t handle);
+extern int32_t payload_get_stats(payload_class_e cls, payload_stats_t* stats);
+
+#endif /* __PAYLOAD_H__ */
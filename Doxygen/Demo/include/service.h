@@ -27,11 +27,49 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "cmsis_os.h"
+#include "framework_conf.h"
 #include "object.h"
 
 struct _service_t;
 typedef struct _service_t service_t;
 
+#ifndef DOC_HIDDEN
+/* Services reached through a transport instead of a queue. */
+#define SERVICE_TRANSPORT_ENABLE (CONFIG_TRANSPORT_SHM_ENABLE || CONFIG_BRIDGE_ENABLE)
+
+/* Features selected by the service_config_t flags, SERVICE_FLAG_xxx. */
+#define SERVICE_FLAGS_ENABLE (CONFIG_TRANSPORT_SHM_ENABLE || \
+                              CONFIG_SERVICE_REPLICA_ENABLE || \
+                              CONFIG_MSG_DEADLINE_ENABLE || \
+                              CONFIG_SERVICE_POOL_ENABLE)
+
+/* The transport and the pool queue of a handle, NULL when compiled out. */
+#if SERVICE_TRANSPORT_ENABLE
+#define SERVICE_TRANSPORT(svc) ((svc)->transport)
+#else
+#define SERVICE_TRANSPORT(svc) ((const service_transport_t*)NULL)
+#endif
+
+#if CONFIG_SERVICE_POOL_ENABLE
+#define SERVICE_POOL(svc) ((svc)->pool)
+#else
+#define SERVICE_POOL(svc) ((void*)NULL)
+#endif
+#endif
+
+/**
+ * @brief   Service transport definitions.
+ *
+ * A transport replaces the RTOS message queue of a service, for example
+ * to reach a service that lives in another process.
+ */
+typedef struct
+{
+    osStatus_t (* put)(const service_t* svc, const message_t* message, uint32_t timeout);  /**< Deliver a message to the service. */
+    message_t* (* get)(const service_t* svc, uint32_t timeout);                            /**< Wait for the next message, the slot is used in place. */
+    void (* release)(const service_t* svc, message_t* message);                            /**< Give back the slot returned by get. */
+} service_transport_t;
+
 /**
  * @brief   Service handle definitions.
  */
@@ -41,6 +79,45 @@ typedef struct _service_t
     osThreadId_t        thread_id;                                                  /**< Thread id. */
     osMessageQueueId_t  queue_id;                                                   /**< Queue id. */
     void*               priv;                                                       /**< Point to the private data. */
+#if CONFIG_SERVICE_STACK_MONITOR_ENABLE
+    uint32_t            stack_peak;                                                 /**< Peak stack usage in bytes. */
+#endif
+#if CONFIG_SERVICE_AFFINITY_ENABLE
+    uint32_t            affinity;                                                   /**< Core mask of the thread, placed or configured, 0 for any core. */
+#endif
+#if CONFIG_PAYLOAD_POOL_ENABLE
+    uint32_t            payload;                                                    /**< Payload handle of the message being handled, 0 if none. */
+#endif
+#if CONFIG_SERVICE_REQUEST_ENABLE
+    uint32_t            request;                                                    /**< Tag of the request being handled, 0 if none. */
+    uint32_t            inherit_count;                                              /**< Outstanding requests lending their priority. */
+    osPriority_t        base_priority;                                              /**< Thread priority before inheritance. */
+#endif
+#if CONFIG_SERVICE_WATCHDOG_ENABLE
+    uint32_t            busy;                                                       /**< Handler sequence, odd while the message handler runs. */
+    uint32_t            busy_id;                                                    /**< Id of the message being handled. */
+    uint32_t            busy_start;                                                 /**< Tick the message handler started. */
+#endif
+#if SERVICE_TRANSPORT_ENABLE
+    const service_transport_t*  transport;                                          /**< Transport replacing the message queue, or NULL. */
+    void*               transport_ctx;                                              /**< Transport private data. */
+#endif
+#if CONFIG_SERVICE_POOL_ENABLE
+    void*               pool;                                                       /**< Shared pool queue replacing the message queue, or NULL. */
+#endif
+#if CONFIG_SERVICE_REPLICA_ENABLE
+    uint32_t            replica;                                                    /**< Index in the replica set, 0 for the logical handle. */
+    uint32_t            replicas;                                                   /**< Replica count, 0 if not replicated. */
+#endif
+#if CONFIG_MSG_DEADLINE_ENABLE
+    uint32_t            expired;                                                    /**< Messages dropped past their deadline. */
+#endif
+#if CONFIG_SERVICE_CO_ENABLE
+    uint32_t            wake;                                                       /**< Tick a coroutine await times out, 0 for none. */
+#endif
+#if CONFIG_SERVICE_DIRECT_ENABLE
+    void (* direct)(void* argument);                                                /**< Receive loop calling the handler by name, or NULL. */
+#endif
 
     int32_t (* init)(const object* obj);                                            /**< Point to the init handler. */
     int32_t (* deinit)(const object* obj);                                          /**< Point to the deinit handler */
@@ -55,8 +132,41 @@ typedef struct
     osThreadAttr_t          thread_attr;    /**< Thread attribute. */
     osMessageQueueAttr_t    queue_attr;     /**< Queue attribute. */
     uint32_t                msg_count;      /**< Message count. */
+#if SERVICE_FLAGS_ENABLE
+    uint32_t                flags;          /**< Service flags, SERVICE_FLAG_xxx. */
+#endif
+#if CONFIG_SERVICE_AFFINITY_ENABLE
+    uint32_t                affinity;       /**< Core mask, 0 for any core, or the choice of the placement pass if enabled. */
+#endif
+#if CONFIG_SERVICE_WATCHDOG_ENABLE
+    uint32_t                budget_ms;      /**< Handler time budget per message, 0 for none. */
+#endif
+#if CONFIG_SERVICE_REPLICA_ENABLE
+    uint32_t                shard_key;      /**< Message parameter picking the replica, SERVICE_SHARD_KEY_xxx. */
+#endif
+#if CONFIG_SERVICE_POOL_ENABLE
+    uint32_t                msg_cap;        /**< Most messages queued with SERVICE_FLAG_SHARED_POOL, 0 for the pool size. */
+#endif
 } service_config_t;
 
+/** Export the service queue as a shared memory ring, see @ref transport_shm_export. */
+#define SERVICE_FLAG_SHM_EXPORT 0x00000001
+
+/** Deliver broadcasts to every replica instead of one, see DECLARE_SERVICE_REPLICATED(). */
+#define SERVICE_FLAG_BROADCAST_ALL 0x00000002
+
+/** Dispatch the queued messages earliest deadline first, see msg_set_deadline(). */
+#define SERVICE_FLAG_EDF 0x00000004
+
+/** Queue the messages in the shared pool, msg_count of them reserved, see @ref service_pool_attach. */
+#define SERVICE_FLAG_SHARED_POOL 0x00000008
+
+/** Shard key of a replicated service, the message parameter hashed to pick the replica. */
+#define SERVICE_SHARD_KEY_PARAM0 0
+#define SERVICE_SHARD_KEY_PARAM1 1
+#define SERVICE_SHARD_KEY_PARAM2 2
+#define SERVICE_SHARD_KEY_PARAM3 3
+
 /**
  * @brief   Service interface definitions.
  */
@@ -75,9 +185,65 @@ extern osThreadId_t service_get_thread_id(const object* obj);
 extern osMessageQueueId_t service_get_queue_id(const object* obj);
 extern void* service_get_priv_data(const object* obj);
 extern service_t* service_get_svc(const object* obj);
+extern service_t* service_get_current(void);
+extern uint32_t service_get_expired_count(const object* obj);
 extern int32_t service_broadcast_message(const message_t* message);
 extern int32_t service_unicast_message(const service_t* svc,
                                        const message_t* message);
+extern int32_t service_post_message(const service_t* svc,
+                                    const message_t* message);
+extern int32_t service_unicast_payload(const service_t* svc,
+                                       const message_t* message,
+                                       void* payload);
+extern int32_t service_broadcast_payload(const message_t* message,
+                                         void* payload);
+extern int32_t service_unicast_signal(const service_t* svc, uint32_t id);
+extern int32_t service_broadcast_signal(uint32_t id);
+extern void service_message_discard(const message_t* message);
+
+#if CONFIG_SERVICE_DIRECT_ENABLE
+extern void service_direct_receive(service_t* svc, message_t* message, uint32_t* flags);
+extern void service_direct_next(service_t* svc, message_t* message, uint32_t* flags);
+
+/**
+ * @brief   Receive loop of a service declared in direct mode.
+ *
+ * Expanded by DECLARE_SERVICE() in the translation unit of the handler,
+ * so the handler is called by name and can be inlined, instead of going
+ * through the service interface and the handle. Built with LTO=y the
+ * framework steps around it inline as well.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   handler Message handler of the service, may be NULL.
+ */
+static inline __attribute__((always_inline))
+void service_direct_loop(service_t* svc,
+                         void (* handler)(const object* obj, const message_t* const message))
+{
+    message_t message;
+    uint32_t flags;
+
+    service_direct_receive(svc, &message, &flags);
+
+    while (1)
+    {
+        if (handler)
+        {
+            handler(svc->owner, &message);
+        }
+
+        service_direct_next(svc, &message, &flags);
+    }
+}
+#endif
+
+#ifndef DOC_HIDDEN
+/* Thread flags of the service thread, the low bits are signals. */
+#define SERVICE_THREAD_FLAGS_SIGNAL 0x1FFFFFFF
+#define SERVICE_THREAD_FLAG_RESPONSE 0x20000000
+#define SERVICE_THREAD_FLAG_QUEUE   0x40000000
+#define SERVICE_THREAD_FLAGS_ALL    (SERVICE_THREAD_FLAGS_SIGNAL | SERVICE_THREAD_FLAG_QUEUE)
+#endif
 
 /** Helper macro for service. */
 #define DECLARE_SERVICE(service_name, \
@@ -96,7 +262,78 @@ extern int32_t service_unicast_message(const service_t* svc,
                      deinit_fn, \
                      message_handler_fn)
 
+#if CONFIG_SERVICE_REPLICA_ENABLE
+/** Number of handles of a service, 1 if it is not replicated. */
+#define SERVICE_REPLICA_COUNT(svc) ((svc)->replicas ? (svc)->replicas : 1u)
+
+/** Index of a handle in the replica set of its service, 0 for the first one. */
+#define SERVICE_REPLICA_INDEX(svc) ((svc)->replica)
+#else
+#define SERVICE_REPLICA_COUNT(svc) 1u
+#define SERVICE_REPLICA_INDEX(svc) 0u
+#endif
+
+#if CONFIG_SERVICE_REPLICA_ENABLE
+/**
+ * Helper macro for a service running replica_count threads, each with
+ * its own queue, sharing the private data and the handlers. Messages are
+ * routed to a replica by hashing the configured shard key, so messages
+ * with the same key stay in order. The object and object_get_binding()
+ * stay single, service_get_svc() returns the first replica.
+ */
+#define DECLARE_SERVICE_REPLICATED(service_name, \
+                                   service_label, \
+                                   replica_count, \
+                                   priv_data, \
+                                   service_config, \
+                                   init_fn, \
+                                   deinit_fn, \
+                                   message_handler_fn) \
+    SERVICE_DIRECT_DECLARE(service_label) \
+    SERVICE_DEF_LINKAGE service_t __service_def_ ## service_label[(replica_count)] \
+    __attribute__((used, section("module_service"), aligned(__alignof__(service_t)))) = { \
+        [0 ... (replica_count) - 1] = { \
+            .init               = (init_fn), \
+            .deinit             = (deinit_fn), \
+            .message_handler    = (message_handler_fn), \
+            SERVICE_DIRECT_INIT(service_label) \
+            .priv               = (priv_data), \
+            .replicas           = (replica_count) } }; \
+    SERVICE_DIRECT_DEFINE(service_label, message_handler_fn) \
+    module_service(service_name, \
+                   service_label, \
+                   service_probe, \
+                   service_shutdown, \
+                   ((void*)&service_intf), \
+                   (&__service_def_ ## service_label[0]), \
+                   ((void*)service_config))
+#endif
+
 #ifndef DOC_HIDDEN
+/* The generated routing tables refer to the service definitions. */
+#if CONFIG_SERVICE_ROUTES_ENABLE
+#define SERVICE_DEF_LINKAGE
+#else
+#define SERVICE_DEF_LINKAGE static
+#endif
+
+/* Direct mode generates the receive loop of each service next to its handler. */
+#if CONFIG_SERVICE_DIRECT_ENABLE
+#define SERVICE_DIRECT_DECLARE(service_label) \
+    static void __service_direct_ ## service_label(void* argument);
+#define SERVICE_DIRECT_INIT(service_label) \
+    .direct             = __service_direct_ ## service_label,
+#define SERVICE_DIRECT_DEFINE(service_label, message_handler_fn) \
+    static void __service_direct_ ## service_label(void* argument) \
+    { \
+        service_direct_loop((service_t*)argument, (message_handler_fn)); \
+    }
+#else
+#define SERVICE_DIRECT_DECLARE(service_label)
+#define SERVICE_DIRECT_INIT(service_label)
+#define SERVICE_DIRECT_DEFINE(service_label, message_handler_fn)
+#endif
+
 #define __define_service(service_name, \
                          service_label, \
                          priv_data, \
@@ -105,7 +342,8 @@ extern int32_t service_unicast_message(const service_t* svc,
                          init_fn, \
                          deinit_fn, \
                          message_handler_fn) \
-    static service_t __service_def_ ## service_label \
+    SERVICE_DIRECT_DECLARE(service_label) \
+    SERVICE_DEF_LINKAGE service_t __service_def_ ## service_label \
     __attribute__((used, section("module_service"))) = { \
         .owner              = NULL, \
         .thread_id          = NULL, \
@@ -113,7 +351,9 @@ extern int32_t service_unicast_message(const service_t* svc,
         .init               = (init_fn), \
         .deinit             = (deinit_fn), \
         .message_handler    = (message_handler_fn), \
+        SERVICE_DIRECT_INIT(service_label) \
         .priv               = (priv_data) }; \
+    SERVICE_DIRECT_DEFINE(service_label, message_handler_fn) \
     module_service(service_name, \
                    service_label, \
                    service_probe, \
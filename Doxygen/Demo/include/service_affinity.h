@@ -0,0 +1,75 @@
+/**
+ * @file include/service_affinity.h
+ * @brief Definition the service core affinity and placement.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_AFFINITY_H__
+#define __SERVICE_AFFINITY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   Measured unicast count between two services.
+ */
+typedef struct
+{
+    const char* const   from;   /**< Name of the sending service. */
+    const char* const   to;     /**< Name of the receiving service. */
+    uint32_t            count;  /**< Number of messages. */
+} service_traffic_t;
+
+#if CONFIG_SERVICE_TRAFFIC_ENABLE && !CONFIG_SERVICE_AFFINITY_ENABLE
+#error "CONFIG_SERVICE_TRAFFIC_ENABLE needs CONFIG_SERVICE_AFFINITY_ENABLE"
+#endif
+
+extern void service_affinity_apply(const service_t* svc);
+
+#if CONFIG_SERVICE_TRAFFIC_ENABLE
+extern void service_affinity_count(const service_t* from, const service_t* to);
+extern int32_t service_affinity_rebalance(void);
+extern void service_affinity_dump(void);
+extern void service_affinity_dump_profile(void);
+
+/**
+ * Helper macro for a traffic profile entry, placed in the module_traffic
+ * section. The placement pass at object_init() co-locates the services
+ * that exchange the most messages. service_affinity_dump_profile() prints
+ * the live counts in this form.
+ */
+#define DECLARE_SERVICE_TRAFFIC(traffic_label, from_name, to_name, msg_count) \
+    static const service_traffic_t __traffic_def_ ## traffic_label \
+    __attribute__((used, section("module_traffic"))) = { \
+        .from   = (from_name), \
+        .to     = (to_name), \
+        .count  = (msg_count) }
+
+/** Count a unicast from the current service. */
+#define SERVICE_AFFINITY_COUNT(to) service_affinity_count(service_get_current(), to)
+#else
+#define DECLARE_SERVICE_TRAFFIC(traffic_label, from_name, to_name, msg_count)
+#define SERVICE_AFFINITY_COUNT(to)
+#endif
+
+#endif /* __SERVICE_AFFINITY_H__ */
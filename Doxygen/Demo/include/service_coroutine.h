@@ -0,0 +1,114 @@
+/**
+ * @file include/service_coroutine.h
+ * @brief Definition the stackless coroutines of the message handlers.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_COROUTINE_H__
+#define __SERVICE_COROUTINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "err.h"
+#include "message.h"
+#include "service.h"
+
+struct _service_co_t;
+
+/**
+ * @brief   Coroutine body, see SERVICE_CO_BEGIN().
+ *
+ * @param   co Pointer to the coroutine.
+ * @param   arg Argument given to service_co_start().
+ *
+ * @retval  Returns SERVICE_CO_WAITING from an await, SERVICE_CO_DONE at the end.
+ */
+typedef int32_t (* service_co_fn)(struct _service_co_t* co, void* arg);
+
+/**
+ * @brief   Coroutine continuation, kept in the service private data.
+ */
+typedef struct _service_co_t
+{
+    service_co_fn   fn;         /**< Body, NULL when not running. */
+    void*           arg;        /**< Body argument. */
+    service_t*      svc;        /**< Service running the coroutine. */
+    uint32_t        line;       /**< Resume point in the body. */
+    uint32_t        wait_id;    /**< Message id awaited, 0 for none, SERVICE_CO_ANY for any. */
+    uint32_t        deadline;   /**< Tick the await times out, 0 for none. */
+    int32_t         status;     /**< Result of the last await, 0 or -ETIMEOUT. */
+    message_t       message;    /**< Message that ended the last await. */
+} service_co_t;
+
+#ifndef DOC_HIDDEN
+/* Body return values. */
+#define SERVICE_CO_WAITING  0
+#define SERVICE_CO_DONE     1
+#endif
+
+/** Message id awaited to resume on any message. */
+#define SERVICE_CO_ANY      0xFFFFFFFF
+
+extern int32_t service_co_start(service_co_t* co, service_co_fn fn, void* arg);
+extern int32_t service_co_feed(service_co_t* co, const message_t* message);
+extern void service_co_await(service_co_t* co, uint32_t id, uint32_t timeout_ms);
+extern void service_co_cancel(service_co_t* co);
+extern int32_t service_co_running(const service_co_t* co);
+
+/** Open the body of a coroutine, locals do not survive an await. */
+#define SERVICE_CO_BEGIN(co)    switch ((co)->line) { case 0:
+
+/** Close the body of a coroutine. */
+#define SERVICE_CO_END(co)      } (co)->line = 0; return SERVICE_CO_DONE
+
+/** Wait for message id, or for timeout_ms if not 0. */
+#define SERVICE_CO_AWAIT_MESSAGE(co, id, timeout_ms) \
+    do \
+    { \
+        service_co_await(co, id, timeout_ms); \
+        (co)->line = __LINE__; \
+        return SERVICE_CO_WAITING; \
+        case __LINE__:; \
+    } while (0)
+
+/** Sleep for timeout_ms, other messages are handled meanwhile, 0 yields for a tick. */
+#define SERVICE_CO_AWAIT_TIMEOUT(co, timeout_ms) SERVICE_CO_AWAIT_MESSAGE(co, 0, timeout_ms)
+
+/** Wait until cond holds, checked on each message to the coroutine and every poll_ms. */
+#define SERVICE_CO_AWAIT_UNTIL(co, cond, poll_ms) \
+    do \
+    { \
+        (co)->line = __LINE__; \
+        case __LINE__: \
+        if (!(cond)) \
+        { \
+            service_co_await(co, SERVICE_CO_ANY, poll_ms); \
+            return SERVICE_CO_WAITING; \
+        } \
+    } while (0)
+
+/** Non-zero if the last await timed out. */
+#define SERVICE_CO_TIMEDOUT(co) ((co)->status == -ETIMEOUT)
+
+/** Message that ended the last await. */
+#define SERVICE_CO_MESSAGE(co) ((const message_t*)&(co)->message)
+
+#endif /* __SERVICE_COROUTINE_H__ */
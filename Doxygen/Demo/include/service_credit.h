@@ -0,0 +1,83 @@
+/**
+ * @file include/service_credit.h
+ * @brief Definition the credit-based flow control between services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_CREDIT_H__
+#define __SERVICE_CREDIT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmsis_os.h"
+#include "framework_conf.h"
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Credit channel configuration.
+ */
+typedef struct
+{
+    uint32_t    window;     /**< Credits, the most messages in flight to the consumer. */
+    uint32_t    resume;     /**< Credits back before a starved producer is notified, 0 for no notification. */
+    uint32_t    resume_id;  /**< Message id of the notification, param0 the credits available. */
+} service_credit_config_t;
+
+/**
+ * @brief   Credit channel statistics.
+ */
+typedef struct
+{
+    uint32_t    sent;       /**< Messages sent with a credit. */
+    uint32_t    granted;    /**< Credits returned by the consumer. */
+    uint32_t    starved;    /**< Acquires that found no credit. */
+    uint32_t    resumes;    /**< Resume notifications sent. */
+} service_credit_stats_t;
+
+/**
+ * @brief   Credit channel from one producer to one consumer.
+ */
+typedef struct
+{
+    const service_t*        producer;   /**< Service notified on resume, may be NULL. */
+    const service_t*        consumer;   /**< Service receiving the messages. */
+    osSemaphoreId_t         credits;    /**< Credits available to the producer. */
+    uint32_t                index;      /**< Channel index carried in the message id. */
+    uint32_t                window;     /**< Credit count. */
+    uint32_t                resume;     /**< Resume threshold. */
+    uint32_t                resume_id;  /**< Resume message id. */
+    uint32_t                waiting;    /**< Non-zero after an acquire found no credit. */
+    service_credit_stats_t  stats;      /**< Statistics. */
+} service_credit_t;
+
+extern int32_t service_credit_init(service_credit_t* channel,
+                                   const service_t* producer,
+                                   const service_t* consumer,
+                                   const service_credit_config_t* config);
+extern int32_t service_credit_deinit(service_credit_t* channel);
+extern int32_t service_credit_acquire(service_credit_t* channel, uint32_t timeout);
+extern uint32_t service_credit_available(const service_credit_t* channel);
+extern int32_t service_credit_send(service_credit_t* channel, const message_t* message);
+extern void service_credit_grant(uint32_t index);
+extern int32_t service_credit_get_stats(const service_credit_t* channel,
+                                        service_credit_stats_t* stats);
+
+#endif /* __SERVICE_CREDIT_H__ */
@@ -0,0 +1,76 @@
+/**
+ * @file include/service_group.h
+ * @brief Declaration the multicast groups of services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_GROUP_H__
+#define __SERVICE_GROUP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "message.h"
+#include "service.h"
+
+/* The members that did not get a message are returned as a 32 bits mask. */
+_Static_assert(CONFIG_SERVICE_GROUP_MEMBERS <= 32, "CONFIG_SERVICE_GROUP_MEMBERS must not exceed 32");
+
+/**
+ * @brief   Multicast group definitions.
+ */
+typedef struct
+{
+    const char*         name;       /**< Group name. */
+    const char* const*  members;    /**< Names of the member services. */
+    uint32_t            count;      /**< Member count. */
+    const service_t**   svcs;       /**< Member handles, resolved at object_init(). */
+} service_group_t;
+
+extern const service_group_t* service_group_get_binding(const char* const name);
+extern int32_t service_multicast_message(const service_group_t* group,
+                                         const message_t* message,
+                                         uint32_t* failed);
+
+#if CONFIG_SERVICE_GROUP_ENABLE
+/**
+ * Helper macro for a multicast group of services, placed in the
+ * module_group section. The members are service names, resolved to
+ * their handles at object_init(), which fails on an unknown name.
+ * Up to CONFIG_SERVICE_GROUP_MEMBERS members.
+ *
+ *     DECLARE_SERVICE_GROUP(sensors, "sensors", "accel", "gyro", "baro");
+ */
+#define DECLARE_SERVICE_GROUP(group_label, group_name, ...) \
+    static const char* const __service_group_names_ ## group_label[] = { __VA_ARGS__ }; \
+    static const service_t* __service_group_svcs_ ## group_label \
+        [sizeof(__service_group_names_ ## group_label) / sizeof(const char*)]; \
+    static const service_group_t __service_group_def_ ## group_label \
+    __attribute__((used, section("module_group"))) = { \
+        .name       = (group_name), \
+        .members    = __service_group_names_ ## group_label, \
+        .count      = sizeof(__service_group_names_ ## group_label) / sizeof(const char*), \
+        .svcs       = __service_group_svcs_ ## group_label }
+
+/** The group declared in the same file, service_group_get_binding() from others. */
+#define SERVICE_GROUP(group_label) (&__service_group_def_ ## group_label)
+#endif
+
+#endif /* __SERVICE_GROUP_H__ */
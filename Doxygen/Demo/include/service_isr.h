@@ -0,0 +1,48 @@
+/**
+ * @file include/service_isr.h
+ * @brief Definition the interrupt posting ring.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_ISR_H__
+#define __SERVICE_ISR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Interrupt posting ring statistics.
+ */
+typedef struct
+{
+    uint32_t    posted;     /**< Messages posted. */
+    uint32_t    overflows;  /**< Messages lost on a full ring. */
+    uint32_t    failed;     /**< Messages the dispatcher could not deliver. */
+    uint32_t    peak;       /**< Highest ring occupancy. */
+} service_isr_stats_t;
+
+extern int32_t service_unicast_message_isr(const service_t* svc,
+                                           const message_t* message);
+extern int32_t service_broadcast_message_isr(const message_t* message);
+extern int32_t service_isr_get_stats(service_isr_stats_t* stats);
+
+#endif /* __SERVICE_ISR_H__ */
@@ -0,0 +1,64 @@
+/**
+ * @file include/service_load.h
+ * @brief Definition the handler CPU time accounting of the services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_LOAD_H__
+#define __SERVICE_LOAD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   Handler CPU time statistics of a service.
+ */
+typedef struct
+{
+    uint64_t    time_us;        /**< Handler time in us since boot. */
+    uint32_t    messages;       /**< Messages handled since boot. */
+    uint32_t    load_1s;        /**< Load over the last second, in per mille. */
+    uint32_t    load_10s;       /**< Load averaged over 10 s, in per mille. */
+    uint32_t    load_60s;       /**< Load averaged over 60 s, in per mille. */
+} service_load_stats_t;
+
+/**
+ * @brief   Handler CPU time of one message id in a service.
+ */
+typedef struct
+{
+    uint32_t    id;             /**< Message id. */
+    uint32_t    messages;       /**< Messages handled. */
+    uint64_t    time_us;        /**< Handler time in us. */
+} service_load_id_stats_t;
+
+extern void service_load_begin(service_t* svc);
+extern void service_load_end(service_t* svc, uint32_t id);
+extern void service_load_update(void);
+extern int32_t service_load_get_stats(const object* obj,
+                                      service_load_stats_t* stats);
+extern uint32_t service_load_get_id_stats(const object* obj,
+                                          service_load_id_stats_t* stats,
+                                          uint32_t count);
+extern void service_load_dump(void);
+
+#endif /* __SERVICE_LOAD_H__ */
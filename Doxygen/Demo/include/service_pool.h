@@ -0,0 +1,59 @@
+/**
+ * @file include/service_pool.h
+ * @brief Definition the message pool shared by the service queues.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_POOL_H__
+#define __SERVICE_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Shared message pool statistics.
+ */
+typedef struct
+{
+    uint32_t    size;       /**< Message nodes in the pool. */
+    uint32_t    free;       /**< Nodes not holding a message. */
+    uint32_t    reserved;   /**< Nodes reserved by the attached services. */
+    uint32_t    shared;     /**< Nodes above the reservations still available. */
+    uint32_t    peak;       /**< Most nodes holding a message at once. */
+    uint32_t    failures;   /**< Sends refused, the service had no node left. */
+    uint32_t    queues;     /**< Services attached. */
+    uint32_t    ram;        /**< Bytes of the pool, nodes, links, queue slots and semaphores. */
+    uint32_t    queue_ram;  /**< Bytes the attached services would take with their own queues, control blocks included. */
+} service_pool_stats_t;
+
+extern int32_t service_pool_attach(service_t* svc, const service_config_t* const config);
+extern void service_pool_detach(service_t* svc);
+extern osStatus_t service_pool_put(const service_t* svc,
+                                   const message_t* message,
+                                   uint32_t timeout);
+extern osStatus_t service_pool_get(const service_t* svc, message_t* message, uint32_t timeout);
+extern uint32_t service_pool_count(const service_t* svc);
+extern int32_t service_pool_get_stats(service_pool_stats_t* stats);
+extern void service_pool_dump(void);
+
+#endif /* __SERVICE_POOL_H__ */
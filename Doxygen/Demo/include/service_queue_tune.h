@@ -0,0 +1,58 @@
+/**
+ * @file include/service_queue_tune.h
+ * @brief Definition the service queue sizing recommendations.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_QUEUE_TUNE_H__
+#define __SERVICE_QUEUE_TUNE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmsis_os.h"
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   Service queue load and sizing recommendation.
+ */
+typedef struct
+{
+    uint32_t    arrivals;       /**< Messages offered to the queue. */
+    uint32_t    full;           /**< Arrivals that found the queue full, blocked or dropped. */
+    uint32_t    peak;           /**< Highest occupancy seen by an arrival. */
+    uint32_t    mean_x100;      /**< Mean occupancy seen by arrivals, times 100. */
+    uint32_t    cv2_x100;       /**< Squared coefficient of variation of the inter-arrival time, times 100. */
+    uint32_t    configured;     /**< Configured msg_count. */
+    uint32_t    recommended;    /**< msg_count for CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM. */
+    int32_t     ram_delta;      /**< Queue RAM added by the recommendation, negative if saved. */
+    uint8_t     saturated;      /**< The queue is overloaded, no size is enough. */
+} service_queue_tune_t;
+
+extern void service_queue_tune_record(const service_t* svc,
+                                      uint32_t occupancy,
+                                      osStatus_t stat);
+extern int32_t service_queue_tune_get(const object* obj,
+                                      service_queue_tune_t* tune);
+extern void service_queue_tune_reset(void);
+extern void service_queue_tune_dump(void);
+extern void service_queue_tune_dump_header(void);
+
+#endif /* __SERVICE_QUEUE_TUNE_H__ */
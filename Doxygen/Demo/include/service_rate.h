@@ -0,0 +1,111 @@
+/**
+ * @file include/service_rate.h
+ * @brief Definition the token-bucket rate limits on the send path.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_RATE_H__
+#define __SERVICE_RATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "message.h"
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   What happens to a message over the rate.
+ */
+typedef enum
+{
+    SERVICE_RATE_DROP,      /**< The send fails with -EAGAIN. */
+    SERVICE_RATE_DELAY,     /**< The sender sleeps for a token, up to the send timeout. */
+    SERVICE_RATE_COALESCE,  /**< The latest message to a destination is held and sent when a token is back. */
+} service_rate_policy_e;
+
+/**
+ * @brief   Rate limiter configuration.
+ */
+typedef struct
+{
+    uint32_t                id;         /**< Message id limited, flags are ignored. */
+    const object*           sender;     /**< Sending service object, NULL for any sender. */
+    uint32_t                rate;       /**< Messages per period. */
+    uint32_t                period_ms;  /**< Period in ms. */
+    uint32_t                burst;      /**< Messages accepted back to back, at least 1. */
+    service_rate_policy_e   policy;     /**< Policy over the rate. */
+} service_rate_config_t;
+
+/**
+ * @brief   Rate limiter statistics.
+ */
+typedef struct
+{
+    uint32_t    accepted;   /**< Messages sent at once or after a delay. */
+    uint32_t    rejected;   /**< Messages refused. */
+    uint32_t    delayed;    /**< Messages sent after the sender slept. */
+    uint32_t    coalesced;  /**< Messages held, a held message replaces the previous one to the same destination. */
+} service_rate_stats_t;
+
+/**
+ * @brief   Rate limiter.
+ *
+ * The bucket is kept as its theoretical arrival time, the tick at which
+ * it would be full again, so a message takes a token with one CAS.
+ */
+typedef struct
+{
+    uint32_t                id;         /**< Message id limited. */
+    const object*           sender;     /**< Sending service object, NULL for any. */
+    service_rate_policy_e   policy;     /**< Policy over the rate. */
+    uint32_t                interval;   /**< Ticks per token. */
+    uint32_t                tolerance;  /**< Ticks the arrival time may run ahead, (burst - 1) tokens. */
+    uint32_t                horizon;    /**< Farthest legitimate arrival time, older ones are stale. */
+    uint32_t                tat;        /**< Theoretical arrival time tick. */
+    uint32_t                index;      /**< Slot in the limiter table. */
+    uint32_t                held;       /**< State of the held message. */
+    const service_t*        held_svc;   /**< Destination of the held message, NULL for a broadcast. */
+    message_t               held_msg;   /**< Held message. */
+    service_rate_stats_t    stats;      /**< Statistics. */
+} service_rate_t;
+
+#ifndef DOC_HIDDEN
+/* service_rate_check() kept the message for later. */
+#define SERVICE_RATE_HELD 1
+#endif
+
+extern int32_t service_rate_init(service_rate_t* limiter, const service_rate_config_t* config);
+extern int32_t service_rate_deinit(service_rate_t* limiter);
+extern int32_t service_rate_check(const service_t* svc,
+                                  const message_t* message,
+                                  uint32_t timeout);
+extern void service_rate_poll(void);
+extern int32_t service_rate_get_stats(const service_rate_t* limiter,
+                                      service_rate_stats_t* stats);
+
+#if CONFIG_SERVICE_RATE_ENABLE
+/** 0 to send the message, SERVICE_RATE_HELD if held, negative if refused. */
+#define SERVICE_RATE_CHECK(svc, message, timeout) service_rate_check(svc, message, timeout)
+#else
+#define SERVICE_RATE_CHECK(svc, message, timeout) 0
+#endif
+
+#endif /* __SERVICE_RATE_H__ */
@@ -0,0 +1,50 @@
+/**
+ * @file include/service_replica.h
+ * @brief Definition the sharded service replicas.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_REPLICA_H__
+#define __SERVICE_REPLICA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "message.h"
+#include "service.h"
+
+extern const service_t* service_replica_select(const service_t* svc,
+                                               const message_t* message);
+extern const service_t* service_replica_fanout(const service_t* svc,
+                                               const message_t* message,
+                                               uint32_t n);
+extern const service_t* service_replica_get(const service_t* svc, uint32_t index);
+
+#if CONFIG_SERVICE_REPLICA_ENABLE
+/** Replica of svc receiving a unicast message. */
+#define SERVICE_REPLICA_SELECT(svc, message) service_replica_select(svc, message)
+/** The n-th destination of a broadcast reaching svc, NULL when done. */
+#define SERVICE_REPLICA_FANOUT(svc, message, n) service_replica_fanout(svc, message, n)
+#else
+#define SERVICE_REPLICA_SELECT(svc, message) (svc)
+#define SERVICE_REPLICA_FANOUT(svc, message, n) ((n) ? NULL : (svc))
+#endif
+
+#endif /* __SERVICE_REPLICA_H__ */
@@ -0,0 +1,67 @@
+/**
+ * @file include/service_request.h
+ * @brief Definition the service request/response.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_REQUEST_H__
+#define __SERVICE_REQUEST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "message.h"
+#include "service.h"
+
+/**
+ * @brief   Response callback of an asynchronous request.
+ *
+ * Called in the context of the thread that replies, keep it short.
+ *
+ * @param   handle Request handle returned by service_request_async().
+ * @param   response Pointer to the response, the id is 0 on error.
+ * @param   status 0 on success, negative error code otherwise.
+ * @param   arg User argument.
+ */
+typedef void (* service_response_fn)(int32_t            handle,
+                                     const message_t*   response,
+                                     int32_t            status,
+                                     void*              arg);
+
+extern int32_t service_request(const service_t* svc,
+                               const message_t* request,
+                               message_t* response,
+                               uint32_t timeout);
+extern int32_t service_request_async(const service_t* svc,
+                                     const message_t* request,
+                                     service_response_fn cb,
+                                     void* arg);
+extern int32_t service_request_wait(int32_t handle,
+                                    message_t* response,
+                                    uint32_t timeout);
+extern int32_t service_request_cancel(int32_t handle);
+extern int32_t service_request_complete(uint32_t tag,
+                                        const message_t* response,
+                                        int32_t status);
+extern int32_t service_reply(const object* obj, const message_t* response);
+extern int32_t service_request_defer(const object* obj);
+extern int32_t service_request_reply(int32_t handle, const message_t* response);
+
+#endif /* __SERVICE_REQUEST_H__ */
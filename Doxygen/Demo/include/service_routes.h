@@ -0,0 +1,75 @@
+/**
+ * @file include/service_routes.h
+ * @brief Definition the build-time service routing tables.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_ROUTES_H__
+#define __SERVICE_ROUTES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "service.h"
+
+/**
+ * @brief   Destinations of one message id, generated by scripts/gen_routes.py.
+ */
+typedef struct
+{
+    uint32_t                id;         /**< Message id without flags. */
+    service_t* const*       services;   /**< NULL terminated destination list. */
+} service_route_t;
+
+extern service_t* const* service_routes_lookup(uint32_t id);
+extern void service_routes_dump(void);
+
+/**
+ * Helper macro declaring the message ids a service consumes. It must
+ * follow the DECLARE_SERVICE() of the same label. scripts/gen_routes.py
+ * collects the declarations at build time, broadcasts then only reach
+ * the services consuming the id. A service without any declaration
+ * keeps receiving every broadcast.
+ */
+#define SERVICE_CONSUMES(service_label, ...) \
+    __service_route_check(consumes, service_label, __VA_ARGS__)
+
+/**
+ * Helper macro declaring the message ids a service produces. The build
+ * fails if one of them is consumed by no service.
+ */
+#define SERVICE_PRODUCES(service_label, ...) \
+    __service_route_check(produces, service_label, __VA_ARGS__)
+
+#ifndef DOC_HIDDEN
+/* Only checks the label and the ids at compile time, the script does the rest. */
+#define __service_route_check(kind, service_label, ...) \
+    _Static_assert(sizeof(__service_def_ ## service_label) && \
+                   sizeof((const uint32_t[]){ __VA_ARGS__ }), \
+                   #kind " " #service_label)
+
+#if CONFIG_SERVICE_ROUTES_ENABLE
+extern const service_route_t service_routes[];
+extern const uint32_t service_routes_num;
+extern service_t* const service_routes_default[];
+#endif
+#endif
+
+#endif /* __SERVICE_ROUTES_H__ */
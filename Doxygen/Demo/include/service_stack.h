@@ -0,0 +1,48 @@
+/**
+ * @file include/service_stack.h
+ * @brief Definition the service stack monitor.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_STACK_H__
+#define __SERVICE_STACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   Service stack usage structure.
+ */
+typedef struct
+{
+    uint32_t    size;           /**< Configured stack size in bytes, 0 if the RTOS default is used. */
+    uint32_t    peak;           /**< Peak stack usage in bytes. */
+    uint32_t    recommended;    /**< Peak usage plus CONFIG_SERVICE_STACK_MARGIN_PERCENT margin. */
+} service_stack_usage_t;
+
+extern int32_t service_stack_get_usage(const object* obj,
+                                       service_stack_usage_t* usage);
+extern void service_stack_scan(void);
+extern void service_stack_dump(void);
+extern void service_stack_dump_header(void);
+
+#endif /* __SERVICE_STACK_H__ */
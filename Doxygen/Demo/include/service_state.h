@@ -0,0 +1,59 @@
+/**
+ * @file include/service_state.h
+ * @brief Definition the shared state board.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_STATE_H__
+#define __SERVICE_STATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "service.h"
+
+/**
+ * @brief   State slots of the board.
+ */
+typedef enum
+{
+    SERVICE_STATE_SYS_STARTUP = 0,  /**< uint32_t, 1 once the system startup is completed. */
+    SERVICE_STATE_BLE_CONNECTION,   /**< uint32_t, 1 while a BLE HCI link is connected. */
+    SERVICE_STATE_LED_MODE,         /**< uint32_t, led_type_e of the last LED setup. */
+    SERVICE_STATE_NUM,
+} service_state_id_e;
+
+extern int32_t service_state_write(service_state_id_e id, const void* value, uint32_t size);
+extern int32_t service_state_read(service_state_id_e id,
+                                  void* value,
+                                  uint32_t size,
+                                  uint32_t* version);
+extern uint32_t service_state_version(service_state_id_e id);
+extern int32_t service_state_subscribe(service_state_id_e id, const service_t* svc);
+extern int32_t service_state_unsubscribe(service_state_id_e id, const service_t* svc);
+extern const char* service_state_to_str(service_state_id_e id);
+extern void service_state_dump(void);
+
+/** Write a state slot from a variable of the slot type. */
+#define SERVICE_STATE_WRITE(id, var) service_state_write(id, &(var), sizeof(var))
+/** Read a state slot into a variable of the slot type, version may be NULL. */
+#define SERVICE_STATE_READ(id, var, version) service_state_read(id, &(var), sizeof(var), version)
+
+#endif /* __SERVICE_STATE_H__ */
@@ -0,0 +1,100 @@
+/**
+ * @file include/service_stream.h
+ * @brief Definition the streaming data channel between two services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_STREAM_H__
+#define __SERVICE_STREAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "framework_conf.h"
+#include "service.h"
+
+/**
+ * @brief   Stream configuration.
+ */
+typedef struct
+{
+    void*       buf;        /**< Ring storage. */
+    uint32_t    size;       /**< Ring size in bytes, a power of two. */
+    uint32_t    frame;      /**< Transfer unit in bytes, a power of two, 1 for a byte stream. */
+    uint32_t    watermark;  /**< Bytes buffered before the consumer is notified. */
+    uint32_t    id;         /**< Message id of the notification, without framework flags. */
+    uint32_t    tag;        /**< Notification param0, tells the consumer which stream. */
+} service_stream_config_t;
+
+/**
+ * @brief   Stream statistics.
+ */
+typedef struct
+{
+    uint32_t    written;    /**< Bytes written. */
+    uint32_t    read;       /**< Bytes read. */
+    uint32_t    overflows;  /**< Writes cut short by a full ring. */
+    uint32_t    notifies;   /**< Notifications sent. */
+    uint32_t    failed;     /**< Notifications the consumer queue or the ISR ring refused. */
+} service_stream_stats_t;
+
+/**
+ * @brief   Single-producer single-consumer stream.
+ *
+ * The producer owns the head, the consumer owns the tail, both run
+ * freely and wrap at 2^32.
+ */
+typedef struct
+{
+    uint8_t*                buf;                                /**< Ring storage. */
+    uint32_t                mask;                               /**< Size - 1. */
+    uint32_t                frame;                              /**< Transfer unit in bytes. */
+    uint32_t                watermark;                          /**< Notification threshold in bytes. */
+    uint32_t                id;                                 /**< Notification message id. */
+    uint32_t                tag;                                /**< Notification param0. */
+    const service_t*        consumer;                           /**< Service notified. */
+    uint32_t                index;                              /**< Stream index carried in the notification id. */
+    uint32_t                head __attribute__((aligned(64)));  /**< Next byte to produce. */
+    uint32_t                tail __attribute__((aligned(64)));  /**< Next byte to consume. */
+    uint32_t                armed;                              /**< Non-zero if no notification is in flight. */
+    service_stream_stats_t  stats;                              /**< Statistics. */
+} service_stream_t;
+
+extern int32_t service_stream_init(service_stream_t* stream,
+                                   const service_t* consumer,
+                                   const service_stream_config_t* config);
+extern int32_t service_stream_deinit(service_stream_t* stream);
+extern uint32_t service_stream_write(service_stream_t* stream,
+                                     const void* data,
+                                     uint32_t len);
+extern void* service_stream_reserve(service_stream_t* stream, uint32_t* len);
+extern int32_t service_stream_commit(service_stream_t* stream, uint32_t len);
+extern int32_t service_stream_flush(service_stream_t* stream);
+extern uint32_t service_stream_read(service_stream_t* stream,
+                                    void* data,
+                                    uint32_t len);
+extern const void* service_stream_peek(service_stream_t* stream, uint32_t* len);
+extern int32_t service_stream_release(service_stream_t* stream, uint32_t len);
+extern uint32_t service_stream_count(const service_stream_t* stream);
+extern uint32_t service_stream_space(const service_stream_t* stream);
+extern void service_stream_grant(uint32_t index, uint32_t handled);
+extern int32_t service_stream_get_stats(const service_stream_t* stream,
+                                        service_stream_stats_t* stats);
+
+#endif /* __SERVICE_STREAM_H__ */
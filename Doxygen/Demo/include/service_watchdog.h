@@ -0,0 +1,68 @@
+/**
+ * @file include/service_watchdog.h
+ * @brief Definition the message handler budget watchdog.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SERVICE_WATCHDOG_H__
+#define __SERVICE_WATCHDOG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "service.h"
+
+/**
+ * @brief   Handler overrun record.
+ */
+typedef struct
+{
+    const object*   obj;        /**< Service object. */
+    uint32_t        id;         /**< Message id being handled. */
+    uint32_t        duration;   /**< Handler time in ms, so far if running. */
+    uint32_t        tick;       /**< Tick the overrun was recorded. */
+    uint32_t        running;    /**< Non-zero if the handler was still running. */
+} service_watchdog_record_t;
+
+/**
+ * @brief   Handler budget statistics of a service.
+ */
+typedef struct
+{
+    uint32_t    budget;         /**< Budget in ms. */
+    uint32_t    overruns;       /**< Messages over budget. */
+    uint32_t    worst;          /**< Longest handler time in ms. */
+    uint32_t    worst_id;       /**< Message id of the longest handler time. */
+} service_watchdog_stats_t;
+
+extern void service_watchdog_begin(service_t* svc, uint32_t id);
+extern void service_watchdog_end(service_t* svc);
+extern void service_watchdog_check(void);
+#if CONFIG_SERVICE_WATCHDOG_NOTIFY
+extern int32_t service_watchdog_subscribe(const service_t* svc);
+extern int32_t service_watchdog_unsubscribe(const service_t* svc);
+#endif
+extern int32_t service_watchdog_get_stats(const object* obj,
+                                          service_watchdog_stats_t* stats);
+extern uint32_t service_watchdog_get_records(service_watchdog_record_t* records,
+                                             uint32_t count);
+extern void service_watchdog_dump(void);
+
+#endif /* __SERVICE_WATCHDOG_H__ */
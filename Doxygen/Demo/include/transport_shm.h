@@ -0,0 +1,38 @@
+/**
+ * @file include/transport_shm.h
+ * @brief Definition the shared memory transport.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRANSPORT_SHM_H__
+#define __TRANSPORT_SHM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object.h"
+#include "message.h"
+#include "service.h"
+
+extern int32_t transport_shm_export(const object* obj,
+                                    const service_config_t* const config);
+extern void transport_shm_unexport(const object* obj);
+extern const object* transport_shm_get_binding(const char* const name);
+
+#endif /* __TRANSPORT_SHM_H__ */
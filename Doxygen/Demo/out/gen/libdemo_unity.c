@@ -0,0 +1,24 @@
+#include "/root/repo/Doxygen/Demo/source/src/bridge.c"
+#include "/root/repo/Doxygen/Demo/source/src/interceptor.c"
+#include "/root/repo/Doxygen/Demo/source/src/message.c"
+#include "/root/repo/Doxygen/Demo/source/src/msg_ring.c"
+#include "/root/repo/Doxygen/Demo/source/src/object.c"
+#include "/root/repo/Doxygen/Demo/source/src/payload.c"
+#include "/root/repo/Doxygen/Demo/source/src/service.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_affinity.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_coroutine.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_credit.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_group.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_isr.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_load.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_pool.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_queue_tune.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_rate.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_replica.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_request.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_routes.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_stack.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_state.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_stream.c"
+#include "/root/repo/Doxygen/Demo/source/src/service_watchdog.c"
+#include "/root/repo/Doxygen/Demo/source/src/transport_shm.c"
@@ -0,0 +1,33 @@
+/* Generated by scripts/gen_routes.py, do not edit. */
+
+#include "framework.h"
+#include "service_routes.h"
+
+#if CONFIG_SERVICE_ROUTES_ENABLE
+
+extern service_t __service_def_sim_bench;
+extern service_t __service_def_sim_bench_dispatch;
+extern service_t __service_def_sim_bench_receiver;
+extern service_t __service_def_sim_bench_sink;
+extern service_t __service_def_sim_filter;
+extern service_t __service_def_sim_report;
+
+service_t* const service_routes_default[] =
+{
+    &__service_def_sim_bench,
+    &__service_def_sim_bench_dispatch,
+    &__service_def_sim_bench_receiver,
+    &__service_def_sim_bench_sink,
+    &__service_def_sim_filter,
+    &__service_def_sim_report,
+    NULL,
+};
+
+const service_route_t service_routes[] =
+{
+    { 0, NULL },
+};
+
+const uint32_t service_routes_num = 0;
+
+#endif /* CONFIG_SERVICE_ROUTES_ENABLE */
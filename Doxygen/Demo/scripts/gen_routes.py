@@ -0,0 +1,279 @@
+#!/usr/bin/python
+
+import argparse
+import ast
+import operator
+import sys
+import fnmatch
+import os
+import re
+
+VERBOSE=False
+
+RE_COMMENT = re.compile(r"/\*.*?\*/|//[^\n]*", re.S)
+RE_DEFINE = re.compile(r"^[ \t]*#[ \t]*define[ \t]+(MSG_ID_\w+)[ \t]+(.+)$", re.M)
+RE_SERVICE = re.compile(r"\bDECLARE_SERVICE(_REPLICATED)?\s*\(\s*\"([^\"]*)\"\s*,\s*(\w+)\s*,")
+RE_ROUTE = re.compile(r"\bSERVICE_(CONSUMES|PRODUCES)\s*\(\s*(\w+)\s*,([^;]*)\)\s*;")
+
+# Operators of the MSG_ID_xxx macros, the numbers go through ast.literal_eval
+BIN_OPS = {ast.BitOr: operator.or_, ast.BitAnd: operator.and_,
+	ast.BitXor: operator.xor, ast.Add: operator.add, ast.Sub: operator.sub,
+	ast.LShift: operator.lshift, ast.RShift: operator.rshift}
+UNARY_OPS = {ast.Invert: operator.invert, ast.USub: operator.neg}
+
+def log(*args):
+	if VERBOSE:
+		print(args[0])
+
+def error(msg):
+	print("gen_routes: error: {}".format(msg), file=sys.stderr)
+
+def find_files(paths):
+	# Find all .c/.h files in current list, then search recursively
+	unexisting = [f for f in paths if not(os.path.exists(f))]
+	if unexisting:
+		print("Invalid paths: {}".format(" ".join(unexisting)))
+		sys.exit(-1)
+
+	matches = fnmatch.filter([f for f in paths if os.path.isfile(f)], '*.[c|h]')
+	for path in paths:
+		for root, dirnames, filenames in os.walk(path):
+			for filename in fnmatch.filter(filenames, '*.[c|h]'):
+				matches.append(os.path.join(root, filename))
+	return sorted(set(matches))
+
+def eval_expr(node):
+	# Only integer literals and the operators above, nothing is executed
+	if isinstance(node, ast.Expression):
+		return eval_expr(node.body)
+	if isinstance(node, ast.BinOp) and type(node.op) in BIN_OPS:
+		return BIN_OPS[type(node.op)](eval_expr(node.left), eval_expr(node.right))
+	if isinstance(node, ast.UnaryOp) and type(node.op) in UNARY_OPS:
+		return UNARY_OPS[type(node.op)](eval_expr(node.operand))
+	value = ast.literal_eval(node)
+	if type(value) is not int:
+		raise ValueError("not an integer")
+	return value
+
+def read_source(path):
+	with open(path, encoding="utf-8", errors="replace") as f:
+		return RE_COMMENT.sub(" ", f.read())
+
+def parse_ids(sources):
+	# Collect the MSG_ID_xxx macros and evaluate them
+	exprs = {}
+	for path, text in sources:
+		for name, expr in RE_DEFINE.findall(text):
+			if "(" in name:
+				continue
+			exprs[name] = expr.strip()
+
+	values = {}
+	def evaluate(name, depth=0):
+		if name in values:
+			return values[name]
+		if depth > 16 or name not in exprs:
+			return None
+		expr = exprs[name]
+		for ref in set(re.findall(r"\bMSG_ID_\w+\b", expr)):
+			value = evaluate(ref, depth + 1)
+			if value is None:
+				return None
+			expr = re.sub(r"\b{}\b".format(ref), str(value), expr)
+		expr = re.sub(r"\b(0[xX][0-9a-fA-F]+|\d+)[uUlL]*\b", r"\1", expr)
+		try:
+			values[name] = eval_expr(ast.parse(expr, mode="eval")) & 0xFFFFFFFF
+		except (SyntaxError, ValueError, TypeError):
+			return None
+		return values[name]
+
+	for name in exprs:
+		evaluate(name)
+	return values
+
+def parse_routes(sources, ids):
+	services = {}
+	replicated = set()
+	consumes = {}
+	produces = {}
+	ok = True
+
+	for path, text in sources:
+		for kind, name, label in RE_SERVICE.findall(text):
+			if label in services:
+				error("{}: service label '{}' declared twice".format(path, label))
+				ok = False
+			services[label] = name
+			if kind:
+				replicated.add(label)
+
+	for path, text in sources:
+		for kind, label, args in RE_ROUTE.findall(text):
+			if label not in services:
+				error("{}: SERVICE_{}() of unknown service '{}'".format(path, kind, label))
+				ok = False
+				continue
+			table = consumes if kind == "CONSUMES" else produces
+			for arg in [a.strip() for a in args.split(",") if a.strip()]:
+				if arg not in ids:
+					error("{}: <{}> unknown message id '{}'".format(path, services[label], arg))
+					ok = False
+					continue
+				table.setdefault(label, set()).add(arg)
+
+	return ok, services, replicated, consumes, produces
+
+def validate(services, consumes, produces, ids):
+	ok = True
+	consumed = set()
+	for label in consumes:
+		consumed |= consumes[label]
+
+	# A service without SERVICE_CONSUMES() receives every id, it consumes them all
+	wildcard = sorted(l for l in services if l not in consumes)
+	for label in sorted(produces):
+		for name in sorted(produces[label]):
+			if name not in consumed and not wildcard:
+				error("{}(0x{:x}) is produced by <{}> but never consumed".format(
+					name, ids[name], services[label]))
+				ok = False
+
+	for label in wildcard:
+		log("Service <{}> declares no consumed ids, it receives every broadcast".format(
+			services[label]))
+	return ok
+
+def service_ref(label, replicated):
+	# Routes hold the first replica, the broadcast fans out to the others
+	if label in replicated:
+		return "&__service_def_{}[0]".format(label)
+	return "&__service_def_{}".format(label)
+
+def write_c(path, services, replicated, consumes, ids):
+	routes = {}
+	for label in consumes:
+		for name in consumes[label]:
+			routes.setdefault(ids[name], (name, set()))[1].add(label)
+	wildcard = sorted(l for l in services if l not in consumes)
+
+	out = []
+	out.append("/* Generated by scripts/gen_routes.py, do not edit. */")
+	out.append("")
+	out.append("#include \"framework.h\"")
+	out.append("#include \"service_routes.h\"")
+	out.append("")
+	out.append("#if CONFIG_SERVICE_ROUTES_ENABLE")
+	out.append("")
+	for label in sorted(services):
+		out.append("extern service_t __service_def_{}{};".format(label,
+			"[]" if label in replicated else ""))
+	out.append("")
+	out.append("service_t* const service_routes_default[] =")
+	out.append("{")
+	for label in wildcard:
+		out.append("    {},".format(service_ref(label, replicated)))
+	out.append("    NULL,")
+	out.append("};")
+	for value in sorted(routes):
+		name, labels = routes[value]
+		out.append("")
+		out.append("/* {} */".format(name))
+		out.append("static service_t* const service_route_{:x}[] =".format(value))
+		out.append("{")
+		for label in sorted(set(labels) | set(wildcard)):
+			out.append("    {},".format(service_ref(label, replicated)))
+		out.append("    NULL,")
+		out.append("};")
+	out.append("")
+	out.append("const service_route_t service_routes[] =")
+	out.append("{")
+	for value in sorted(routes):
+		out.append("    {{ 0x{:08x}, service_route_{:x} }},".format(value, value))
+	out.append("    { 0, NULL },")
+	out.append("};")
+	out.append("")
+	out.append("const uint32_t service_routes_num = {};".format(len(routes)))
+	out.append("")
+	out.append("#endif /* CONFIG_SERVICE_ROUTES_ENABLE */")
+
+	with open(path, "w") as f:
+		f.write("\n".join(out) + "\n")
+
+def write_dot(path, services, consumes, produces):
+	out = []
+	out.append("/* Generated by scripts/gen_routes.py, do not edit. */")
+	out.append("digraph service_routes {")
+	out.append("    rankdir=LR;")
+	out.append("    node [shape=box, fontsize=10];")
+	out.append("    edge [fontsize=8];")
+	for label in sorted(services):
+		out.append("    \"{}\";".format(services[label]))
+
+	producers = {}
+	for label in produces:
+		for name in produces[label]:
+			producers.setdefault(name, set()).add(label)
+
+	external = False
+	for label in sorted(consumes):
+		for name in sorted(consumes[label]):
+			sources = sorted(producers.get(name, []))
+			if not sources:
+				external = True
+				sources = [None]
+			for src in sources:
+				out.append("    \"{}\" -> \"{}\" [label=\"{}\"];".format(
+					services[src] if src else "(external)",
+					services[label],
+					name[len("MSG_ID_"):]))
+	if external:
+		out.append("    \"(external)\" [shape=ellipse, style=dashed];")
+	out.append("}")
+
+	with open(path, "w") as f:
+		f.write("\n".join(out) + "\n")
+
+def main():
+	parser = argparse.ArgumentParser(epilog="The script will recursively search"
+		" .c and .h files in the given paths for DECLARE_SERVICE(),"
+		" SERVICE_CONSUMES() and SERVICE_PRODUCES(). It fails if a produced"
+		" message id is never consumed, a service without SERVICE_CONSUMES()"
+		" consumes every id.")
+	parser.add_argument("-v", "--verbose", help="increase output verbosity",
+		action="store_true")
+	parser.add_argument("-c", "--c-output", help="generated routing table source")
+	parser.add_argument("-d", "--dot-output", help="generated Graphviz graph")
+	parser.add_argument('paths', nargs=argparse.REMAINDER,
+		help="paths to be searched recursively, separated by spaces")
+	args = parser.parse_args()
+
+	if args.verbose:
+		global VERBOSE
+		VERBOSE=True
+	if not args.paths:
+		print("No paths specified.\n")
+		parser.print_help()
+		return 1
+
+	sources = [(f, read_source(f)) for f in find_files(args.paths)]
+	ids = parse_ids(sources)
+	log("{} files, {} message ids".format(len(sources), len(ids)))
+
+	ok, services, replicated, consumes, produces = parse_routes(sources, ids)
+	ok = validate(services, consumes, produces, ids) and ok
+	if not ok:
+		return 1
+
+	log("{} services, {} consumed ids".format(len(services),
+		len(set().union(*consumes.values())) if consumes else 0))
+
+	if args.c_output:
+		os.makedirs(os.path.dirname(os.path.abspath(args.c_output)), exist_ok=True)
+		write_c(args.c_output, services, replicated, consumes, ids)
+	if args.dot_output:
+		os.makedirs(os.path.dirname(os.path.abspath(args.dot_output)), exist_ok=True)
+		write_dot(args.dot_output, services, consumes, produces)
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
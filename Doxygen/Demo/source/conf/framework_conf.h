@@ -21,4 +21,178 @@
 
 #define CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS 50
 
+/* Thread local storage slot holding the handle of a service thread,
+ * configNUM_THREAD_LOCAL_STORAGE_POINTERS must be above it. */
+#define CONFIG_SERVICE_TLS_INDEX 0
+
+/* Naturally aligned 32 bytes message_t instead of the packed 20 bytes layout,
+ * queue slots keep the alignment of the RTOS. */
+#ifndef CONFIG_MSG_LAYOUT_ALIGNED
+#define CONFIG_MSG_LAYOUT_ALIGNED 0
+#endif
+
+/* Message payload pool, block counts must stay below 65535 per class. */
+#ifndef CONFIG_PAYLOAD_POOL_ENABLE
+#define CONFIG_PAYLOAD_POOL_ENABLE 0
+#endif
+#define CONFIG_PAYLOAD_SMALL_SIZE 32
+#define CONFIG_PAYLOAD_SMALL_COUNT 16
+#define CONFIG_PAYLOAD_MEDIUM_SIZE 128
+#define CONFIG_PAYLOAD_MEDIUM_COUNT 8
+#define CONFIG_PAYLOAD_LARGE_SIZE 512
+#define CONFIG_PAYLOAD_LARGE_COUNT 4
+
+/* Service stack high-water-mark monitor. */
+#ifndef CONFIG_SERVICE_STACK_MONITOR_ENABLE
+#define CONFIG_SERVICE_STACK_MONITOR_ENABLE 0
+#endif
+#define CONFIG_SERVICE_STACK_MARGIN_PERCENT 25
+
+/* Interceptor chain on the message send and receive paths. */
+#ifndef CONFIG_INTERCEPTOR_ENABLE
+#define CONFIG_INTERCEPTOR_ENABLE 0
+#endif
+#define CONFIG_INTERCEPTOR_MAX 8
+
+/* Parameterless messages in the signal table are delivered by thread flags. */
+#ifndef CONFIG_SERVICE_SIGNAL_ENABLE
+#define CONFIG_SERVICE_SIGNAL_ENABLE 0
+#endif
+
+/* Shared memory transport between processes, Linux hosts only. */
+#ifndef CONFIG_TRANSPORT_SHM_ENABLE
+#define CONFIG_TRANSPORT_SHM_ENABLE 0
+#endif
+#define CONFIG_TRANSPORT_SHM_PREFIX "/svc."
+#define CONFIG_TRANSPORT_SHM_NAME_MAX 32
+#define CONFIG_TRANSPORT_SHM_PROXY_MAX 8
+#define CONFIG_TRANSPORT_SHM_STALL_MS 100 /* Claimed slot age before its sender is checked. */
+
+/* Framed serial bridge to services on another processor. */
+#ifndef CONFIG_BRIDGE_ENABLE
+#define CONFIG_BRIDGE_ENABLE 0
+#endif
+#define CONFIG_BRIDGE_FRAME_SIZE 256
+#define CONFIG_BRIDGE_FLUSH_DEADLINE_MS 5
+#define CONFIG_BRIDGE_TX_RING_SIZE 64 /* Power of two. */
+#define CONFIG_BRIDGE_STACK_SIZE 1024
+#define CONFIG_BRIDGE_SERVICE_MAX 32 /* Local services reachable from the other side. */
+
+/* Service core affinity, SMP kernels only. */
+#ifndef CONFIG_SERVICE_AFFINITY_ENABLE
+#define CONFIG_SERVICE_AFFINITY_ENABLE 0
+#endif
+#define CONFIG_SERVICE_CORE_NUM 2
+
+/* Traffic based placement of the services, needs CONFIG_SERVICE_AFFINITY_ENABLE. */
+#ifndef CONFIG_SERVICE_TRAFFIC_ENABLE
+#define CONFIG_SERVICE_TRAFFIC_ENABLE 0
+#endif
+#define CONFIG_SERVICE_TRAFFIC_MAX 16 /* Services tracked in the traffic matrix. */
+
+/* Synchronous request/response with priority inheritance. */
+#ifndef CONFIG_SERVICE_REQUEST_ENABLE
+#define CONFIG_SERVICE_REQUEST_ENABLE 0
+#endif
+#define CONFIG_SERVICE_REQUEST_MAX 16 /* Outstanding requests, at most 2048. */
+
+/* Queue sizing recommendations from the observed load. */
+#ifndef CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+#define CONFIG_SERVICE_QUEUE_TUNE_ENABLE 0
+#endif
+#define CONFIG_SERVICE_QUEUE_TUNE_MAX 16 /* Services tracked. */
+#define CONFIG_SERVICE_QUEUE_TUNE_BUCKETS 32 /* Occupancy histogram size. */
+#define CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM 1000 /* Target drop probability. */
+#define CONFIG_SERVICE_QUEUE_TUNE_COUNT_MAX 256
+
+/* Message handler time budget watchdog. */
+#ifndef CONFIG_SERVICE_WATCHDOG_ENABLE
+#define CONFIG_SERVICE_WATCHDOG_ENABLE 0
+#endif
+#define CONFIG_SERVICE_WATCHDOG_PERIOD_MS 10
+#define CONFIG_SERVICE_WATCHDOG_NOTIFY 1 /* Send MSG_ID_SYS_HANDLER_OVERRUN to the subscribed services. */
+#define CONFIG_SERVICE_WATCHDOG_LOG 8
+#define CONFIG_SERVICE_WATCHDOG_MAX 16 /* Services tracked. */
+#define CONFIG_SERVICE_WATCHDOG_STACK_SIZE 512
+
+/* Interrupt posting ring drained by a dispatcher thread. */
+#ifndef CONFIG_SERVICE_ISR_RING_ENABLE
+#define CONFIG_SERVICE_ISR_RING_ENABLE 0
+#endif
+#define CONFIG_SERVICE_ISR_RING_SIZE 32 /* Power of two. */
+#define CONFIG_SERVICE_ISR_STACK_SIZE 512
+
+/* Broadcast through the routing tables generated at build time (make ROUTES=y). */
+#ifndef CONFIG_SERVICE_ROUTES_ENABLE
+#define CONFIG_SERVICE_ROUTES_ENABLE 0
+#endif
+
+/* Single-producer single-consumer streams with watermark notification. */
+#ifndef CONFIG_SERVICE_STREAM_ENABLE
+#define CONFIG_SERVICE_STREAM_ENABLE 0
+#endif
+#define CONFIG_SERVICE_STREAM_MAX 16
+
+/* Replicated services, see DECLARE_SERVICE_REPLICATED(). */
+#ifndef CONFIG_SERVICE_REPLICA_ENABLE
+#define CONFIG_SERVICE_REPLICA_ENABLE 0
+#endif
+
+/* Credit-based flow control channels. */
+#ifndef CONFIG_SERVICE_CREDIT_ENABLE
+#define CONFIG_SERVICE_CREDIT_ENABLE 0
+#endif
+#define CONFIG_SERVICE_CREDIT_MAX 16
+
+/* Message deadlines and expiry at dequeue, needs CONFIG_MSG_LAYOUT_ALIGNED. */
+#ifndef CONFIG_MSG_DEADLINE_ENABLE
+#define CONFIG_MSG_DEADLINE_ENABLE 0
+#endif
+#define CONFIG_MSG_DEADLINE_EDF_BATCH 8 /* Messages ordered at once with SERVICE_FLAG_EDF. */
+
+/* Token-bucket rate limits on the send path. */
+#ifndef CONFIG_SERVICE_RATE_ENABLE
+#define CONFIG_SERVICE_RATE_ENABLE 0
+#endif
+#define CONFIG_SERVICE_RATE_MAX 16 /* Limiters. */
+
+/* Shared state board of seqlock protected slots. */
+#ifndef CONFIG_SERVICE_STATE_ENABLE
+#define CONFIG_SERVICE_STATE_ENABLE 0
+#endif
+#define CONFIG_SERVICE_STATE_SIZE 16 /* Largest slot value in bytes. */
+
+/* Stackless coroutines in the message handlers. */
+#ifndef CONFIG_SERVICE_CO_ENABLE
+#define CONFIG_SERVICE_CO_ENABLE 0
+#endif
+
+/* Message pool shared by the queues of the services with SERVICE_FLAG_SHARED_POOL. */
+#ifndef CONFIG_SERVICE_POOL_ENABLE
+#define CONFIG_SERVICE_POOL_ENABLE 0
+#endif
+#define CONFIG_SERVICE_POOL_SIZE 64 /* Messages, below 65535. */
+#define CONFIG_SERVICE_POOL_QUEUES 16 /* Services attached. */
+#define CONFIG_SERVICE_POOL_CB_SIZE 80 /* Bytes of an RTOS queue or semaphore control block, StaticQueue_t. */
+
+/* Handler CPU time accounting and 1 s/10 s/60 s load averages. */
+#ifndef CONFIG_SERVICE_LOAD_ENABLE
+#define CONFIG_SERVICE_LOAD_ENABLE 0
+#endif
+#define CONFIG_SERVICE_LOAD_THREAD 1 /* 0 to call service_load_update() every second from a timer. */
+#define CONFIG_SERVICE_LOAD_MAX 16 /* Services tracked. */
+#define CONFIG_SERVICE_LOAD_IDS 64 /* Service and message id pairs tracked. */
+#define CONFIG_SERVICE_LOAD_STACK_SIZE 512
+
+/* Per-service receive loops calling the message handler by name, make DIRECT=y. */
+#ifndef CONFIG_SERVICE_DIRECT_ENABLE
+#define CONFIG_SERVICE_DIRECT_ENABLE 0
+#endif
+
+/* Multicast groups of services resolved at object_init(). */
+#ifndef CONFIG_SERVICE_GROUP_ENABLE
+#define CONFIG_SERVICE_GROUP_ENABLE 0
+#endif
+#define CONFIG_SERVICE_GROUP_MEMBERS 32 /* Members per group, 32 at most. */
+
 #endif /* __FRAMEWORK_CONF__ */
@@ -63,6 +63,19 @@ typedef enum {
 
 #define osWaitForever       0xFFFFFFFFU 
 
+#define osFlagsWaitAny        0x00000000U ///< Wait for any flag (default).
+#define osFlagsWaitAll        0x00000001U ///< Wait for all flags.
+#define osFlagsNoClear        0x00000002U ///< Do not clear flags which have been specified to wait for.
+
+#define osFlagsError          0x80000000U ///< Error indicator.
+#define osFlagsErrorUnknown   0xFFFFFFFFU ///< osError (-1).
+#define osFlagsErrorTimeout   0xFFFFFFFEU ///< osErrorTimeout (-2).
+#define osFlagsErrorResource  0xFFFFFFFDU ///< osErrorResource (-3).
+#define osFlagsErrorParameter 0xFFFFFFFCU ///< osErrorParameter (-4).
+#define osFlagsErrorISR       0xFFFFFFFAU ///< osErrorISR (-6).
+
+#define osMutexRecursive      0x00000001U ///< Recursive mutex.
+
 typedef uint32_t TZ_ModuleId_t;
 
 /// \details Thread ID identifies the thread.
@@ -99,6 +112,22 @@ typedef struct {
   uint32_t                  reserved;   ///< reserved (must be 0)
 } osThreadAttr_t;
 
+/// Attributes structure for mutex.
+typedef struct {
+  const char                   *name;   ///< name of the mutex
+  uint32_t                 attr_bits;   ///< attribute bits
+  void                      *cb_mem;    ///< memory for control block
+  uint32_t                   cb_size;   ///< size of provided memory for control block
+} osMutexAttr_t;
+
+/// Attributes structure for semaphore.
+typedef struct {
+  const char                   *name;   ///< name of the semaphore
+  uint32_t                 attr_bits;   ///< attribute bits
+  void                      *cb_mem;    ///< memory for control block
+  uint32_t                   cb_size;   ///< size of provided memory for control block
+} osSemaphoreAttr_t;
+
 /// Attributes structure for message queue.
 typedef struct {
   const char                   *name;   ///< name of the message queue
@@ -122,7 +151,49 @@ typedef enum {
 } osStatus_t;
 
 typedef long             BaseType_t;
+typedef unsigned long    UBaseType_t;
+typedef void *TaskHandle_t;
 
+typedef void (*osThreadFunc_t) (void *argument);
+
+#if defined(CONFIG_OS_SIM) && CONFIG_OS_SIM
+/* Implemented by the simulation backend, see source/sim/os_sim.c. */
+extern uint32_t dbg_cli_get_tick(void);
+extern int32_t dbg_cli_output(const char* format, ...);
+extern osStatus_t osMessageQueueGet (osMessageQueueId_t mq_id, void *msg_ptr, uint8_t *msg_prio, uint32_t timeout);
+extern osStatus_t osMessageQueuePut (osMessageQueueId_t mq_id, const void *msg_ptr, uint8_t msg_prio, uint32_t timeout);
+extern osMessageQueueId_t osMessageQueueNew (uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t *attr);
+extern uint32_t osMessageQueueGetCount (osMessageQueueId_t mq_id);
+extern osStatus_t osMessageQueueDelete (osMessageQueueId_t mq_id);
+extern osThreadId_t osThreadNew (osThreadFunc_t func, void *argument, const osThreadAttr_t *attr);
+extern osThreadId_t osThreadGetId (void);
+extern osStatus_t osThreadTerminate (osThreadId_t thread_id);
+extern const char *osThreadGetName (osThreadId_t thread_id);
+extern uint32_t osThreadFlagsSet (osThreadId_t thread_id, uint32_t flags);
+extern uint32_t osThreadFlagsWait (uint32_t flags, uint32_t options, uint32_t timeout);
+extern uint32_t osThreadFlagsClear (uint32_t flags);
+extern osPriority_t osThreadGetPriority (osThreadId_t thread_id);
+extern osStatus_t osThreadSetPriority (osThreadId_t thread_id, osPriority_t priority);
+extern osMutexId_t osMutexNew (const osMutexAttr_t *attr);
+extern osStatus_t osMutexAcquire (osMutexId_t mutex_id, uint32_t timeout);
+extern osStatus_t osMutexRelease (osMutexId_t mutex_id);
+extern osSemaphoreId_t osSemaphoreNew (uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr);
+extern osStatus_t osSemaphoreAcquire (osSemaphoreId_t semaphore_id, uint32_t timeout);
+extern osStatus_t osSemaphoreRelease (osSemaphoreId_t semaphore_id);
+extern uint32_t osSemaphoreGetCount (osSemaphoreId_t semaphore_id);
+extern osStatus_t osSemaphoreDelete (osSemaphoreId_t semaphore_id);
+extern osStatus_t osDelay (uint32_t ticks);
+extern uint32_t osThreadGetStackSize (osThreadId_t thread_id);
+extern uint32_t osThreadGetStackSpace (osThreadId_t thread_id);
+extern void vTaskCoreAffinitySet( const TaskHandle_t xTask, UBaseType_t uxCoreAffinityMask );
+extern void vTaskSetThreadLocalStoragePointer( TaskHandle_t xTaskToSet, BaseType_t xIndex, void *pvValue );
+extern void *pvTaskGetThreadLocalStoragePointer( TaskHandle_t xTaskToQuery, BaseType_t xIndex );
+extern BaseType_t xPortIsInsideInterrupt( void );
+extern uint32_t osKernelGetTickCount (void);
+extern uint32_t osKernelGetTickFreq (void);
+extern uint32_t osKernelGetSysTimerCount (void);
+extern uint32_t osKernelGetSysTimerFreq (void);
+#else
 inline uint32_t dbg_cli_get_tick(void)
 {
     return 0;
@@ -148,17 +219,26 @@ inline osMessageQueueId_t osMessageQueueNew (uint32_t msg_count, uint32_t msg_si
     return NULL;
 }
 
+inline uint32_t osMessageQueueGetCount (osMessageQueueId_t mq_id)
+{
+    return 0;
+}
+
 inline osStatus_t osMessageQueueDelete (osMessageQueueId_t mq_id)
 {
     return osOK;
 }
 
-typedef void (*osThreadFunc_t) (void *argument);
 inline osThreadId_t osThreadNew (osThreadFunc_t func, void *argument, const osThreadAttr_t *attr)
 {
     return NULL;
 }
 
+inline osThreadId_t osThreadGetId (void)
+{
+    return NULL;
+}
+
 inline osStatus_t osThreadTerminate (osThreadId_t thread_id)
 {
     return osOK;
@@ -169,14 +249,123 @@ inline const char *osThreadGetName (osThreadId_t thread_id)
     return NULL;
 }
 
+inline uint32_t osThreadFlagsSet (osThreadId_t thread_id, uint32_t flags)
+{
+    return flags;
+}
+
+inline uint32_t osThreadFlagsWait (uint32_t flags, uint32_t options, uint32_t timeout)
+{
+    return osFlagsError;
+}
+
+inline uint32_t osThreadFlagsClear (uint32_t flags)
+{
+    return 0;
+}
+
+inline osPriority_t osThreadGetPriority (osThreadId_t thread_id)
+{
+    return osPriorityNormal;
+}
+
+inline osStatus_t osThreadSetPriority (osThreadId_t thread_id, osPriority_t priority)
+{
+    return osOK;
+}
+
+inline osMutexId_t osMutexNew (const osMutexAttr_t *attr)
+{
+    return NULL;
+}
+
+inline osStatus_t osMutexAcquire (osMutexId_t mutex_id, uint32_t timeout)
+{
+    return osOK;
+}
+
+inline osStatus_t osMutexRelease (osMutexId_t mutex_id)
+{
+    return osOK;
+}
+
+inline osSemaphoreId_t osSemaphoreNew (uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t *attr)
+{
+    return NULL;
+}
+
+inline osStatus_t osSemaphoreAcquire (osSemaphoreId_t semaphore_id, uint32_t timeout)
+{
+    return osOK;
+}
+
+inline osStatus_t osSemaphoreRelease (osSemaphoreId_t semaphore_id)
+{
+    return osOK;
+}
+
+inline uint32_t osSemaphoreGetCount (osSemaphoreId_t semaphore_id)
+{
+    return 0;
+}
+
+inline osStatus_t osSemaphoreDelete (osSemaphoreId_t semaphore_id)
+{
+    return osOK;
+}
+
+inline osStatus_t osDelay (uint32_t ticks)
+{
+    return osOK;
+}
+
+inline uint32_t osThreadGetStackSize (osThreadId_t thread_id)
+{
+    return 0;
+}
+
+inline uint32_t osThreadGetStackSpace (osThreadId_t thread_id)
+{
+    return 0;
+}
+
+inline void vTaskCoreAffinitySet( const TaskHandle_t xTask, UBaseType_t uxCoreAffinityMask )
+{
+}
+
+inline void vTaskSetThreadLocalStoragePointer( TaskHandle_t xTaskToSet, BaseType_t xIndex, void *pvValue )
+{
+}
+
+inline void *pvTaskGetThreadLocalStoragePointer( TaskHandle_t xTaskToQuery, BaseType_t xIndex )
+{
+    return 0;
+}
+
 inline static BaseType_t xPortIsInsideInterrupt( void )
 {
     return 0;
 }
 
+inline uint32_t osKernelGetTickCount (void)
+{
+    return 0;
+}
+
 inline uint32_t osKernelGetTickFreq (void)
 {
     return 0;
 }
 
+inline uint32_t osKernelGetSysTimerCount (void)
+{
+    return 0;
+}
+
+inline uint32_t osKernelGetSysTimerFreq (void)
+{
+    return 0;
+}
+#endif
+
 #endif  // CMSIS_OS_H_
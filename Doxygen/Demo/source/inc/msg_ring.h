@@ -0,0 +1,67 @@
+/**
+ * @file source/inc/msg_ring.h
+ * @brief Definition the lock-free message ring.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MSG_RING_H__
+#define __MSG_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "message.h"
+
+/**
+ * @brief   Message ring slot.
+ */
+typedef struct
+{
+    uint32_t    seq;        /**< Slot sequence, tells producers and the consumer who owns the slot. */
+    uint32_t    tag;        /**< User tag stored along with the message. */
+    message_t   message;    /**< Message storage. */
+} msg_ring_slot_t;
+
+/**
+ * @brief   Bounded multi-producer single-consumer message ring.
+ *
+ * The ring holds no pointers, so it can be placed in memory shared
+ * between processes. Producers claim a slot with a CAS on the head and
+ * publish it through the slot sequence, the consumer owns the tail.
+ */
+typedef struct
+{
+    uint32_t        mask;                           /**< Slot count - 1, the count is a power of two. */
+    uint32_t        head __attribute__((aligned(64)));  /**< Next position to produce. */
+    uint32_t        tail __attribute__((aligned(64)));  /**< Next position to consume. */
+    msg_ring_slot_t slots[] __attribute__((aligned(64)));   /**< Slot storage. */
+} msg_ring_t;
+
+extern uint32_t msg_ring_mem_size(uint32_t count);
+extern int32_t msg_ring_init(msg_ring_t* ring, uint32_t count);
+extern msg_ring_slot_t* msg_ring_reserve(msg_ring_t* ring);
+extern void msg_ring_commit(msg_ring_t* ring, msg_ring_slot_t* slot);
+extern msg_ring_slot_t* msg_ring_peek(msg_ring_t* ring);
+extern void msg_ring_consume(msg_ring_t* ring, msg_ring_slot_t* slot);
+extern int32_t msg_ring_push(msg_ring_t* ring,
+                             const message_t* message,
+                             uint32_t tag);
+extern uint32_t msg_ring_count(const msg_ring_t* ring);
+
+#endif /* __MSG_RING_H__ */
@@ -1,3 +1,24 @@
-LIB_FILES += $(SOURCE_DIR)/source/src/message.c \
+LIB_FILES += $(SOURCE_DIR)/source/src/bridge.c \
+			 $(SOURCE_DIR)/source/src/interceptor.c \
+			 $(SOURCE_DIR)/source/src/message.c \
+			 $(SOURCE_DIR)/source/src/msg_ring.c \
 			 $(SOURCE_DIR)/source/src/object.c \
-			 $(SOURCE_DIR)/source/src/service.c
+			 $(SOURCE_DIR)/source/src/payload.c \
+			 $(SOURCE_DIR)/source/src/service.c \
+			 $(SOURCE_DIR)/source/src/service_affinity.c \
+			 $(SOURCE_DIR)/source/src/service_coroutine.c \
+			 $(SOURCE_DIR)/source/src/service_credit.c \
+			 $(SOURCE_DIR)/source/src/service_group.c \
+			 $(SOURCE_DIR)/source/src/service_isr.c \
+			 $(SOURCE_DIR)/source/src/service_load.c \
+			 $(SOURCE_DIR)/source/src/service_pool.c \
+			 $(SOURCE_DIR)/source/src/service_queue_tune.c \
+			 $(SOURCE_DIR)/source/src/service_rate.c \
+			 $(SOURCE_DIR)/source/src/service_replica.c \
+			 $(SOURCE_DIR)/source/src/service_request.c \
+			 $(SOURCE_DIR)/source/src/service_routes.c \
+			 $(SOURCE_DIR)/source/src/service_stack.c \
+			 $(SOURCE_DIR)/source/src/service_state.c \
+			 $(SOURCE_DIR)/source/src/service_stream.c \
+			 $(SOURCE_DIR)/source/src/service_watchdog.c \
+			 $(SOURCE_DIR)/source/src/transport_shm.c
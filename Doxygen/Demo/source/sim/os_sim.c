@@ -0,0 +1,1399 @@
+/**
+ * @file source/sim/os_sim.c
+ * @brief Definition the discrete-event simulation backend of the RTOS API.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "err.h"
+#include "os_sim.h"
+
+/**
+ * @defgroup OS_Sim OS Simulation
+ *
+ * @brief Run the services on a host with a virtual clock.
+ *
+ * The RTOS API is implemented by a single threaded scheduler. Every
+ * simulated thread is a host coroutine, the scheduler runs the highest
+ * priority ready thread until it blocks, and when no thread is ready the
+ * virtual clock jumps straight to the next timeout or event. Waiting
+ * costs no host time, so hours of device behaviour run in seconds.
+ *
+ * The code between two RTOS calls takes no virtual time, a thread models
+ * computation with os_sim_busy(). A thread making a higher priority
+ * thread ready is preempted at once, equal priorities run in the order
+ * they became ready, or in a pseudo random order with os_sim_seed().
+ * The same seed always gives the same interleaving.
+ *
+ * The harness main is not a simulated thread: its RTOS calls never
+ * block, and osDelay() from the harness runs the simulation for that
+ * long. Event callbacks from os_sim_at() run in simulated interrupt
+ * context, xPortIsInsideInterrupt() is true there.
+ *
+ * Mutexes inherit priority as FreeRTOS ones do: a thread blocking on a
+ * mutex raises the owner to its own priority, and the owner drops back
+ * to its base priority when it releases the last mutex it holds. A
+ * waiter timing out drops the owner to the highest of its base and its
+ * remaining waiters. A terminated thread is freed, its handle must not
+ * be used afterwards, and the mutexes it held stay locked.
+ */
+
+#ifndef DOC_HIDDEN
+#define OS_SIM_NEVER            UINT64_MAX
+#define OS_SIM_STACK_PAINT      0xA5
+
+/* Simulated thread states. */
+#define OS_SIM_READY            0
+#define OS_SIM_BLOCKED          1
+#define OS_SIM_BUSY             2
+#define OS_SIM_DELETED          3
+
+/* Thread local storage pointers per thread, configNUM_THREAD_LOCAL_STORAGE_POINTERS. */
+#define OS_SIM_TLS_MAX          4
+
+/* Characters of a log line formatted to find the function it is from. */
+#define OS_SIM_LOG_HEAD         128
+#endif
+
+/**
+ * @brief   Simulated thread.
+ */
+typedef struct _os_sim_thread_t
+{
+    ucontext_t                  ctx;        /**< Host context. */
+    struct _os_sim_thread_t*    next;       /**< Next thread in creation order. */
+    const char*                 name;       /**< Thread name. */
+    osThreadFunc_t              func;       /**< Thread function. */
+    void*                       argument;   /**< Thread function argument. */
+    uint8_t*                    stack;      /**< Host stack. */
+    osPriority_t                priority;   /**< Thread priority, raised by the mutexes it holds. */
+    osPriority_t                base;       /**< Thread priority set by the application. */
+    uint32_t                    held;       /**< Mutexes held. */
+    uint32_t                    state;      /**< OS_SIM_xxx. */
+    uint64_t                    seq;        /**< Order it became ready. */
+    uint32_t                    flags;      /**< Thread flags. */
+    const void*                 wait_obj;   /**< Object blocked on, NULL for a delay. */
+    uint64_t                    deadline;   /**< Tick the wait times out, OS_SIM_NEVER for none. */
+    uint32_t                    timedout;   /**< Non-zero if the wait timed out. */
+    uint64_t                    busy;       /**< Ticks of os_sim_busy() left. */
+    void*                       tls[OS_SIM_TLS_MAX];    /**< Thread local storage pointers. */
+} os_sim_thread_t;
+
+/**
+ * @brief   Simulated message queue.
+ */
+typedef struct
+{
+    uint8_t*    buf;            /**< Message slots. */
+    uint32_t    msg_size;       /**< Slot size. */
+    uint32_t    capacity;       /**< Slot count. */
+    uint32_t    count;          /**< Messages queued. */
+    uint32_t    head;           /**< Slot of the oldest message. */
+} os_sim_queue_t;
+
+/**
+ * @brief   Simulated semaphore.
+ */
+typedef struct
+{
+    uint32_t    count;          /**< Tokens available. */
+    uint32_t    max;            /**< Most tokens. */
+} os_sim_sem_t;
+
+/**
+ * @brief   Simulated mutex.
+ */
+typedef struct _os_sim_mutex_t
+{
+    struct _os_sim_mutex_t*     next;       /**< Next mutex in creation order. */
+    os_sim_thread_t*    owner;      /**< Owner, NULL for the harness. */
+    uint32_t            count;      /**< Lock depth, 0 if free. */
+    uint32_t            recursive;  /**< Non-zero if the owner may lock it again. */
+} os_sim_mutex_t;
+
+/**
+ * @brief   Pending event callback.
+ */
+typedef struct _os_sim_event_t
+{
+    struct _os_sim_event_t*     next;       /**< Next event, by time then order of posting. */
+    uint64_t                    at;         /**< Tick the callback runs. */
+    os_sim_event_fn             fn;         /**< Callback. */
+    void*                       arg;        /**< Callback argument. */
+} os_sim_event_t;
+
+static ucontext_t os_sim_sched_ctx;
+static os_sim_thread_t* os_sim_threads;
+static os_sim_thread_t* os_sim_threads_tail;
+static os_sim_thread_t* os_sim_current;
+static os_sim_mutex_t* os_sim_mutexes;
+static os_sim_event_t* os_sim_events;
+static uint64_t os_sim_now;
+static uint64_t os_sim_seq;
+static uint32_t os_sim_isr;
+static uint32_t os_sim_rand;
+static os_sim_stats_t os_sim_stats;
+static const char* os_sim_muted[OS_SIM_MUTE_MAX];
+static uint32_t os_sim_muted_num;
+
+/**
+ * @brief   Next pseudo random number, xorshift32.
+ *
+ * @retval  Returns the number.
+ */
+static uint32_t os_sim_random(void)
+{
+    os_sim_rand ^= os_sim_rand << 13;
+    os_sim_rand ^= os_sim_rand >> 17;
+    os_sim_rand ^= os_sim_rand << 5;
+
+    return os_sim_rand;
+}
+
+/**
+ * @brief   Convert a timeout to a deadline.
+ *
+ * @param   timeout Timeout in ticks, osWaitForever for none.
+ *
+ * @retval  Returns the deadline tick.
+ */
+static uint64_t os_sim_deadline(uint32_t timeout)
+{
+    return timeout == osWaitForever ? OS_SIM_NEVER : os_sim_now + timeout;
+}
+
+/**
+ * @brief   Make a thread ready, behind the ready threads of its priority.
+ *
+ * @param   t Pointer to the thread.
+ */
+static void os_sim_ready(os_sim_thread_t* t)
+{
+    t->state = OS_SIM_READY;
+    t->seq = ++os_sim_seq;
+    t->wait_obj = NULL;
+    t->deadline = OS_SIM_NEVER;
+}
+
+/**
+ * @brief   Pick the thread to run among the threads in a state.
+ *
+ * @param   state OS_SIM_READY or OS_SIM_BUSY.
+ *
+ * @retval  Returns the thread, or NULL if none.
+ */
+static os_sim_thread_t* os_sim_pick(uint32_t state)
+{
+    os_sim_thread_t* best = NULL;
+    os_sim_thread_t* t;
+    uint32_t ties = 0;
+
+    for (t = os_sim_threads; t; t = t->next)
+    {
+        if (t->state != state)
+        {
+            continue;
+        }
+
+        if (!best || t->priority > best->priority)
+        {
+            best = t;
+            ties = 1;
+        }
+        else if (t->priority == best->priority)
+        {
+            if (os_sim_rand)
+            {
+                if (!(os_sim_random() % ++ties))
+                {
+                    best = t;
+                }
+            }
+            else if (t->seq < best->seq)
+            {
+                best = t;
+            }
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief   Go back to the scheduler from the current thread.
+ */
+static void os_sim_schedule(void)
+{
+    (void)swapcontext(&os_sim_current->ctx, &os_sim_sched_ctx);
+}
+
+/**
+ * @brief   Let a higher priority ready thread preempt the current one.
+ */
+static void os_sim_preempt(void)
+{
+    os_sim_thread_t* t;
+
+    if (!os_sim_current || os_sim_isr)
+    {
+        return;
+    }
+
+    t = os_sim_pick(OS_SIM_READY);
+    if (t && t != os_sim_current && t->priority > os_sim_current->priority)
+    {
+        /* Still ready with its place, it resumes first among its peers. */
+        os_sim_schedule();
+    }
+}
+
+/**
+ * @brief   Wake the threads blocked on an object, they retry their call.
+ *
+ * @param   obj Object changed.
+ */
+static void os_sim_notify(const void* obj)
+{
+    os_sim_thread_t* t;
+
+    for (t = os_sim_threads; t; t = t->next)
+    {
+        if (t->state == OS_SIM_BLOCKED && t->wait_obj == obj)
+        {
+            os_sim_ready(t);
+        }
+    }
+}
+
+/**
+ * @brief   Check whether the caller may block.
+ *
+ * @retval  Returns non-zero from a simulated thread.
+ */
+static int32_t os_sim_can_block(void)
+{
+    return os_sim_current && !os_sim_isr;
+}
+
+/**
+ * @brief   Block the current thread until the object changes or the deadline.
+ *
+ * @param   obj Object waited for, NULL for a delay.
+ * @param   deadline Tick the wait times out, OS_SIM_NEVER for none.
+ *
+ * @retval  Returns 0 if the object changed, non-zero if the wait timed out.
+ */
+static int32_t os_sim_block(const void* obj, uint64_t deadline)
+{
+    os_sim_thread_t* self = os_sim_current;
+
+    self->state = OS_SIM_BLOCKED;
+    self->wait_obj = obj;
+    self->deadline = deadline;
+    self->timedout = 0;
+
+    os_sim_schedule();
+
+    return self->timedout;
+}
+
+/**
+ * @brief   Get the priority a mutex owner inherits from its waiters.
+ *
+ * @param   owner Pointer to the owner thread.
+ *
+ * @retval  Returns the highest of its base priority and the priorities
+ *          of the threads blocked on the mutexes it holds.
+ */
+static osPriority_t os_sim_inherited(const os_sim_thread_t* owner)
+{
+    const os_sim_thread_t* t;
+    const os_sim_mutex_t* m;
+    osPriority_t priority = owner->base;
+
+    for (m = os_sim_mutexes; m; m = m->next)
+    {
+        if (!m->count || m->owner != owner)
+        {
+            continue;
+        }
+
+        for (t = os_sim_threads; t; t = t->next)
+        {
+            if (t->state == OS_SIM_BLOCKED && t->wait_obj == m && t->priority > priority)
+            {
+                priority = t->priority;
+            }
+        }
+    }
+
+    return priority;
+}
+
+/**
+ * @brief   Unlink a deleted thread and free it.
+ *
+ * @param   t Pointer to the thread, not the current one.
+ */
+static void os_sim_free(os_sim_thread_t* t)
+{
+    os_sim_thread_t** link = &os_sim_threads;
+    os_sim_thread_t* prev = NULL;
+    os_sim_mutex_t* m;
+
+    while (*link != t)
+    {
+        prev = *link;
+        link = &prev->next;
+    }
+
+    *link = t->next;
+    if (os_sim_threads_tail == t)
+    {
+        os_sim_threads_tail = prev;
+    }
+
+    /* Its mutexes stay locked as on the RTOS, with no owner left to raise. */
+    for (m = os_sim_mutexes; m; m = m->next)
+    {
+        if (m->count && m->owner == t)
+        {
+            m->owner = NULL;
+        }
+    }
+
+    free(t->stack);
+    free(t);
+}
+
+/**
+ * @brief   Entry of every simulated thread.
+ */
+static void os_sim_entry(void)
+{
+    os_sim_thread_t* self = os_sim_current;
+
+    self->func(self->argument);
+
+    (void)osThreadTerminate(self);
+}
+
+/**
+ * @brief   Get the tick of the next timeout or event.
+ *
+ * @retval  Returns the tick, OS_SIM_NEVER if nothing is pending.
+ */
+static uint64_t os_sim_next(void)
+{
+    uint64_t next = os_sim_events ? os_sim_events->at : OS_SIM_NEVER;
+    const os_sim_thread_t* t;
+
+    for (t = os_sim_threads; t; t = t->next)
+    {
+        if (t->state == OS_SIM_BLOCKED && t->deadline < next)
+        {
+            next = t->deadline;
+        }
+    }
+
+    return next;
+}
+
+/**
+ * @brief   Run the events and the timeouts due at the current tick.
+ */
+static void os_sim_fire(void)
+{
+    os_sim_event_t* event;
+    os_sim_thread_t* t;
+
+    while (os_sim_events && os_sim_events->at <= os_sim_now)
+    {
+        event = os_sim_events;
+        os_sim_events = event->next;
+
+        os_sim_isr = 1;
+        event->fn(event->arg);
+        os_sim_isr = 0;
+
+        os_sim_stats.events++;
+        free(event);
+    }
+
+    for (t = os_sim_threads; t; t = t->next)
+    {
+        if (t->state == OS_SIM_BLOCKED && t->deadline <= os_sim_now)
+        {
+            os_sim_ready(t);
+            t->timedout = 1;
+        }
+    }
+}
+
+/**
+ * @brief   Seed the order of the threads of equal priority.
+ *
+ * @param   seed Seed of the pseudo random order, 0 for the order they
+ *               became ready.
+ *
+ * @ingroup OS_Sim
+ */
+void os_sim_seed(uint32_t seed)
+{
+    os_sim_rand = seed;
+}
+
+/**
+ * @brief   Run the simulation.
+ *
+ * Call it from the harness main only.
+ *
+ * @param   ticks Virtual ticks to run, osWaitForever until nothing is
+ *                left to do.
+ *
+ * @retval  Returns the virtual ticks run.
+ *
+ * @ingroup OS_Sim
+ */
+uint64_t os_sim_run(uint64_t ticks)
+{
+    uint64_t start = os_sim_now;
+    uint64_t limit = ticks == osWaitForever ? OS_SIM_NEVER : os_sim_now + ticks;
+    os_sim_thread_t* t;
+    os_sim_thread_t* b;
+    uint64_t next;
+
+    if (os_sim_current || os_sim_isr)
+    {
+        return 0;
+    }
+
+    while (1)
+    {
+        t = os_sim_pick(OS_SIM_READY);
+        b = os_sim_pick(OS_SIM_BUSY);
+
+        if (t && (!b || t->priority > b->priority))
+        {
+            os_sim_current = t;
+            os_sim_stats.switches++;
+
+            (void)swapcontext(&os_sim_sched_ctx, &t->ctx);
+
+            os_sim_current = NULL;
+
+            if (t->state == OS_SIM_DELETED)
+            {
+                os_sim_free(t);
+            }
+
+            continue;
+        }
+
+        /* Nothing can run, jump to the next event or the end of the busy time. */
+        next = os_sim_next();
+        if (b && b->busy < next - os_sim_now)
+        {
+            next = os_sim_now + b->busy;
+        }
+
+        if (next == OS_SIM_NEVER)
+        {
+            break;
+        }
+
+        if (next > limit)
+        {
+            if (b)
+            {
+                b->busy -= limit - os_sim_now;
+            }
+
+            os_sim_now = limit;
+            break;
+        }
+
+        if (b)
+        {
+            b->busy -= next - os_sim_now;
+            if (!b->busy)
+            {
+                /* It was running, it keeps its place. */
+                b->state = OS_SIM_READY;
+            }
+        }
+
+        if (next > os_sim_now)
+        {
+            os_sim_stats.jumps++;
+            os_sim_now = next;
+        }
+
+        os_sim_fire();
+    }
+
+    return os_sim_now - start;
+}
+
+/**
+ * @brief   Run a callback in simulated interrupt context.
+ *
+ * @param   delay Ticks from now.
+ * @param   fn Callback, it may post the next event itself.
+ * @param   arg Callback argument.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup OS_Sim
+ */
+int32_t os_sim_at(uint32_t delay, os_sim_event_fn fn, void* arg)
+{
+    os_sim_event_t* event;
+    os_sim_event_t** pos;
+
+    if (!fn)
+    {
+        return -EINVAL;
+    }
+
+    event = calloc(1, sizeof(*event));
+    if (!event)
+    {
+        return -ENOMEM;
+    }
+
+    event->at = os_sim_now + delay;
+    event->fn = fn;
+    event->arg = arg;
+
+    for (pos = &os_sim_events; *pos && (*pos)->at <= event->at; pos = &(*pos)->next)
+    {
+    }
+
+    event->next = *pos;
+    *pos = event;
+
+    return 0;
+}
+
+/**
+ * @brief   Keep the processor busy for a while in the current thread.
+ *
+ * Higher priority threads run meanwhile, lower ones wait. Nothing
+ * happens outside a simulated thread.
+ *
+ * @param   ticks Virtual ticks of computation.
+ *
+ * @ingroup OS_Sim
+ */
+void os_sim_busy(uint32_t ticks)
+{
+    if (!os_sim_can_block() || !ticks)
+    {
+        return;
+    }
+
+    os_sim_current->state = OS_SIM_BUSY;
+    os_sim_current->busy = ticks;
+
+    os_sim_schedule();
+}
+
+/**
+ * @brief   Drop the log lines of a function, like the trace of every send.
+ *
+ * @param   function Function name as logged.
+ *
+ * @retval  Returns 0 on success, -ENOSPC if too many are muted.
+ *
+ * @ingroup OS_Sim
+ */
+int32_t os_sim_log_mute(const char* function)
+{
+    if (!function)
+    {
+        return -EINVAL;
+    }
+
+    if (os_sim_muted_num >= OS_SIM_MUTE_MAX)
+    {
+        return -ENOSPC;
+    }
+
+    os_sim_muted[os_sim_muted_num++] = function;
+
+    return 0;
+}
+
+/**
+ * @brief   Get the simulation statistics.
+ *
+ * @param   stats Output of the statistics.
+ *
+ * @ingroup OS_Sim
+ */
+void os_sim_get_stats(os_sim_stats_t* stats)
+{
+    const os_sim_thread_t* t;
+
+    if (!stats)
+    {
+        return;
+    }
+
+    *stats = os_sim_stats;
+    stats->now = os_sim_now;
+
+    for (t = os_sim_threads; t; t = t->next)
+    {
+        if (t->state == OS_SIM_DELETED)
+        {
+            continue;
+        }
+
+        stats->threads++;
+
+        if (t->state == OS_SIM_BLOCKED && t->deadline == OS_SIM_NEVER)
+        {
+            stats->blocked++;
+        }
+    }
+}
+
+uint32_t dbg_cli_get_tick(void)
+{
+    return (uint32_t)os_sim_now;
+}
+
+/**
+ * @brief   Check if a log line is from a muted function.
+ *
+ * @param   line Log line, formatted at least up to the function name.
+ *
+ * @retval  Returns non-zero if the function is muted.
+ */
+static int32_t os_sim_log_muted(const char* line)
+{
+    const char* function = strstr(line, "][");
+    const char* end;
+    uint32_t i;
+
+    /* [level][tick][function][line], skip the level and the tick. */
+    function = function ? strstr(function + 2, "][") : NULL;
+    end = function ? strstr(function + 2, "][") : NULL;
+    if (!end)
+    {
+        return 0;
+    }
+
+    function += 2;
+    for (i = 0; i < os_sim_muted_num; i++)
+    {
+        if (strlen(os_sim_muted[i]) == (size_t)(end - function) &&
+            !strncmp(function, os_sim_muted[i], (size_t)(end - function)))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int32_t dbg_cli_output(const char* format, ...)
+{
+    const char* prefix = strstr(format, "[%d][%s][%d] ");
+    char head[OS_SIM_LOG_HEAD];
+    va_list args;
+    int32_t ret;
+
+    /* Lines of the log macros name their function after the tick. */
+    if (os_sim_muted_num && prefix && prefix - format < 16)
+    {
+        va_start(args, format);
+        (void)vsnprintf(head, sizeof(head), format, args);
+        va_end(args);
+
+        if (os_sim_log_muted(head))
+        {
+            return 0;
+        }
+    }
+
+    va_start(args, format);
+    ret = vprintf(format, args);
+    va_end(args);
+
+    return ret;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+    return (uint32_t)os_sim_now;
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+    return OS_SIM_TICK_FREQ;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+    return (uint32_t)(os_sim_now * (OS_SIM_SYS_TIMER_FREQ / OS_SIM_TICK_FREQ));
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+    return OS_SIM_SYS_TIMER_FREQ;
+}
+
+BaseType_t xPortIsInsideInterrupt(void)
+{
+    return os_sim_isr;
+}
+
+void vTaskCoreAffinitySet(const TaskHandle_t xTask, UBaseType_t uxCoreAffinityMask)
+{
+    (void)xTask;
+    (void)uxCoreAffinityMask;
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t xTaskToSet, BaseType_t xIndex, void* pvValue)
+{
+    os_sim_thread_t* t = xTaskToSet ? (os_sim_thread_t*)xTaskToSet : os_sim_current;
+
+    if (t && xIndex >= 0 && xIndex < OS_SIM_TLS_MAX)
+    {
+        t->tls[xIndex] = pvValue;
+    }
+}
+
+void* pvTaskGetThreadLocalStoragePointer(TaskHandle_t xTaskToQuery, BaseType_t xIndex)
+{
+    os_sim_thread_t* t = xTaskToQuery ? (os_sim_thread_t*)xTaskToQuery : os_sim_current;
+
+    if (!t || xIndex < 0 || xIndex >= OS_SIM_TLS_MAX)
+    {
+        return NULL;
+    }
+
+    return t->tls[xIndex];
+}
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr)
+{
+    os_sim_thread_t* t;
+
+    if (!func || os_sim_isr)
+    {
+        return NULL;
+    }
+
+    t = calloc(1, sizeof(*t));
+    if (!t)
+    {
+        return NULL;
+    }
+
+    /* The configured stack memory and size fit the device, not the host. */
+    t->stack = malloc(OS_SIM_STACK_SIZE);
+    if (!t->stack)
+    {
+        free(t);
+        return NULL;
+    }
+
+    (void)memset(t->stack, OS_SIM_STACK_PAINT, OS_SIM_STACK_SIZE);
+
+    t->name = attr ? attr->name : NULL;
+    t->func = func;
+    t->argument = argument;
+    t->priority = (attr && attr->priority != osPriorityNone) ? attr->priority : osPriorityNormal;
+    t->base = t->priority;
+
+    (void)getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = OS_SIM_STACK_SIZE;
+    t->ctx.uc_link = &os_sim_sched_ctx;
+    makecontext(&t->ctx, os_sim_entry, 0);
+
+    if (os_sim_threads_tail)
+    {
+        os_sim_threads_tail->next = t;
+    }
+    else
+    {
+        os_sim_threads = t;
+    }
+
+    os_sim_threads_tail = t;
+
+    os_sim_ready(t);
+    os_sim_preempt();
+
+    return t;
+}
+
+osThreadId_t osThreadGetId(void)
+{
+    return os_sim_isr ? NULL : os_sim_current;
+}
+
+osStatus_t osThreadTerminate(osThreadId_t thread_id)
+{
+    os_sim_thread_t* t = thread_id;
+
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    if (!t || t->state == OS_SIM_DELETED)
+    {
+        return osErrorParameter;
+    }
+
+    t->state = OS_SIM_DELETED;
+
+    if (t == os_sim_current)
+    {
+        /* The scheduler frees the stack we run on, never returns. */
+        os_sim_schedule();
+    }
+
+    os_sim_free(t);
+
+    return osOK;
+}
+
+const char* osThreadGetName(osThreadId_t thread_id)
+{
+    const os_sim_thread_t* t = thread_id;
+
+    return t ? t->name : NULL;
+}
+
+osPriority_t osThreadGetPriority(osThreadId_t thread_id)
+{
+    const os_sim_thread_t* t = thread_id;
+
+    return t ? t->priority : osPriorityError;
+}
+
+osStatus_t osThreadSetPriority(osThreadId_t thread_id, osPriority_t priority)
+{
+    os_sim_thread_t* t = thread_id;
+
+    if (!t || priority < osPriorityIdle || priority > osPriorityISR)
+    {
+        return osErrorParameter;
+    }
+
+    /* An inherited priority above it holds until the mutexes are released. */
+    t->base = priority;
+    if (!t->held || priority > t->priority)
+    {
+        t->priority = priority;
+    }
+
+    os_sim_preempt();
+
+    return osOK;
+}
+
+uint32_t osThreadGetStackSize(osThreadId_t thread_id)
+{
+    return thread_id ? OS_SIM_STACK_SIZE : 0;
+}
+
+uint32_t osThreadGetStackSpace(osThreadId_t thread_id)
+{
+    const os_sim_thread_t* t = thread_id;
+    uint32_t space = 0;
+
+    if (!t || !t->stack)
+    {
+        return 0;
+    }
+
+    /* The stack grows down, the paint left at the bottom was never used. */
+    while (space < OS_SIM_STACK_SIZE && t->stack[space] == OS_SIM_STACK_PAINT)
+    {
+        space++;
+    }
+
+    return space;
+}
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+    os_sim_thread_t* t = thread_id;
+    uint32_t ret;
+
+    if (!t || t->state == OS_SIM_DELETED || (flags & osFlagsError))
+    {
+        return osFlagsErrorParameter;
+    }
+
+    t->flags |= flags;
+    ret = t->flags;
+
+    os_sim_notify(t);
+    os_sim_preempt();
+
+    return ret;
+}
+
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+    os_sim_thread_t* self = os_sim_current;
+    uint64_t deadline = os_sim_deadline(timeout);
+    uint32_t match;
+    uint32_t ret;
+
+    if (os_sim_isr)
+    {
+        return osFlagsErrorISR;
+    }
+
+    if (!self || (flags & osFlagsError))
+    {
+        return osFlagsErrorParameter;
+    }
+
+    while (1)
+    {
+        match = self->flags & flags;
+        if ((options & osFlagsWaitAll) ? match == flags : match != 0)
+        {
+            break;
+        }
+
+        if (!timeout)
+        {
+            return osFlagsErrorResource;
+        }
+
+        if (os_sim_block(self, deadline))
+        {
+            return osFlagsErrorTimeout;
+        }
+    }
+
+    ret = self->flags;
+
+    if (!(options & osFlagsNoClear))
+    {
+        self->flags &= ~flags;
+    }
+
+    return ret;
+}
+
+uint32_t osThreadFlagsClear(uint32_t flags)
+{
+    os_sim_thread_t* self = os_sim_current;
+    uint32_t ret;
+
+    if (os_sim_isr)
+    {
+        return osFlagsErrorISR;
+    }
+
+    if (!self)
+    {
+        return osFlagsErrorUnknown;
+    }
+
+    ret = self->flags;
+    self->flags &= ~flags;
+
+    return ret;
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    if (!os_sim_current)
+    {
+        /* From the harness, let the simulation run meanwhile. */
+        (void)os_sim_run(ticks);
+        return osOK;
+    }
+
+    if (ticks)
+    {
+        (void)os_sim_block(NULL, os_sim_deadline(ticks));
+    }
+
+    return osOK;
+}
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t* attr)
+{
+    os_sim_queue_t* q;
+
+    (void)attr;
+
+    if (!msg_count || !msg_size || os_sim_isr)
+    {
+        return NULL;
+    }
+
+    q = calloc(1, sizeof(*q));
+    if (!q)
+    {
+        return NULL;
+    }
+
+    q->buf = calloc(msg_count, msg_size);
+    if (!q->buf)
+    {
+        free(q);
+        return NULL;
+    }
+
+    q->msg_size = msg_size;
+    q->capacity = msg_count;
+
+    return q;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout)
+{
+    os_sim_queue_t* q = mq_id;
+    uint64_t deadline = os_sim_deadline(timeout);
+
+    (void)msg_prio;
+
+    if (!q || !msg_ptr || (os_sim_isr && timeout))
+    {
+        return osErrorParameter;
+    }
+
+    while (q->count == q->capacity)
+    {
+        if (!timeout || !os_sim_can_block())
+        {
+            return osErrorResource;
+        }
+
+        if (os_sim_block(q, deadline))
+        {
+            return osErrorTimeout;
+        }
+    }
+
+    (void)memcpy(q->buf + ((q->head + q->count) % q->capacity) * q->msg_size,
+                 msg_ptr,
+                 q->msg_size);
+    q->count++;
+
+    os_sim_notify(q);
+    os_sim_preempt();
+
+    return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout)
+{
+    os_sim_queue_t* q = mq_id;
+    uint64_t deadline = os_sim_deadline(timeout);
+
+    if (!q || !msg_ptr || (os_sim_isr && timeout))
+    {
+        return osErrorParameter;
+    }
+
+    while (!q->count)
+    {
+        if (!timeout || !os_sim_can_block())
+        {
+            return osErrorResource;
+        }
+
+        if (os_sim_block(q, deadline))
+        {
+            return osErrorTimeout;
+        }
+    }
+
+    (void)memcpy(msg_ptr, q->buf + q->head * q->msg_size, q->msg_size);
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+
+    if (msg_prio)
+    {
+        *msg_prio = 0;
+    }
+
+    os_sim_notify(q);
+    os_sim_preempt();
+
+    return osOK;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id)
+{
+    const os_sim_queue_t* q = mq_id;
+
+    return q ? q->count : 0;
+}
+
+osStatus_t osMessageQueueDelete(osMessageQueueId_t mq_id)
+{
+    os_sim_queue_t* q = mq_id;
+
+    if (!q)
+    {
+        return osErrorParameter;
+    }
+
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    free(q->buf);
+    free(q);
+
+    return osOK;
+}
+
+osMutexId_t osMutexNew(const osMutexAttr_t* attr)
+{
+    os_sim_mutex_t* m;
+
+    if (os_sim_isr)
+    {
+        return NULL;
+    }
+
+    m = calloc(1, sizeof(*m));
+    if (m)
+    {
+        m->recursive = attr && (attr->attr_bits & osMutexRecursive);
+        m->next = os_sim_mutexes;
+        os_sim_mutexes = m;
+    }
+
+    return m;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout)
+{
+    os_sim_mutex_t* m = mutex_id;
+    uint64_t deadline = os_sim_deadline(timeout);
+
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    if (!m)
+    {
+        return osErrorParameter;
+    }
+
+    if (m->count && m->owner == os_sim_current)
+    {
+        if (!m->recursive)
+        {
+            return osErrorResource;
+        }
+
+        m->count++;
+        return osOK;
+    }
+
+    while (m->count)
+    {
+        if (!timeout || !os_sim_can_block())
+        {
+            return osErrorResource;
+        }
+
+        /* Lend the owner our priority until it releases. */
+        if (m->owner && m->owner->priority < os_sim_current->priority)
+        {
+            m->owner->priority = os_sim_current->priority;
+        }
+
+        if (os_sim_block(m, deadline))
+        {
+            /* Take it back, the owner keeps what the others still lend. */
+            if (m->count && m->owner)
+            {
+                m->owner->priority = os_sim_inherited(m->owner);
+            }
+            return osErrorTimeout;
+        }
+    }
+
+    m->owner = os_sim_current;
+    m->count = 1;
+
+    if (os_sim_current)
+    {
+        os_sim_current->held++;
+    }
+
+    return osOK;
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id)
+{
+    os_sim_mutex_t* m = mutex_id;
+
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    if (!m)
+    {
+        return osErrorParameter;
+    }
+
+    if (!m->count || m->owner != os_sim_current)
+    {
+        return osErrorResource;
+    }
+
+    if (--m->count)
+    {
+        return osOK;
+    }
+
+    /* Back to the base priority with the last mutex released. */
+    if (m->owner && !--m->owner->held)
+    {
+        m->owner->priority = m->owner->base;
+    }
+
+    m->owner = NULL;
+
+    os_sim_notify(m);
+    os_sim_preempt();
+
+    return osOK;
+}
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t* attr)
+{
+    os_sim_sem_t* s;
+
+    (void)attr;
+
+    if (!max_count || initial_count > max_count || os_sim_isr)
+    {
+        return NULL;
+    }
+
+    s = calloc(1, sizeof(*s));
+    if (s)
+    {
+        s->count = initial_count;
+        s->max = max_count;
+    }
+
+    return s;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout)
+{
+    os_sim_sem_t* s = semaphore_id;
+    uint64_t deadline = os_sim_deadline(timeout);
+
+    if (!s || (os_sim_isr && timeout))
+    {
+        return osErrorParameter;
+    }
+
+    while (!s->count)
+    {
+        if (!timeout || !os_sim_can_block())
+        {
+            return osErrorResource;
+        }
+
+        if (os_sim_block(s, deadline))
+        {
+            return osErrorTimeout;
+        }
+    }
+
+    s->count--;
+
+    return osOK;
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id)
+{
+    os_sim_sem_t* s = semaphore_id;
+
+    if (!s)
+    {
+        return osErrorParameter;
+    }
+
+    if (s->count >= s->max)
+    {
+        return osErrorResource;
+    }
+
+    s->count++;
+
+    os_sim_notify(s);
+    os_sim_preempt();
+
+    return osOK;
+}
+
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id)
+{
+    const os_sim_sem_t* s = semaphore_id;
+
+    return s ? s->count : 0;
+}
+
+osStatus_t osSemaphoreDelete(osSemaphoreId_t semaphore_id)
+{
+    if (!semaphore_id)
+    {
+        return osErrorParameter;
+    }
+
+    if (os_sim_isr)
+    {
+        return osErrorISR;
+    }
+
+    free(semaphore_id);
+
+    return osOK;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file source/sim/os_sim.h
+ * @brief Definition the discrete-event simulation backend of the RTOS API.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __OS_SIM_H__
+#define __OS_SIM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cmsis_os.h"
+
+/** Virtual kernel ticks per second. */
+#define OS_SIM_TICK_FREQ        1000
+
+/** Virtual system timer cycles per second. */
+#define OS_SIM_SYS_TIMER_FREQ   1000000
+
+/** Host stack of each simulated thread, the configured stack sizes fit a device only. */
+#define OS_SIM_STACK_SIZE       (64 * 1024)
+
+/** Functions whose log lines can be muted. */
+#define OS_SIM_MUTE_MAX         8
+
+/**
+ * @brief   Event callback, run in simulated interrupt context.
+ *
+ * @param   arg Argument given to os_sim_at().
+ */
+typedef void (* os_sim_event_fn)(void* arg);
+
+/**
+ * @brief   Simulation statistics.
+ */
+typedef struct
+{
+    uint64_t    now;            /**< Virtual ticks since the start. */
+    uint64_t    switches;       /**< Context switches to a simulated thread. */
+    uint64_t    jumps;          /**< Virtual clock jumps to the next event. */
+    uint64_t    events;         /**< Event callbacks run. */
+    uint32_t    threads;        /**< Simulated threads alive. */
+    uint32_t    blocked;        /**< Threads blocked without timeout. */
+} os_sim_stats_t;
+
+extern void os_sim_seed(uint32_t seed);
+extern uint64_t os_sim_run(uint64_t ticks);
+extern int32_t os_sim_at(uint32_t delay, os_sim_event_fn fn, void* arg);
+extern void os_sim_busy(uint32_t ticks);
+extern int32_t os_sim_log_mute(const char* function);
+extern void os_sim_get_stats(os_sim_stats_t* stats);
+
+#endif /* __OS_SIM_H__ */
@@ -0,0 +1,14 @@
+SIM_TARGET    := $(BUILD_DIR)/demo_sim
+SIM_FILES     := $(SOURCE_DIR)/source/sim/os_sim.c \
+			     $(SOURCE_DIR)/source/sim/sim_main.c \
+			     $(SIM_SERVICES)
+SIM_OBJS       = $(SIM_FILES:$(SOURCE_DIR)/%.c=$(BUILD_DIR)/%.o)
+SIM_LDFLAGS   := -Wl,-T,$(SOURCE_DIR)/source/sim/os_sim.ld
+
+CFLAGS        += -DCONFIG_OS_SIM=1 \
+			     -I$(SOURCE_DIR)/source/sim
+
+# The section walks step by sizeof, keep x86 from padding the definitions to 32 bytes.
+ifneq ($(filter x86_64 i%86,$(shell uname -m)),)
+CFLAGS        += -malign-data=abi
+endif
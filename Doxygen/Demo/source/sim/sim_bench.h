@@ -0,0 +1,33 @@
+/**
+ * @file source/sim/sim_bench.h
+ * @brief Configuration of the benchmarks of the simulation harness.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SIM_BENCH_H__
+#define __SIM_BENCH_H__
+
+/* Included in every source with make SERVICE_CONF=source/sim/sim_bench.h. */
+#define CONFIG_TRANSPORT_SHM_ENABLE 1
+
+/* Messages per path, each benchmark logs the time per message. */
+#define CONFIG_SIM_BENCH_COUNT 200000
+
+#endif /* __SIM_BENCH_H__ */
@@ -0,0 +1,172 @@
+/**
+ * @file source/sim/sim_bench_dispatch.c
+ * @brief Definition the dispatch benchmark of the simulation harness.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "framework.h"
+#include "os_sim.h"
+
+#ifndef CONFIG_SIM_BENCH_COUNT
+#error "Build with make sim SERVICE_CONF=source/sim/sim_bench.h, see the simulation page."
+#endif
+
+/*
+ * sim_bench_dispatch fills the queue of sim_bench_receiver with a batch
+ * of messages while the receiver waits, then lets it drain the batch.
+ * The receiver times the drain from its first to its last message, so
+ * the time per message is the receive loop and the handler call alone,
+ * no send and no context switch. Build it with DIRECT=y, with and
+ * without LTO=y, to compare the direct loop with the generic one.
+ */
+
+#ifndef DOC_HIDDEN
+#define MSG_ID_SIM_BENCH_DISPATCH   (MSG_ID_MMI_BASE | 0x91)
+#define SIM_BENCH_BATCH             256
+#endif
+
+static const service_config_t sim_bench_dispatch_config =
+{
+    .thread_attr = { .name = "sim_bench_dispatch", .stack_size = 2048, .priority = osPriorityHigh },
+    .queue_attr  = { .name = "sim_bench_dispatch" },
+    .msg_count   = 4,
+};
+
+static const service_config_t sim_bench_receiver_config =
+{
+    .thread_attr = { .name = "sim_bench_receiver", .stack_size = 1024, .priority = osPriorityNormal },
+    .queue_attr  = { .name = "sim_bench_receiver" },
+    .msg_count   = SIM_BENCH_BATCH,
+};
+
+/**
+ * @brief   Messages handled by sim_bench_receiver.
+ */
+static volatile uint32_t sim_bench_received;
+
+/**
+ * @brief   Host time of the drains, first to last message of each batch.
+ */
+static uint64_t sim_bench_drained_ns;
+
+/**
+ * @brief   Host time at the first message of the batch being drained.
+ */
+static uint64_t sim_bench_start;
+
+/**
+ * @brief   Get the host time.
+ *
+ * @retval  Returns the time in nanoseconds.
+ */
+static uint64_t sim_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief   Send the batches and log the time per message once drained.
+ *
+ * @param   obj Pointer to the sim_bench_dispatch object handle.
+ * @param   message Received message.
+ */
+static void sim_bench_dispatch_message_handler(const object* obj, const message_t* const message)
+{
+    const service_t* receiver;
+    message_t msg;
+    uint32_t batches = CONFIG_SIM_BENCH_COUNT / SIM_BENCH_BATCH;
+    uint32_t ns_x100;
+    uint32_t b, i;
+
+    (void)obj;
+
+    if (message->id != MSG_ID_SYS_STARTUP_COMPLETED)
+    {
+        return;
+    }
+
+    /* The trace would be most of the time measured. */
+    (void)os_sim_log_mute("service_unicast_timeout");
+
+    receiver = service_get_svc(object_get_binding("sim_bench_receiver"));
+
+    (void)memset(&msg, 0, sizeof(msg));
+    msg.id = MSG_ID_SIM_BENCH_DISPATCH;
+
+    for (b = 0; b < batches; b++)
+    {
+        /* The receiver has a lower priority, it waits until the batch is queued. */
+        for (i = 0; i < SIM_BENCH_BATCH; i++)
+        {
+            msg.param0 = i;
+            (void)service_unicast_message(receiver, &msg);
+        }
+
+        while (sim_bench_received < (b + 1) * SIM_BENCH_BATCH)
+        {
+            (void)osDelay(1);
+        }
+    }
+
+    /* The first message of a batch starts the clock, it is not counted. */
+    ns_x100 = (uint32_t)(sim_bench_drained_ns * 100 / (batches * (SIM_BENCH_BATCH - 1)));
+
+    pr_info("Bench dispatch %s: %u messages, %u.%02u ns per message.",
+            CONFIG_SERVICE_DIRECT_ENABLE ? "direct" : "generic",
+            batches * (SIM_BENCH_BATCH - 1),
+            ns_x100 / 100,
+            ns_x100 % 100);
+}
+
+/**
+ * @brief   Time the drain of each batch.
+ *
+ * @param   obj Pointer to the sim_bench_receiver object handle.
+ * @param   message Received message.
+ */
+static void sim_bench_receiver_message_handler(const object* obj, const message_t* const message)
+{
+    (void)obj;
+
+    if (message->id != MSG_ID_SIM_BENCH_DISPATCH)
+    {
+        return;
+    }
+
+    if (!message->param0)
+    {
+        sim_bench_start = sim_bench_now();
+    }
+    else if (message->param0 == SIM_BENCH_BATCH - 1)
+    {
+        sim_bench_drained_ns += sim_bench_now() - sim_bench_start;
+    }
+
+    sim_bench_received++;
+}
+
+DECLARE_SERVICE("sim_bench_dispatch", sim_bench_dispatch, NULL, &sim_bench_dispatch_config, NULL, NULL, sim_bench_dispatch_message_handler);
+DECLARE_SERVICE("sim_bench_receiver", sim_bench_receiver, NULL, &sim_bench_receiver_config, NULL, NULL, sim_bench_receiver_message_handler);
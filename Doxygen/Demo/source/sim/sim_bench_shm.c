@@ -0,0 +1,239 @@
+/**
+ * @file source/sim/sim_bench_shm.c
+ * @brief Definition the shared memory transport benchmark of the simulation harness.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "framework.h"
+#include "transport_shm.h"
+#include "os_sim.h"
+
+#ifndef CONFIG_SIM_BENCH_COUNT
+#error "Build with make sim SERVICE_CONF=source/sim/sim_bench.h, see the simulation page."
+#endif
+
+/*
+ * sim_bench sends CONFIG_SIM_BENCH_COUNT messages with
+ * service_unicast_message() on three paths and logs the host time per
+ * message:
+ * - queue, to sim_bench_sink through its RTOS queue, the baseline.
+ * - shm, to the proxy of a ring this process exports, drained by a host
+ *   thread like a service thread of another process would.
+ * - shm fork, the same from a forked process.
+ * The queue path runs on the simulated kernel, its time is the cost of
+ * the framework and the queue on the host processor, context switches
+ * included.
+ */
+
+#ifndef DOC_HIDDEN
+#define MSG_ID_SIM_BENCH        (MSG_ID_MMI_BASE | 0x90)
+#define SIM_BENCH_RING_NAME     "sim_bench_ring"
+#endif
+
+static const service_config_t sim_bench_config =
+{
+    .thread_attr = { .name = "sim_bench", .stack_size = 2048, .priority = osPriorityHigh },
+    .queue_attr  = { .name = "sim_bench" },
+    .msg_count   = 4,
+};
+
+static const service_config_t sim_bench_sink_config =
+{
+    .thread_attr = { .name = "sim_bench_sink", .stack_size = 1024, .priority = osPriorityNormal },
+    .queue_attr  = { .name = "sim_bench_sink" },
+    .msg_count   = 64,
+};
+
+/**
+ * @brief   Ring exported by this process, outside the module_service section.
+ */
+static service_t sim_bench_ring;
+
+static const object sim_bench_ring_obj =
+{
+    .name           = SIM_BENCH_RING_NAME,
+    .object_data    = &sim_bench_ring,
+};
+
+/**
+ * @brief   Messages handled by sim_bench_sink.
+ */
+static volatile uint32_t sim_bench_received;
+
+/**
+ * @brief   Get the host time.
+ *
+ * @retval  Returns the time in nanoseconds.
+ */
+static uint64_t sim_bench_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief   Send the benchmark messages to a service.
+ *
+ * @param   svc Pointer to the service handle.
+ */
+static void sim_bench_send(const service_t* svc)
+{
+    message_t message;
+    uint32_t i;
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = MSG_ID_SIM_BENCH;
+
+    for (i = 0; i < CONFIG_SIM_BENCH_COUNT; i++)
+    {
+        message.param0 = i;
+        (void)service_unicast_message(svc, &message);
+    }
+}
+
+/**
+ * @brief   Drain the exported ring, like the service thread of its process.
+ *
+ * @param   argument Not used.
+ *
+ * @retval  Returns NULL.
+ */
+static void* sim_bench_drain(void* argument)
+{
+    const service_transport_t* transport = sim_bench_ring.transport;
+    message_t* message;
+    uint32_t i;
+
+    (void)argument;
+
+    for (i = 0; i < CONFIG_SIM_BENCH_COUNT; i++)
+    {
+        message = transport->get(&sim_bench_ring, osWaitForever);
+        transport->release(&sim_bench_ring, message);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Log the time per message of one path.
+ *
+ * @param   path Path name.
+ * @param   ns Time of all the messages in nanoseconds.
+ */
+static void sim_bench_report(const char* path, uint64_t ns)
+{
+    pr_info("Bench %s: %u messages, %u ns per message.",
+            path,
+            CONFIG_SIM_BENCH_COUNT,
+            (uint32_t)(ns / CONFIG_SIM_BENCH_COUNT));
+}
+
+/**
+ * @brief   Run the three paths once the system is up.
+ *
+ * @param   obj Pointer to the sim_bench object handle.
+ * @param   message Received message.
+ */
+static void sim_bench_message_handler(const object* obj, const message_t* const message)
+{
+    const object* proxy;
+    pthread_t thread;
+    uint64_t start;
+    pid_t pid;
+
+    (void)obj;
+
+    if (message->id != MSG_ID_SYS_STARTUP_COMPLETED)
+    {
+        return;
+    }
+
+    /* The trace would be most of the time measured. */
+    (void)os_sim_log_mute("service_unicast_timeout");
+
+    start = sim_bench_now();
+    sim_bench_send(service_get_svc(object_get_binding("sim_bench_sink")));
+    while (sim_bench_received < CONFIG_SIM_BENCH_COUNT)
+    {
+        (void)osDelay(1);
+    }
+    sim_bench_report("queue", sim_bench_now() - start);
+
+    if (transport_shm_export(&sim_bench_ring_obj, &sim_bench_sink_config))
+    {
+        pr_error("Bench export failed.");
+        return;
+    }
+
+    proxy = transport_shm_get_binding(SIM_BENCH_RING_NAME);
+    if (!proxy)
+    {
+        pr_error("Bench binding failed.");
+        transport_shm_unexport(&sim_bench_ring_obj);
+        return;
+    }
+
+    start = sim_bench_now();
+    (void)pthread_create(&thread, NULL, sim_bench_drain, NULL);
+    sim_bench_send(service_get_svc(proxy));
+    (void)pthread_join(thread, NULL);
+    sim_bench_report("shm", sim_bench_now() - start);
+
+    start = sim_bench_now();
+    pid = fork();
+    if (!pid)
+    {
+        sim_bench_send(service_get_svc(proxy));
+        _exit(0);
+    }
+    (void)sim_bench_drain(NULL);
+    (void)waitpid(pid, NULL, 0);
+    sim_bench_report("shm fork", sim_bench_now() - start);
+
+    transport_shm_unexport(&sim_bench_ring_obj);
+}
+
+/**
+ * @brief   Count the baseline messages.
+ *
+ * @param   obj Pointer to the sim_bench_sink object handle.
+ * @param   message Received message.
+ */
+static void sim_bench_sink_message_handler(const object* obj, const message_t* const message)
+{
+    (void)obj;
+
+    if (message->id == MSG_ID_SIM_BENCH)
+    {
+        sim_bench_received++;
+    }
+}
+
+DECLARE_SERVICE("sim_bench", sim_bench, NULL, &sim_bench_config, NULL, NULL, sim_bench_message_handler);
+DECLARE_SERVICE("sim_bench_sink", sim_bench_sink, NULL, &sim_bench_sink_config, NULL, NULL, sim_bench_sink_message_handler);
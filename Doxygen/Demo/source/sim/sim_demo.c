@@ -0,0 +1,267 @@
+/**
+ * @file source/sim/sim_demo.c
+ * @brief Definition the demo services of the simulation harness.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "framework.h"
+#include "os_sim.h"
+
+/*
+ * A sensor interrupt every 100 ms posts a sample to sim_filter, which
+ * spends 3 ms on it and sends the average of each minute to sim_report.
+ * sim_report writes it to a slow flash, 20 ms blocked, and logs each hour.
+ */
+
+#ifndef DOC_HIDDEN
+#define MSG_ID_SIM_SAMPLE       (MSG_ID_MMI_BASE | 0x80)
+#define MSG_ID_SIM_REPORT       (MSG_ID_MMI_BASE | 0x81)
+
+#define SIM_SAMPLE_PERIOD_MS    100
+#define SIM_SAMPLE_COST_MS      3
+#define SIM_SAMPLES_PER_REPORT  600
+#define SIM_FLASH_WRITE_MS      20
+#define SIM_REPORTS_PER_LOG     60
+#endif
+
+/**
+ * @brief   Private data of sim_filter.
+ */
+typedef struct
+{
+    uint32_t    value;          /**< Last sensor value. */
+    uint32_t    samples;        /**< Samples handled. */
+    uint32_t    dropped;        /**< Samples the interrupt could not post. */
+    uint64_t    sum;            /**< Sum of the samples of the current minute. */
+    uint32_t    reports;        /**< Reports sent. */
+} sim_filter_priv_t;
+
+/**
+ * @brief   Private data of sim_report.
+ */
+typedef struct
+{
+    uint32_t    reports;        /**< Reports written. */
+    uint32_t    worst;          /**< Longest delivery of a report, in ticks. */
+} sim_report_priv_t;
+
+static sim_filter_priv_t sim_filter_priv;
+static sim_report_priv_t sim_report_priv;
+
+/*
+ * Overridden by service_queue_tune_dump_header() and
+ * service_stack_dump_header() output, make SERVICE_CONF=<header>.
+ */
+#ifndef CONFIG_SIM_FILTER_MSG_COUNT
+#define CONFIG_SIM_FILTER_MSG_COUNT 8
+#endif
+
+#ifndef CONFIG_SIM_REPORT_MSG_COUNT
+#define CONFIG_SIM_REPORT_MSG_COUNT 4
+#endif
+
+#ifndef CONFIG_SIM_FILTER_STACK_SIZE
+#define CONFIG_SIM_FILTER_STACK_SIZE 1024
+#endif
+
+#ifndef CONFIG_SIM_REPORT_STACK_SIZE
+#define CONFIG_SIM_REPORT_STACK_SIZE 1024
+#endif
+
+static const service_config_t sim_filter_config =
+{
+    .thread_attr = { .name = "sim_filter", .stack_size = CONFIG_SIM_FILTER_STACK_SIZE, .priority = osPriorityAboveNormal },
+    .queue_attr  = { .name = "sim_filter" },
+    .msg_count   = CONFIG_SIM_FILTER_MSG_COUNT,
+};
+
+static const service_config_t sim_report_config =
+{
+    .thread_attr = { .name = "sim_report", .stack_size = CONFIG_SIM_REPORT_STACK_SIZE, .priority = osPriorityNormal },
+    .queue_attr  = { .name = "sim_report" },
+    .msg_count   = CONFIG_SIM_REPORT_MSG_COUNT,
+};
+
+/**
+ * @brief   Sensor interrupt, posts a sample and the next interrupt.
+ *
+ * @param   arg Pointer to the sim_filter service handle.
+ */
+static void sim_sensor_isr(void* arg)
+{
+    const service_t* svc = arg;
+    message_t message;
+
+    /* A deterministic random walk. */
+    sim_filter_priv.value = sim_filter_priv.value * 1103515245 + 12345;
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = MSG_ID_SIM_SAMPLE;
+    message.param0 = (sim_filter_priv.value >> 16) & 0x3FF;
+    message.param1 = osKernelGetTickCount();
+
+    if (service_unicast_message(svc, &message))
+    {
+        sim_filter_priv.dropped++;
+    }
+
+    (void)os_sim_at(SIM_SAMPLE_PERIOD_MS * OS_SIM_TICK_FREQ / 1000, sim_sensor_isr, arg);
+}
+
+/**
+ * @brief   Start the sensor interrupts.
+ *
+ * @param   obj Pointer to the sim_filter object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t sim_filter_init(const object* obj)
+{
+    return os_sim_at(SIM_SAMPLE_PERIOD_MS * OS_SIM_TICK_FREQ / 1000,
+                     sim_sensor_isr,
+                     service_get_svc(obj));
+}
+
+/**
+ * @brief   Print the totals of sim_filter.
+ *
+ * @param   obj Pointer to the sim_filter object handle.
+ *
+ * @retval  Returns 0.
+ */
+static int32_t sim_filter_deinit(const object* obj)
+{
+    sim_filter_priv_t* priv = service_get_priv_data(obj);
+
+    pr_info("Service <%s> %u samples, %u dropped, %u reports.",
+            obj->name,
+            priv->samples,
+            priv->dropped,
+            priv->reports);
+
+    return 0;
+}
+
+/**
+ * @brief   Average the samples and send a report each minute.
+ *
+ * @param   obj Pointer to the sim_filter object handle.
+ * @param   message Received message.
+ */
+static void sim_filter_message_handler(const object* obj, const message_t* const message)
+{
+    sim_filter_priv_t* priv = service_get_priv_data(obj);
+    message_t report;
+
+    if (message->id != MSG_ID_SIM_SAMPLE)
+    {
+        return;
+    }
+
+    os_sim_busy(SIM_SAMPLE_COST_MS * OS_SIM_TICK_FREQ / 1000);
+
+    priv->sum += message->param0;
+    if (++priv->samples % SIM_SAMPLES_PER_REPORT)
+    {
+        return;
+    }
+
+    (void)memset(&report, 0, sizeof(report));
+    report.id = MSG_ID_SIM_REPORT;
+    report.param0 = priv->reports;
+    report.param1 = (uint32_t)(priv->sum / SIM_SAMPLES_PER_REPORT);
+    report.param2 = osKernelGetTickCount();
+
+    priv->sum = 0;
+
+    if (!service_unicast_message(service_get_svc(object_get_binding("sim_report")), &report))
+    {
+        priv->reports++;
+    }
+}
+
+/**
+ * @brief   Print the totals of sim_report.
+ *
+ * @param   obj Pointer to the sim_report object handle.
+ *
+ * @retval  Returns 0.
+ */
+static int32_t sim_report_deinit(const object* obj)
+{
+    sim_report_priv_t* priv = service_get_priv_data(obj);
+
+    pr_info("Service <%s> %u reports, worst delivery %u ms.",
+            obj->name,
+            priv->reports,
+            priv->worst * 1000 / OS_SIM_TICK_FREQ);
+
+    return 0;
+}
+
+/**
+ * @brief   Write a report to the flash.
+ *
+ * @param   obj Pointer to the sim_report object handle.
+ * @param   message Received message.
+ */
+static void sim_report_message_handler(const object* obj, const message_t* const message)
+{
+    sim_report_priv_t* priv = service_get_priv_data(obj);
+    uint32_t delivery;
+
+    if (message->id != MSG_ID_SIM_REPORT)
+    {
+        return;
+    }
+
+    delivery = osKernelGetTickCount() - message->param2;
+    if (delivery > priv->worst)
+    {
+        priv->worst = delivery;
+    }
+
+    (void)osDelay(SIM_FLASH_WRITE_MS * OS_SIM_TICK_FREQ / 1000);
+
+    if (!(++priv->reports % SIM_REPORTS_PER_LOG))
+    {
+        pr_info("Service <%s> hour %u, average %u.",
+                obj->name,
+                priv->reports / SIM_REPORTS_PER_LOG,
+                message->param1);
+    }
+}
+
+DECLARE_SERVICE("sim_filter",
+                sim_filter,
+                &sim_filter_priv,
+                &sim_filter_config,
+                sim_filter_init,
+                sim_filter_deinit,
+                sim_filter_message_handler);
+
+DECLARE_SERVICE("sim_report",
+                sim_report,
+                &sim_report_priv,
+                &sim_report_config,
+                NULL,
+                sim_report_deinit,
+                sim_report_message_handler);
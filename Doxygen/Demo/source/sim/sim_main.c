@@ -0,0 +1,87 @@
+/**
+ * @file source/sim/sim_main.c
+ * @brief Definition the harness running the services on the simulation backend.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "framework.h"
+#include "os_sim.h"
+
+/**
+ * @brief   Run the services linked in for a virtual time.
+ *
+ * Usage: demo_sim [seconds [seed [verbose]]], one hour by default. The
+ * services are the normal DECLARE_SERVICE() ones of SIM_SERVICES, probed
+ * by object_init() as on the device. The trace of every send is muted
+ * unless verbose is not 0.
+ *
+ * @param   argc Argument count.
+ * @param   argv Arguments.
+ *
+ * @retval  Returns 0 on success, 1 otherwise.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t seconds = argc > 1 ? strtoull(argv[1], NULL, 0) : 3600;
+    uint32_t seed = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 0;
+    uint32_t verbose = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0;
+    os_sim_stats_t stats;
+    clock_t start;
+    double wall;
+    int32_t ret;
+
+    os_sim_seed(seed);
+
+    if (!verbose)
+    {
+        (void)os_sim_log_mute("service_unicast_timeout");
+        (void)os_sim_log_mute("service_broadcast_message");
+    }
+
+    ret = object_init();
+    if (ret)
+    {
+        pr_error("Object init failed, ret %d.", ret);
+        return 1;
+    }
+
+    (void)msg_sys_startup_completed();
+
+    start = clock();
+    (void)os_sim_run(seconds * OS_SIM_TICK_FREQ);
+    wall = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    os_sim_get_stats(&stats);
+
+    pr_info("Simulated %llu s in %.3f s, %llu switches, %llu clock jumps, %llu events, "
+            "%u threads, %u blocked forever.",
+            (unsigned long long)(stats.now / OS_SIM_TICK_FREQ),
+            wall,
+            (unsigned long long)stats.switches,
+            (unsigned long long)stats.jumps,
+            (unsigned long long)stats.events,
+            stats.threads,
+            stats.blocked);
+
+    return object_deinit() ? 1 : 0;
+}
@@ -0,0 +1,943 @@
+/**
+ * @file source/src/bridge.c
+ * @brief Definition the serial bridge to services on another processor.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framework_conf.h"
+
+#if CONFIG_BRIDGE_ENABLE
+
+#include <string.h>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "cmsis_os.h"
+#include "framework.h"
+#include "msg_ring.h"
+#include "bridge.h"
+
+/**
+ * @defgroup Bridge Bridge
+ *
+ * @brief Carry unicast messages to services on another processor.
+ *
+ * Messages to a proxy are queued in a lock-free ring and packed by the
+ * TX thread into frames, a frame is flushed when it is full or when its
+ * oldest message is CONFIG_BRIDGE_FLUSH_DEADLINE_MS old. The frame body
+ * is:
+ *
+ * @code
+ *  seq(1) count(1) record[count] crc16(2, little endian)
+ *
+ *  record: ctrl(1) [dst hash(4, little endian)] id delta(varint) param(varint)[popcount(ctrl >> 1)]
+ *      ctrl bit 0      A new destination hash follows, otherwise same as the previous record.
+ *      ctrl bit 1..4   param0..param3 are present, absent params are 0.
+ *      id delta        Zigzag encoded difference with the previous id of the frame.
+ * @endcode
+ *
+ * The body is wrapped in 0x7E flags with 0x7D escaping, so the bridge
+ * runs over any byte stream. The RX thread decodes frames and unicasts
+ * the messages to the local service whose name hash matches, without
+ * waiting, a full local queue drops the message rather than stall the
+ * link. The hashes of the local services are computed by bridge_start(),
+ * which fails if two names collide. Only the
+ * id and parameters cross the link, payload handles are not valid on
+ * the other side. A message id with framework flags, a payload, request
+ * or credit, is refused by the proxy like on a full ring, the sender
+ * releases what it holds, and the flag bits of a received id are cleared.
+ *
+ * On Linux, the bridge runs over any pair of file descriptors, e.g. a
+ * serial line:
+ *
+ * @code
+ *  static bridge_fd_t fds;
+ *  bridge_port_t port;
+ *
+ *  fds.rfd = fds.wfd = open("/dev/ttyUSB0", O_RDWR | O_NOCTTY);
+ *  bridge_port_fd_init(&port, &fds);
+ *  bridge_start(&port);
+ * @endcode
+ *
+ * Two processes joined by two pipes, each declaring the services of the
+ * other with DECLARE_BRIDGE_SERVICE(), make a loopback test of the link.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+#define BRIDGE_FLAG             0x7E
+#define BRIDGE_ESC              0x7D
+#define BRIDGE_ESC_XOR          0x20
+#define BRIDGE_HDR_SIZE         2
+#define BRIDGE_CRC_SIZE         2
+#define BRIDGE_RECORD_MAX       (1 + 4 + 5 + 4 * 5)
+#define BRIDGE_THREAD_FLAG_TX   0x00000001
+#define BRIDGE_THREAD_FLAG_FLUSH 0x00000002
+#define BRIDGE_TX_RING_MEM      (sizeof(msg_ring_t) + \
+                                 CONFIG_BRIDGE_TX_RING_SIZE * sizeof(msg_ring_slot_t))
+#endif
+
+/**
+ * @brief   Frame encoder state.
+ */
+typedef struct
+{
+    uint8_t     body[CONFIG_BRIDGE_FRAME_SIZE];     /**< Frame body under construction. */
+    uint32_t    len;                                /**< Body length. */
+    uint32_t    count;                              /**< Records in the body. */
+    uint32_t    dst;                                /**< Destination of the previous record. */
+    uint32_t    id;                                 /**< Id of the previous record. */
+    uint32_t    first_tick;                         /**< Tick of the oldest record. */
+    uint8_t     seq;                                /**< Frame sequence number. */
+} bridge_encoder_t;
+
+/**
+ * @brief   Local service reachable from the other side.
+ */
+typedef struct
+{
+    uint32_t            hash;   /**< Name hash. */
+    const service_t*    svc;    /**< Service handle. */
+} bridge_route_t;
+
+/**
+ * @brief   Bridge runtime structure.
+ */
+typedef struct
+{
+    bridge_port_t       port;       /**< Byte stream port. */
+    osThreadId_t        tx_thread;  /**< TX thread. */
+    osThreadId_t        rx_thread;  /**< RX thread. */
+    bridge_encoder_t    enc;        /**< TX frame encoder. */
+    bridge_route_t      routes[CONFIG_BRIDGE_SERVICE_MAX];  /**< Local services, sorted by hash. */
+    uint32_t            route_count;                        /**< Entries in routes. */
+    bridge_stats_t      stats;      /**< Statistics. */
+} bridge_t;
+
+static bridge_t bridge;
+
+/**
+ * @brief   Messages waiting for the TX thread, tagged with the destination hash.
+ */
+static uint8_t bridge_tx_ring_mem[BRIDGE_TX_RING_MEM] __attribute__((aligned(64)));
+
+#define bridge_tx_ring ((msg_ring_t*)bridge_tx_ring_mem)
+
+/**
+ * @brief   Hash a service name, 32 bits FNV-1a.
+ *
+ * @param   name Service name.
+ *
+ * @retval  Returns the hash.
+ */
+static uint32_t bridge_hash(const char* name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name)
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief   Update a CRC-16/CCITT-FALSE.
+ *
+ * @param   crc Current CRC.
+ * @param   data Pointer to the data.
+ * @param   len Data length.
+ *
+ * @retval  Returns the updated CRC.
+ */
+static uint16_t bridge_crc16(uint16_t crc, const uint8_t* data, uint32_t len)
+{
+    uint32_t i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++ << 8);
+
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) :
+                  (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief   Append a varint.
+ *
+ * @param   buf Output buffer.
+ * @param   value Value to encode.
+ *
+ * @retval  Returns the number of bytes written.
+ */
+static uint32_t bridge_put_varint(uint8_t* buf, uint32_t value)
+{
+    uint32_t len = 0;
+
+    while (value >= 0x80)
+    {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    buf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+/**
+ * @brief   Read a varint.
+ *
+ * @param   buf Input buffer.
+ * @param   end End of the input buffer.
+ * @param   value Output of the value.
+ *
+ * @retval  Returns the number of bytes read, 0 on error.
+ */
+static uint32_t bridge_get_varint(const uint8_t* buf,
+                                  const uint8_t* end,
+                                  uint32_t*      value)
+{
+    uint32_t shift = 0;
+    uint32_t len = 0;
+
+    *value = 0;
+
+    while (buf + len < end && shift < 35)
+    {
+        *value |= (uint32_t)(buf[len] & 0x7F) << shift;
+        if (!(buf[len++] & 0x80))
+        {
+            return len;
+        }
+
+        shift += 7;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Escape and write the current frame, then reset the encoder.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t bridge_tx_flush(void)
+{
+    /* Only the TX thread flushes, the escaped frame stays off its stack. */
+    static uint8_t out[2 * (CONFIG_BRIDGE_FRAME_SIZE + BRIDGE_CRC_SIZE) + 2];
+    bridge_encoder_t* enc = &bridge.enc;
+    uint32_t len = 0;
+    uint16_t crc;
+    uint32_t i;
+    int32_t ret;
+
+    if (!enc->count)
+    {
+        return 0;
+    }
+
+    enc->body[0] = enc->seq++;
+    enc->body[1] = (uint8_t)enc->count;
+
+    crc = bridge_crc16(0xFFFF, enc->body, enc->len);
+    enc->body[enc->len++] = (uint8_t)crc;
+    enc->body[enc->len++] = (uint8_t)(crc >> 8);
+
+    out[len++] = BRIDGE_FLAG;
+
+    for (i = 0; i < enc->len; i++)
+    {
+        if (enc->body[i] == BRIDGE_FLAG || enc->body[i] == BRIDGE_ESC)
+        {
+            out[len++] = BRIDGE_ESC;
+            out[len++] = enc->body[i] ^ BRIDGE_ESC_XOR;
+        }
+        else
+        {
+            out[len++] = enc->body[i];
+        }
+    }
+
+    out[len++] = BRIDGE_FLAG;
+
+    ret = bridge.port.write(bridge.port.ctx, out, len);
+    if (!ret)
+    {
+        bridge.stats.tx_frames++;
+        bridge.stats.tx_messages += enc->count;
+        bridge.stats.tx_bytes += len;
+    }
+    else
+    {
+        pr_error("Bridge write %d bytes failed, ret %d.", len, ret);
+    }
+
+    enc->len = BRIDGE_HDR_SIZE;
+    enc->count = 0;
+    enc->dst = 0;
+    enc->id = 0;
+
+    return ret;
+}
+
+/**
+ * @brief   Append one message to the current frame, flushing first if it is full.
+ *
+ * @param   dst Destination hash.
+ * @param   message Message to encode.
+ */
+static void bridge_tx_encode(uint32_t dst, const message_t* message)
+{
+    bridge_encoder_t* enc = &bridge.enc;
+    const uint32_t params[4] =
+    {
+        message->param0, message->param1, message->param2, message->param3
+    };
+    uint8_t* ctrl;
+    int32_t delta;
+    uint32_t i;
+
+    if (enc->len + BRIDGE_RECORD_MAX + BRIDGE_CRC_SIZE > CONFIG_BRIDGE_FRAME_SIZE ||
+        enc->count == 0xFF)
+    {
+        (void)bridge_tx_flush();
+    }
+
+    if (!enc->count)
+    {
+        enc->first_tick = osKernelGetTickCount();
+    }
+
+    ctrl = &enc->body[enc->len++];
+    *ctrl = 0;
+
+    if (!enc->count || dst != enc->dst)
+    {
+        *ctrl |= 0x01;
+        enc->body[enc->len++] = (uint8_t)dst;
+        enc->body[enc->len++] = (uint8_t)(dst >> 8);
+        enc->body[enc->len++] = (uint8_t)(dst >> 16);
+        enc->body[enc->len++] = (uint8_t)(dst >> 24);
+        enc->dst = dst;
+    }
+
+    delta = (int32_t)(message->id - enc->id);
+    enc->len += bridge_put_varint(&enc->body[enc->len],
+                                  ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    enc->id = message->id;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (params[i])
+        {
+            *ctrl |= (uint8_t)(0x02 << i);
+            enc->len += bridge_put_varint(&enc->body[enc->len], params[i]);
+        }
+    }
+
+    enc->count++;
+}
+
+/**
+ * @brief   Bridge TX thread, batching queued messages into frames.
+ *
+ * @param   argument Not used.
+ */
+static void bridge_tx_thread(void* argument)
+{
+    uint32_t deadline = CONFIG_BRIDGE_FLUSH_DEADLINE_MS * osKernelGetTickFreq() /
+                        1000;
+    msg_ring_slot_t* slot;
+    uint32_t elapsed;
+    uint32_t timeout;
+    uint32_t flags = 0;
+
+    (void)argument;
+
+    if (!deadline)
+    {
+        deadline = 1;
+    }
+
+    while (1)
+    {
+        timeout = osWaitForever;
+        if (bridge.enc.count)
+        {
+            elapsed = osKernelGetTickCount() - bridge.enc.first_tick;
+            timeout = (elapsed < deadline) ? deadline - elapsed : 0;
+        }
+
+        if (timeout)
+        {
+            flags = osThreadFlagsWait(BRIDGE_THREAD_FLAG_TX | BRIDGE_THREAD_FLAG_FLUSH,
+                                      osFlagsWaitAny,
+                                      timeout);
+        }
+
+        while ((slot = msg_ring_peek(bridge_tx_ring)))
+        {
+            bridge_tx_encode(slot->tag, &slot->message);
+            msg_ring_consume(bridge_tx_ring, slot);
+        }
+
+        if (bridge.enc.count &&
+            ((!(flags & osFlagsError) && (flags & BRIDGE_THREAD_FLAG_FLUSH)) ||
+             osKernelGetTickCount() - bridge.enc.first_tick >= deadline))
+        {
+            (void)bridge_tx_flush();
+        }
+
+        flags = 0;
+    }
+}
+
+/**
+ * @brief   Hash the names of the local services, sorted for the RX lookup.
+ *
+ * Proxies and the other replicas of a replicated service are left out,
+ * a message reaches a replica through the first one.
+ *
+ * @retval  Returns 0 on success, -ENOSPC if there are more than
+ *          CONFIG_BRIDGE_SERVICE_MAX services, -EEXIST if two names
+ *          have the same hash.
+ */
+static int32_t bridge_route_init(void)
+{
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+
+    const service_t* svc;
+    bridge_route_t route;
+    uint32_t i;
+
+    bridge.route_count = 0;
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        if (!svc->owner || SERVICE_TRANSPORT(svc) || SERVICE_REPLICA_INDEX(svc))
+        {
+            continue;
+        }
+
+        if (bridge.route_count >= CONFIG_BRIDGE_SERVICE_MAX)
+        {
+            pr_error("Bridge has more than %u services.", CONFIG_BRIDGE_SERVICE_MAX);
+            return -ENOSPC;
+        }
+
+        route.hash = bridge_hash(svc->owner->name);
+        route.svc = svc;
+
+        /* Insertion sort, once at start. */
+        for (i = bridge.route_count; i && bridge.routes[i - 1].hash > route.hash; i--)
+        {
+            bridge.routes[i] = bridge.routes[i - 1];
+        }
+
+        if (i && bridge.routes[i - 1].hash == route.hash)
+        {
+            pr_error("Bridge services <%s> and <%s> have the same hash 0x%x.",
+                     bridge.routes[i - 1].svc->owner->name,
+                     svc->owner->name,
+                     route.hash);
+            return -EEXIST;
+        }
+
+        bridge.routes[i] = route;
+        bridge.route_count++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Find the local service with a name hash.
+ *
+ * @param   hash Name hash.
+ *
+ * @retval  Returns the service handle, or NULL if there is none.
+ */
+static const service_t* bridge_find_service(uint32_t hash)
+{
+    uint32_t lo = 0;
+    uint32_t hi = bridge.route_count;
+    uint32_t mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+
+        if (bridge.routes[mid].hash == hash)
+        {
+            return bridge.routes[mid].svc;
+        }
+
+        if (bridge.routes[mid].hash < hash)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Decode a received frame body and deliver its messages.
+ *
+ * @param   body Pointer to the unescaped body.
+ * @param   len Body length, CRC included.
+ */
+static void bridge_rx_frame(const uint8_t* body, uint32_t len)
+{
+    const uint8_t* end = body + len - BRIDGE_CRC_SIZE;
+    const uint8_t* p = body + BRIDGE_HDR_SIZE;
+    const service_t* svc = NULL;
+    message_t message;
+    uint32_t params[4];
+    uint32_t count;
+    uint32_t dst = 0;
+    uint32_t id = 0;
+    uint32_t value;
+    uint32_t n;
+    uint32_t i;
+    uint8_t ctrl;
+
+    if (len < BRIDGE_HDR_SIZE + BRIDGE_CRC_SIZE ||
+        bridge_crc16(0xFFFF, body, len - BRIDGE_CRC_SIZE) !=
+        (uint16_t)(end[0] | (end[1] << 8)))
+    {
+        bridge.stats.rx_errors++;
+        return;
+    }
+
+    bridge.stats.rx_frames++;
+
+    for (count = body[1]; count; count--)
+    {
+        if (p >= end)
+        {
+            bridge.stats.rx_errors++;
+            return;
+        }
+
+        ctrl = *p++;
+
+        if (ctrl & 0x01)
+        {
+            if (end - p < 4)
+            {
+                bridge.stats.rx_errors++;
+                return;
+            }
+
+            dst = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                  ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+            p += 4;
+            svc = bridge_find_service(dst);
+        }
+
+        n = bridge_get_varint(p, end, &value);
+        if (!n)
+        {
+            bridge.stats.rx_errors++;
+            return;
+        }
+
+        p += n;
+        id += (value >> 1) ^ (0u - (value & 1));
+
+        for (i = 0; i < 4; i++)
+        {
+            params[i] = 0;
+
+            if (ctrl & (0x02 << i))
+            {
+                n = bridge_get_varint(p, end, &params[i]);
+                if (!n)
+                {
+                    bridge.stats.rx_errors++;
+                    return;
+                }
+
+                p += n;
+            }
+        }
+
+        if (!svc)
+        {
+            bridge.stats.rx_unknown++;
+            continue;
+        }
+
+        (void)memset(&message, 0, sizeof(message));
+        /* Never act on references of the other side. */
+        message.id = id & ~MSG_ID_FLAGS_MASK;
+        message.param0 = params[0];
+        message.param1 = params[1];
+        message.param2 = params[2];
+        message.param3 = params[3];
+
+        /* One full queue must not stall the link, the message is dropped. */
+        if (service_post_message(svc, &message))
+        {
+            bridge.stats.rx_dropped++;
+            continue;
+        }
+
+        bridge.stats.rx_messages++;
+    }
+}
+
+/**
+ * @brief   Bridge RX thread, unframing the byte stream.
+ *
+ * @param   argument Not used.
+ */
+static void bridge_rx_thread(void* argument)
+{
+    uint8_t body[CONFIG_BRIDGE_FRAME_SIZE];
+    uint8_t buf[64];
+    uint32_t len = 0;
+    uint8_t esc = 0;
+    uint8_t overflow = 0;
+    int32_t n;
+    int32_t i;
+
+    (void)argument;
+
+    while (1)
+    {
+        n = bridge.port.read(bridge.port.ctx, buf, sizeof(buf), osWaitForever);
+        if (n <= 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (buf[i] == BRIDGE_FLAG)
+            {
+                if (len && !overflow)
+                {
+                    bridge_rx_frame(body, len);
+                }
+                else if (overflow)
+                {
+                    bridge.stats.rx_errors++;
+                }
+
+                len = 0;
+                esc = 0;
+                overflow = 0;
+            }
+            else if (buf[i] == BRIDGE_ESC)
+            {
+                esc = 1;
+            }
+            else if (len < sizeof(body))
+            {
+                body[len++] = esc ? buf[i] ^ BRIDGE_ESC_XOR : buf[i];
+                esc = 0;
+            }
+            else
+            {
+                overflow = 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Queue a message for a proxy service.
+ *
+ * @param   svc Pointer to the proxy service handle.
+ * @param   message Message structure to send.
+ * @param   timeout Timeout in ticks to wait for room in the TX ring.
+ *
+ * @retval  Returns the RTOS status.
+ */
+static osStatus_t bridge_put(const service_t*   svc,
+                             const message_t*   message,
+                             uint32_t           timeout)
+{
+    const bridge_proxy_t* proxy = (const bridge_proxy_t*)svc->transport_ctx;
+
+    if (!bridge.tx_thread)
+    {
+        return osErrorResource;
+    }
+
+    /* The references behind the flags stay on this side. */
+    if (message->id & MSG_ID_FLAGS_MASK)
+    {
+        return osErrorParameter;
+    }
+
+    while (msg_ring_push(bridge_tx_ring, message, proxy->hash))
+    {
+        if (!timeout)
+        {
+            return osErrorResource;
+        }
+
+        (void)osDelay(1);
+
+        if (timeout != osWaitForever)
+        {
+            timeout--;
+        }
+    }
+
+    (void)osThreadFlagsSet(bridge.tx_thread, BRIDGE_THREAD_FLAG_TX);
+
+    return osOK;
+}
+
+/**
+ * @brief   Bridge transport operations, used by the proxy services.
+ */
+const service_transport_t bridge_transport =
+{
+    .put        = bridge_put,
+    .get        = NULL,
+    .release    = NULL,
+};
+
+/**
+ * @brief   Probe a proxy service.
+ *
+ * @param   obj Pointer to the proxy object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Bridge
+ */
+int32_t bridge_proxy_probe(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+    bridge_proxy_t* proxy = (bridge_proxy_t*)svc->transport_ctx;
+
+    svc->owner = obj;
+    proxy->hash = bridge_hash(obj->name);
+
+    pr_info("Object <%s> probe succeed, bridge proxy 0x%x.",
+            obj->name,
+            proxy->hash);
+
+    return 0;
+}
+
+/**
+ * @brief   Start the bridge on a byte stream port.
+ *
+ * Call it once the services are probed, the services probed later are
+ * not reachable from the other side.
+ *
+ * @param   port Pointer to the port, copied.
+ *
+ * @retval  Returns 0 on success, -EEXIST if two local service names
+ *          have the same hash, negative error code otherwise.
+ *
+ * @ingroup Bridge
+ */
+int32_t bridge_start(const bridge_port_t* port)
+{
+    const osThreadAttr_t tx_attr =
+    {
+        .name       = "bridge_tx",
+        .stack_size = CONFIG_BRIDGE_STACK_SIZE,
+        .priority   = osPriorityAboveNormal,
+    };
+    const osThreadAttr_t rx_attr =
+    {
+        .name       = "bridge_rx",
+        .stack_size = CONFIG_BRIDGE_STACK_SIZE,
+        .priority   = osPriorityAboveNormal,
+    };
+    int32_t ret;
+
+    if (!port || !port->write || !port->read)
+    {
+        return -EINVAL;
+    }
+
+    if (bridge.tx_thread || bridge.rx_thread)
+    {
+        return -EBUSY;
+    }
+
+    ret = bridge_route_init();
+    if (ret)
+    {
+        return ret;
+    }
+
+    bridge.port = *port;
+    bridge.enc.len = BRIDGE_HDR_SIZE;
+    (void)msg_ring_init(bridge_tx_ring, CONFIG_BRIDGE_TX_RING_SIZE);
+
+    bridge.rx_thread = osThreadNew(bridge_rx_thread, NULL, &rx_attr);
+    if (!bridge.rx_thread)
+    {
+        pr_error("Bridge create thread <%s> failed.", rx_attr.name);
+        return -EINVAL;
+    }
+
+    bridge.tx_thread = osThreadNew(bridge_tx_thread, NULL, &tx_attr);
+    if (!bridge.tx_thread)
+    {
+        pr_error("Bridge create thread <%s> failed.", tx_attr.name);
+
+        /* Back to the stopped state, a retry must not start a second reader on the port. */
+        (void)osThreadTerminate(bridge.rx_thread);
+        bridge.rx_thread = NULL;
+        (void)memset(&bridge.port, 0, sizeof(bridge.port));
+        return -EINVAL;
+    }
+
+    pr_info("Bridge started.");
+
+    return 0;
+}
+
+/**
+ * @brief   Ask the TX thread to send the pending messages now.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Bridge
+ */
+int32_t bridge_flush(void)
+{
+    if (!bridge.tx_thread)
+    {
+        return -ENODEV;
+    }
+
+    (void)osThreadFlagsSet(bridge.tx_thread, BRIDGE_THREAD_FLAG_FLUSH);
+
+    return 0;
+}
+
+/**
+ * @brief   Get the bridge statistics.
+ *
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Bridge
+ */
+int32_t bridge_get_stats(bridge_stats_t* stats)
+{
+    if (!stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = bridge.stats;
+
+    return 0;
+}
+
+#ifdef __linux__
+/**
+ * @brief   Write all bytes to a file descriptor.
+ */
+static int32_t bridge_fd_write(void* ctx, const uint8_t* data, uint32_t len)
+{
+    const bridge_fd_t* fds = (const bridge_fd_t*)ctx;
+    ssize_t n;
+
+    while (len)
+    {
+        n = write(fds->wfd, data, len);
+        if (n <= 0)
+        {
+            return -EIO;
+        }
+
+        data += n;
+        len -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Read from a file descriptor with a timeout in ticks.
+ */
+static int32_t bridge_fd_read(void* ctx, uint8_t* data, uint32_t len,
+                              uint32_t timeout)
+{
+    const bridge_fd_t* fds = (const bridge_fd_t*)ctx;
+    struct pollfd pfd = { .fd = fds->rfd, .events = POLLIN };
+    uint32_t freq = osKernelGetTickFreq();
+    int ms = -1;
+    ssize_t n;
+
+    if (timeout != osWaitForever)
+    {
+        ms = (int)((uint64_t)timeout * 1000 / (freq ? freq : 1000));
+    }
+
+    if (poll(&pfd, 1, ms) <= 0)
+    {
+        return 0;
+    }
+
+    n = read(fds->rfd, data, len);
+
+    return (n < 0) ? -EIO : (int32_t)n;
+}
+
+/**
+ * @brief   Build a port on a pair of file descriptors.
+ *
+ * @param   port Output of the port.
+ * @param   fds Pointer to the descriptors, must stay valid while the bridge runs.
+ *
+ * @ingroup Bridge
+ */
+void bridge_port_fd_init(bridge_port_t* port, bridge_fd_t* fds)
+{
+    port->write = bridge_fd_write;
+    port->read = bridge_fd_read;
+    port->ctx = fds;
+}
+#endif
+
+#endif /* CONFIG_BRIDGE_ENABLE */
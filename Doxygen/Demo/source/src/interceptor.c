@@ -0,0 +1,143 @@
+/**
+ * @file source/src/interceptor.c
+ * @brief Definition the message interceptor chain.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "framework.h"
+#include "interceptor.h"
+
+#if CONFIG_INTERCEPTOR_ENABLE
+
+/**
+ * @defgroup Interceptor Interceptor
+ *
+ * @brief Hooks on the message send and receive paths.
+ *
+ * Interceptors are collected from the module_interceptor section and
+ * sorted by priority into a flat table when the core objects are probed,
+ * so running the chain is a plain array walk.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Interceptors sorted by priority.
+ */
+static const interceptor_t* interceptor_table[CONFIG_INTERCEPTOR_MAX];
+
+/**
+ * @brief   Number of valid entries in the interceptor table.
+ */
+static uint32_t interceptor_num;
+
+/**
+ * @brief   Build the sorted interceptor table.
+ *
+ * @param   obj Pointer to the interceptor object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t interceptor_probe(const object* obj)
+{
+    extern interceptor_t module_interceptor$$Base[];
+    extern interceptor_t module_interceptor$$Limit[];
+
+    const interceptor_t* entry;
+    uint32_t num = 0;
+    uint32_t i;
+
+    for (entry = module_interceptor$$Base;
+         entry < module_interceptor$$Limit;
+         entry++)
+    {
+        if (!entry->hook)
+        {
+            continue;
+        }
+
+        if (num >= CONFIG_INTERCEPTOR_MAX)
+        {
+            pr_error("Interceptor <%s> exceeds the limit %d.",
+                     entry->name,
+                     CONFIG_INTERCEPTOR_MAX);
+            return -ENOMEM;
+        }
+
+        /* Insertion sort, equal priorities keep the link order. */
+        for (i = num; i > 0 && interceptor_table[i - 1]->priority >
+             entry->priority; i--)
+        {
+            interceptor_table[i] = interceptor_table[i - 1];
+        }
+
+        interceptor_table[i] = entry;
+        num++;
+    }
+
+    interceptor_num = num;
+
+    pr_info("Object <%s> probe succeed, %d interceptors.", obj->name, num);
+
+    return 0;
+}
+
+/**
+ * @brief   Run the interceptor chain on a message.
+ *
+ * The chain stops at the first interceptor that does not pass.
+ *
+ * @param   point Where on the message path the chain is run.
+ * @param   svc Pointer to the destination service, updated on redirect.
+ * @param   message Pointer to a writable copy of the message.
+ *
+ * @retval  Returns the verdict for this message.
+ *
+ * @ingroup Interceptor
+ */
+intercept_action_e interceptor_run(intercept_point_e    point,
+                                   const service_t**    svc,
+                                   message_t*           message)
+{
+    intercept_action_e action;
+    uint32_t i;
+
+    for (i = 0; i < interceptor_num; i++)
+    {
+        action = interceptor_table[i]->hook(point, svc, message);
+        if (action != INTERCEPT_PASS)
+        {
+            return action;
+        }
+    }
+
+    return INTERCEPT_PASS;
+}
+
+module_core("interceptor",
+            interceptor,
+            interceptor_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_INTERCEPTOR_ENABLE */
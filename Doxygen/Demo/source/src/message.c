@@ -24,6 +24,7 @@
 #include <string.h>
 #include "cmsis_os.h"
 #include "framework.h"
+#include "service_state.h"
 
 /**
  * @brief   The map table definition.
@@ -41,6 +42,9 @@ static const msg_id_str_mapping_t msg_id_str_mapping[] =
 {
     { MSG_ID_SYS_STARTUP_COMPLETED,   "SYS_STARTUP_COMPLETED"   },
     { MSG_ID_SYS_RUN_AUTOMATIC_TEST,  "SYS_RUN_AUTOMATIC_TEST"  },
+    { MSG_ID_SYS_HANDLER_OVERRUN,     "SYS_HANDLER_OVERRUN"     },
+    { MSG_ID_SYS_STATE_CHANGED,       "SYS_STATE_CHANGED"       },
+    { MSG_ID_SYS_CO_TIMEOUT,          "SYS_CO_TIMEOUT"          },
     { MSG_ID_LED_SETUP,               "LED_SETUP"               },
     { MSG_ID_BTN_STATE_NOTIFY,        "BTN_STATE_NOTIFY"        },
     { MSG_ID_BLE_SHCI_READY,          "BLE_SHCI_READY"          },
@@ -50,6 +54,52 @@ static const msg_id_str_mapping_t msg_id_str_mapping[] =
     { MSG_ID_MMI_CLIENT_INPUT_NOTIFY, "MMI_CLIENT_INPUT_NOTIFY" },
 };
 
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+/**
+ * @brief   The signal table, parameterless messages delivered by thread flags.
+ *
+ * The index in the table is the signal bit, at most 29 entries, the
+ * bits of SERVICE_THREAD_FLAGS_SIGNAL. A pending signal raised again is
+ * delivered once, the pending ones in table order and before the queue,
+ * not in the order they were raised. Only list events whose handling does
+ * not depend on that order, never a state pair such as connected and
+ * disconnected, these stay on the message queue.
+ */
+static const uint32_t msg_signal_mapping[] =
+{
+    MSG_ID_SYS_STARTUP_COMPLETED,
+    MSG_ID_BLE_SHCI_READY,
+    MSG_ID_BLE_ADV_TIMEOUT,
+};
+
+_Static_assert(sizeof(msg_signal_mapping) / sizeof(msg_signal_mapping[0]) <=
+               __builtin_popcount(SERVICE_THREAD_FLAGS_SIGNAL),
+               "too many signals for the thread flags");
+#endif
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+/**
+ * @brief   The map table of the message id and its default time to live.
+ */
+typedef struct
+{
+    uint32_t    id;         /**< Message identifier. */
+    uint32_t    ttl_ms;     /**< Time to live in ms. */
+} msg_id_ttl_mapping_t;
+
+/**
+ * @brief   The default time to live of the messages that go stale.
+ *
+ * Messages not in the table never expire unless the sender sets a
+ * deadline with msg_set_deadline().
+ */
+static const msg_id_ttl_mapping_t msg_id_ttl_mapping[] =
+{
+    { MSG_ID_BTN_STATE_NOTIFY,        500 },
+    { MSG_ID_MMI_CLIENT_INPUT_NOTIFY, 500 },
+};
+#endif
+
 /**
  * @brief   Convert the message id to string.
  *
@@ -65,7 +115,7 @@ const char* msg_id_to_str(uint32_t id)
          i < sizeof(msg_id_str_mapping) / sizeof(msg_id_str_mapping[0]);
          i++)
     {
-        if (msg_id_str_mapping[i].id == id)
+        if (msg_id_str_mapping[i].id == (id & ~MSG_ID_FLAGS_MASK))
         {
             return msg_id_str_mapping[i].name;
         }
@@ -82,10 +132,155 @@ const char* msg_id_to_str(uint32_t id)
 int32_t msg_sys_startup_completed(void)
 {
     message_t message;
+#if CONFIG_SERVICE_STATE_ENABLE
+    uint32_t completed = 1;
+
+    /* Services started later read it from the board. */
+    (void)SERVICE_STATE_WRITE(SERVICE_STATE_SYS_STARTUP, completed);
+#endif
 
     (void)memset(&message, 0, sizeof(message));
 
     message.id = MSG_ID_SYS_STARTUP_COMPLETED;
 
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+    return service_broadcast_signal(message.id);
+#else
     return service_broadcast_message(&message);
+#endif
+}
+
+/**
+ * @brief   Get the payload attached to a message.
+ *
+ * The payload is only valid until the message handler returns,
+ * take a reference with payload_ref() to keep it longer. Only the
+ * message the calling service is handling can carry a payload, the
+ * param3 of any other message is not taken for a handle.
+ *
+ * @param   message Pointer to the message structure.
+ *
+ * @retval  Returns the payload data, or NULL if there is none.
+ */
+void* msg_get_payload(const message_t* message)
+{
+#if CONFIG_PAYLOAD_POOL_ENABLE
+    const service_t* svc;
+
+    if (!message)
+    {
+        return NULL;
+    }
+
+    /* The dispatch strips MSG_ID_FLAG_PAYLOAD, it records the handle instead. */
+    svc = service_get_current();
+    if (!svc || !svc->payload || svc->payload != message->param3)
+    {
+        return NULL;
+    }
+
+    return payload_from_handle(message->param3);
+#else
+    (void)message;
+
+    return NULL;
+#endif
+}
+
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+/**
+ * @brief   Convert the message id to signal bit.
+ *
+ * @param   id Message id.
+ *
+ * @retval  Returns the signal bit, or -1 if the message is not a signal.
+ */
+int32_t msg_id_to_signal(uint32_t id)
+{
+    uint32_t i;
+
+    for (i = 0;
+         i < sizeof(msg_signal_mapping) / sizeof(msg_signal_mapping[0]);
+         i++)
+    {
+        if (msg_signal_mapping[i] == id)
+        {
+            return (int32_t)i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief   Convert the signal bit to message id.
+ *
+ * @param   bit Signal bit.
+ *
+ * @retval  Returns the message id, 0 if the bit is not a signal.
+ */
+uint32_t msg_signal_to_id(uint32_t bit)
+{
+    if (bit >= sizeof(msg_signal_mapping) / sizeof(msg_signal_mapping[0]))
+    {
+        return 0;
+    }
+
+    return msg_signal_mapping[bit];
+}
+#endif
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+/**
+ * @brief   Get the default time to live of a message id.
+ *
+ * @param   id Message id.
+ *
+ * @retval  Returns the time to live in ms, 0 if the message never expires.
+ */
+uint32_t msg_id_to_ttl(uint32_t id)
+{
+    uint32_t i;
+
+    id &= ~MSG_ID_FLAGS_MASK;
+
+    for (i = 0;
+         i < sizeof(msg_id_ttl_mapping) / sizeof(msg_id_ttl_mapping[0]);
+         i++)
+    {
+        if (msg_id_ttl_mapping[i].id == id)
+        {
+            return msg_id_ttl_mapping[i].ttl_ms;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Set the deadline of a message before sending it.
+ *
+ * The receiving service drops the message instead of handling it once
+ * the deadline has passed. Without a deadline, the send path applies
+ * the default time to live of the message id.
+ *
+ * @param   message Pointer to the message structure.
+ * @param   ttl_ms Time to live from now in ms, 0 for the default of the message id.
+ */
+void msg_set_deadline(message_t* message, uint32_t ttl_ms)
+{
+    if (!message)
+    {
+        return;
+    }
+
+    if (!ttl_ms)
+    {
+        message->deadline = 0;
+        return;
+    }
+
+    message->deadline = osKernelGetTickCount() + (uint32_t)((uint64_t)ttl_ms * osKernelGetTickFreq() / 1000);
+    message->deadline += !message->deadline;
 }
+#endif
@@ -0,0 +1,221 @@
+/**
+ * @file source/src/msg_ring.c
+ * @brief Definition the lock-free message ring.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "framework.h"
+#include "msg_ring.h"
+
+/**
+ * @brief   Round the slot count up to a power of two.
+ *
+ * @param   count Requested slot count.
+ *
+ * @retval  Returns the slot count used by the ring.
+ */
+static uint32_t msg_ring_round_count(uint32_t count)
+{
+    uint32_t n = 2;
+
+    while (n < count)
+    {
+        n <<= 1;
+    }
+
+    return n;
+}
+
+/**
+ * @brief   Get the memory needed by a ring.
+ *
+ * @param   count Requested slot count, rounded up to a power of two.
+ *
+ * @retval  Returns the size in bytes.
+ */
+uint32_t msg_ring_mem_size(uint32_t count)
+{
+    return sizeof(msg_ring_t) +
+           msg_ring_round_count(count) * sizeof(msg_ring_slot_t);
+}
+
+/**
+ * @brief   Initialize a ring in memory of msg_ring_mem_size() bytes.
+ *
+ * @param   ring Pointer to the ring memory.
+ * @param   count Requested slot count, rounded up to a power of two.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+int32_t msg_ring_init(msg_ring_t* ring, uint32_t count)
+{
+    uint32_t i;
+
+    if (!ring || !count)
+    {
+        return -EINVAL;
+    }
+
+    count = msg_ring_round_count(count);
+
+    ring->mask = count - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        ring->slots[i].seq = i;
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief   Claim a free slot for writing.
+ *
+ * The caller fills the slot in place and publishes it with
+ * msg_ring_commit(). Safe for concurrent producers.
+ *
+ * @param   ring Pointer to the ring.
+ *
+ * @retval  Returns the slot, or NULL if the ring is full.
+ */
+msg_ring_slot_t* msg_ring_reserve(msg_ring_t* ring)
+{
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    msg_ring_slot_t* slot;
+    int32_t diff;
+
+    while (1)
+    {
+        slot = &ring->slots[pos & ring->mask];
+        diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (!diff)
+        {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                return slot;
+            }
+        }
+        else if (diff < 0)
+        {
+            return NULL;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief   Publish a slot claimed by msg_ring_reserve().
+ *
+ * @param   ring Pointer to the ring.
+ * @param   slot Pointer to the slot.
+ */
+void msg_ring_commit(msg_ring_t* ring, msg_ring_slot_t* slot)
+{
+    (void)ring;
+
+    /* Nobody else writes the sequence of a claimed slot. */
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Get the oldest published slot without removing it.
+ *
+ * Only the single consumer may call this.
+ *
+ * @param   ring Pointer to the ring.
+ *
+ * @retval  Returns the slot, or NULL if the ring is empty.
+ */
+msg_ring_slot_t* msg_ring_peek(msg_ring_t* ring)
+{
+    uint32_t pos = ring->tail;
+    msg_ring_slot_t* slot = &ring->slots[pos & ring->mask];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+    {
+        return NULL;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief   Give the slot returned by msg_ring_peek() back to the producers.
+ *
+ * @param   ring Pointer to the ring.
+ * @param   slot Pointer to the slot.
+ */
+void msg_ring_consume(msg_ring_t* ring, msg_ring_slot_t* slot)
+{
+    uint32_t pos = ring->tail;
+
+    __atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Copy a message into the ring.
+ *
+ * @param   ring Pointer to the ring.
+ * @param   message Message structure to push.
+ * @param   tag User tag stored with the message.
+ *
+ * @retval  Returns 0 on success, -EFULL if the ring is full.
+ */
+int32_t msg_ring_push(msg_ring_t* ring, const message_t* message, uint32_t tag)
+{
+    msg_ring_slot_t* slot = msg_ring_reserve(ring);
+
+    if (!slot)
+    {
+        return -EFULL;
+    }
+
+    slot->tag = tag;
+    slot->message = *message;
+
+    msg_ring_commit(ring, slot);
+
+    return 0;
+}
+
+/**
+ * @brief   Get the number of messages claimed in the ring.
+ *
+ * @param   ring Pointer to the ring.
+ *
+ * @retval  Returns the approximate message count.
+ */
+uint32_t msg_ring_count(const msg_ring_t* ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_RELAXED) -
+           __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
@@ -24,8 +24,10 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "framework_conf.h"
 #include "object.h"
 #include "err.h"
+#include "transport_shm.h"
 
 #ifndef DOC_HIDDEN
 extern object module_object_0$$Base[];
@@ -146,9 +148,9 @@ int32_t object_deinit(void)
     uint32_t level;
     int32_t ret;
 
-    for (level = OBJECT_LEVELS_NUM - 2; level == 0; level -= 2)
+    for (level = OBJECT_LEVELS_NUM; level >= 2; level -= 2)
     {
-        ret = object_do_one_deinitcall(level);
+        ret = object_do_one_deinitcall(level - 2);
         if (ret)
         {
             return ret;
@@ -199,9 +201,9 @@ int32_t object_suspend(int32_t suspend_level)
     uint32_t level;
     int32_t ret;
 
-    for (level = OBJECT_LEVELS_NUM - 2; level == 0; level -= 2)
+    for (level = OBJECT_LEVELS_NUM; level >= 2; level -= 2)
     {
-        ret = object_do_one_suspendcall(level, suspend_level);
+        ret = object_do_one_suspendcall(level - 2, suspend_level);
         if (ret)
         {
             return ret;
@@ -292,5 +294,10 @@ const object* object_get_binding(const char* const name)
         }
     }
 
+#if CONFIG_TRANSPORT_SHM_ENABLE
+    /* Not a local object, look for a service exported by another process. */
+    return transport_shm_get_binding(name);
+#else
     return NULL;
+#endif
 }
@@ -0,0 +1,472 @@
+/**
+ * @file source/src/payload.c
+ * @brief Definition the message payload pool.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "framework.h"
+
+#if CONFIG_PAYLOAD_POOL_ENABLE
+
+/**
+ * @defgroup Payload_API Payload API
+ *
+ * @brief Reference counted payload blocks for large messages.
+ *
+ * Each size class is a preallocated array of blocks linked into a
+ * lock-free free list, so allocation and release are safe from both
+ * thread and interrupt context. The free list head packs a 16 bits
+ * ABA tag with the 16 bits index of the first free block.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Payload block header, placed in front of the user data.
+ */
+typedef struct
+{
+    uint32_t    next;       /**< Index + 1 of the next free block, 0 terminates. */
+    uint32_t    refs;       /**< Reference count, 0 when the block is free. */
+} payload_block_t;
+
+/**
+ * @brief   Payload size class control structure.
+ */
+typedef struct
+{
+    uint8_t*    mem;        /**< Block storage. */
+    uint32_t    size;       /**< Usable bytes of each block. */
+    uint32_t    count;      /**< Number of blocks. */
+    uint32_t    head;       /**< Free list head, tag << 16 | (index + 1). */
+    uint32_t    used;       /**< Blocks currently allocated. */
+    uint32_t    peak;       /**< Peak allocated blocks. */
+    uint32_t    failed;     /**< Failed allocations. */
+} payload_pool_t;
+
+#ifndef DOC_HIDDEN
+#define PAYLOAD_BLOCK_STRIDE(size) \
+    (sizeof(payload_block_t) + (((size) + 7) & ~7u))
+#define PAYLOAD_INDEX_MASK  0x0000FFFF
+#define PAYLOAD_TAG_ONE     0x00010000
+#endif
+
+static uint8_t payload_small_mem[CONFIG_PAYLOAD_SMALL_COUNT *
+                                 PAYLOAD_BLOCK_STRIDE(CONFIG_PAYLOAD_SMALL_SIZE)]
+__attribute__((aligned(8)));
+static uint8_t payload_medium_mem[CONFIG_PAYLOAD_MEDIUM_COUNT *
+                                  PAYLOAD_BLOCK_STRIDE(CONFIG_PAYLOAD_MEDIUM_SIZE)]
+__attribute__((aligned(8)));
+static uint8_t payload_large_mem[CONFIG_PAYLOAD_LARGE_COUNT *
+                                 PAYLOAD_BLOCK_STRIDE(CONFIG_PAYLOAD_LARGE_SIZE)]
+__attribute__((aligned(8)));
+
+/**
+ * @brief   Payload size classes, sorted by block size.
+ */
+static payload_pool_t payload_pools[PAYLOAD_CLASS_NUM] =
+{
+    { payload_small_mem,  CONFIG_PAYLOAD_SMALL_SIZE,  CONFIG_PAYLOAD_SMALL_COUNT,  0, 0, 0, 0 },
+    { payload_medium_mem, CONFIG_PAYLOAD_MEDIUM_SIZE, CONFIG_PAYLOAD_MEDIUM_COUNT, 0, 0, 0, 0 },
+    { payload_large_mem,  CONFIG_PAYLOAD_LARGE_SIZE,  CONFIG_PAYLOAD_LARGE_COUNT,  0, 0, 0, 0 },
+};
+
+/**
+ * @brief   Non-zero once the free lists are built.
+ */
+static uint32_t payload_ready;
+
+/**
+ * @brief   Get the block header by index.
+ *
+ * @param   pool Pointer to the size class.
+ * @param   index Block index.
+ *
+ * @retval  Returns the block header.
+ */
+static payload_block_t* payload_block(const payload_pool_t* pool,
+                                      uint32_t              index)
+{
+    return (payload_block_t*)(pool->mem +
+                              index * PAYLOAD_BLOCK_STRIDE(pool->size));
+}
+
+/**
+ * @brief   Link every block into the free lists.
+ *
+ * Run at the core level of object_init(), before any service thread or
+ * interrupt can allocate, so the allocation never waits for it.
+ *
+ * @param   obj Pointer to the payload object handle.
+ *
+ * @retval  Returns 0.
+ */
+static int32_t payload_probe(const object* obj)
+{
+    payload_pool_t* pool;
+    uint32_t cls;
+    uint32_t i;
+
+    for (cls = 0; cls < PAYLOAD_CLASS_NUM; cls++)
+    {
+        pool = &payload_pools[cls];
+
+        for (i = 0; i < pool->count; i++)
+        {
+            payload_block(pool, i)->next = (i + 1 < pool->count) ? i + 2 : 0;
+            payload_block(pool, i)->refs = 0;
+        }
+
+        pool->head = pool->count ? 1 : 0;
+    }
+
+    __atomic_store_n(&payload_ready, 1, __ATOMIC_RELEASE);
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Pop one block from the free list of a size class.
+ *
+ * @param   pool Pointer to the size class.
+ *
+ * @retval  Returns the block index, or -1 when the class is exhausted.
+ */
+static int32_t payload_pool_pop(payload_pool_t* pool)
+{
+    uint32_t old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+    uint32_t next;
+    uint32_t index;
+
+    do
+    {
+        index = old & PAYLOAD_INDEX_MASK;
+        if (!index)
+        {
+            return -1;
+        }
+
+        next = __atomic_load_n(&payload_block(pool, index - 1)->next,
+                               __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->head, &old,
+                                          ((old + PAYLOAD_TAG_ONE) &
+                                           ~PAYLOAD_INDEX_MASK) | next,
+                                          1,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+
+    return (int32_t)(index - 1);
+}
+
+/**
+ * @brief   Push one block back on the free list of a size class.
+ *
+ * @param   pool Pointer to the size class.
+ * @param   index Block index.
+ */
+static void payload_pool_push(payload_pool_t* pool, uint32_t index)
+{
+    payload_block_t* blk = payload_block(pool, index);
+    uint32_t old = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+
+    do
+    {
+        __atomic_store_n(&blk->next, old & PAYLOAD_INDEX_MASK,
+                         __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->head, &old,
+                                          ((old + PAYLOAD_TAG_ONE) &
+                                           ~PAYLOAD_INDEX_MASK) | (index + 1),
+                                          1,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief   Locate the size class and block index of a payload.
+ *
+ * @param   payload Pointer to the payload data.
+ * @param   cls Output of the size class.
+ * @param   index Output of the block index.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t payload_locate(const void* payload,
+                              uint32_t*   cls,
+                              uint32_t*   index)
+{
+    const uint8_t* ptr = (const uint8_t*)payload - sizeof(payload_block_t);
+    const payload_pool_t* pool;
+    uint32_t stride;
+    uint32_t offset;
+    uint32_t i;
+
+    for (i = 0; i < PAYLOAD_CLASS_NUM; i++)
+    {
+        pool = &payload_pools[i];
+        stride = PAYLOAD_BLOCK_STRIDE(pool->size);
+
+        if (ptr < pool->mem || ptr >= pool->mem + pool->count * stride)
+        {
+            continue;
+        }
+
+        offset = (uint32_t)(ptr - pool->mem);
+        if (offset % stride)
+        {
+            return -EINVAL;
+        }
+
+        *cls = i;
+        *index = offset / stride;
+
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * @brief   Allocate a payload block.
+ *
+ * The smallest class that fits is tried first, a larger class is used
+ * when it is exhausted. The block is returned with one reference held.
+ * Safe to call from interrupt context, fails before object_init().
+ *
+ * @param   size Required size in bytes.
+ *
+ * @retval  Returns the payload data, or NULL when no block is available.
+ *
+ * @ingroup Payload_API
+ */
+void* payload_alloc(uint32_t size)
+{
+    payload_pool_t* pool;
+    payload_block_t* blk;
+    uint32_t used;
+    uint32_t peak;
+    int32_t index;
+    uint32_t cls;
+
+    /* The free lists are built by object_init(). */
+    if (!__atomic_load_n(&payload_ready, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    for (cls = 0; cls < PAYLOAD_CLASS_NUM; cls++)
+    {
+        pool = &payload_pools[cls];
+        if (pool->size < size)
+        {
+            continue;
+        }
+
+        index = payload_pool_pop(pool);
+        if (index < 0)
+        {
+            __atomic_add_fetch(&pool->failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        blk = payload_block(pool, (uint32_t)index);
+        __atomic_store_n(&blk->refs, 1, __ATOMIC_RELEASE);
+
+        used = __atomic_add_fetch(&pool->used, 1, __ATOMIC_RELAXED);
+        peak = __atomic_load_n(&pool->peak, __ATOMIC_RELAXED);
+        while (used > peak &&
+               !__atomic_compare_exchange_n(&pool->peak, &peak, used, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+        {
+        }
+
+        return (void*)(blk + 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Take one more reference on a payload.
+ *
+ * @param   payload Pointer to the payload data.
+ *
+ * @ingroup Payload_API
+ */
+void payload_ref(void* payload)
+{
+    payload_block_t* blk;
+
+    if (!payload)
+    {
+        return;
+    }
+
+    blk = (payload_block_t*)payload - 1;
+    __atomic_add_fetch(&blk->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Drop one reference on a payload.
+ *
+ * The block returns to its pool when the last reference is dropped.
+ * Safe to call from interrupt context.
+ *
+ * @param   payload Pointer to the payload data.
+ *
+ * @ingroup Payload_API
+ */
+void payload_release(void* payload)
+{
+    payload_block_t* blk;
+    uint32_t index;
+    uint32_t cls;
+
+    if (!payload)
+    {
+        return;
+    }
+
+    if (payload_locate(payload, &cls, &index))
+    {
+        pr_error("Release invalid payload %p.", payload);
+        return;
+    }
+
+    blk = (payload_block_t*)payload - 1;
+    if (__atomic_sub_fetch(&blk->refs, 1, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+
+    __atomic_sub_fetch(&payload_pools[cls].used, 1, __ATOMIC_RELAXED);
+    payload_pool_push(&payload_pools[cls], index);
+}
+
+/**
+ * @brief   Get the usable size of a payload block.
+ *
+ * @param   payload Pointer to the payload data.
+ *
+ * @retval  Returns the block size, 0 if the payload is invalid.
+ *
+ * @ingroup Payload_API
+ */
+uint32_t payload_get_size(const void* payload)
+{
+    uint32_t index;
+    uint32_t cls;
+
+    if (!payload || payload_locate(payload, &cls, &index))
+    {
+        return 0;
+    }
+
+    return payload_pools[cls].size;
+}
+
+/**
+ * @brief   Convert a payload to the 32 bits handle carried by a message.
+ *
+ * @param   payload Pointer to the payload data.
+ *
+ * @retval  Returns the handle, PAYLOAD_HANDLE_INVALID if the payload is invalid.
+ *
+ * @ingroup Payload_API
+ */
+uint32_t payload_to_handle(const void* payload)
+{
+    uint32_t index;
+    uint32_t cls;
+
+    if (!payload || payload_locate(payload, &cls, &index))
+    {
+        return PAYLOAD_HANDLE_INVALID;
+    }
+
+    return ((cls + 1) << 16) | index;
+}
+
+/**
+ * @brief   Convert a message handle back to the payload.
+ *
+ * @param   handle Payload handle.
+ *
+ * @retval  Returns the payload data, or NULL if the handle is invalid.
+ *
+ * @ingroup Payload_API
+ */
+void* payload_from_handle(uint32_t handle)
+{
+    uint32_t cls = (handle >> 16) - 1;
+    uint32_t index = handle & PAYLOAD_INDEX_MASK;
+
+    if (handle == PAYLOAD_HANDLE_INVALID ||
+        cls >= PAYLOAD_CLASS_NUM ||
+        index >= payload_pools[cls].count)
+    {
+        return NULL;
+    }
+
+    return (void*)(payload_block(&payload_pools[cls], index) + 1);
+}
+
+/**
+ * @brief   Get the statistics of a payload size class.
+ *
+ * @param   cls Payload size class.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Payload_API
+ */
+int32_t payload_get_stats(payload_class_e cls, payload_stats_t* stats)
+{
+    const payload_pool_t* pool;
+
+    if (cls >= PAYLOAD_CLASS_NUM || !stats)
+    {
+        return -EINVAL;
+    }
+
+    pool = &payload_pools[cls];
+
+    stats->block_size = pool->size;
+    stats->block_count = pool->count;
+    stats->used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED);
+    stats->peak = __atomic_load_n(&pool->peak, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&pool->failed, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+module_core("payload",
+            payload,
+            payload_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_PAYLOAD_POOL_ENABLE */
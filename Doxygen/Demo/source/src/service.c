@@ -24,6 +24,22 @@
 #include <string.h>
 #include "cmsis_os.h"
 #include "framework.h"
+#include "service_stack.h"
+#include "interceptor.h"
+#include "transport_shm.h"
+#include "service_affinity.h"
+#include "service_request.h"
+#include "service_queue_tune.h"
+#include "service_watchdog.h"
+#include "service_isr.h"
+#include "service_routes.h"
+#include "service_replica.h"
+#include "service_credit.h"
+#include "service_stream.h"
+#include "service_rate.h"
+#include "service_pool.h"
+#include "service_load.h"
+#include "service_group.h"
 
 /**
  * @defgroup Service_API Service API
@@ -53,33 +69,847 @@
  * @}
  */
 
+/**
+ * @brief   Get the timeout for sending a message in the current context.
+ *
+ * @retval  Returns 0 in interrupt context, the blocking timeout in ticks otherwise.
+ */
+static uint32_t service_get_send_timeout(void)
+{
+    BaseType_t is_irq = xPortIsInsideInterrupt();
+
+    if (is_irq)
+    {
+        return 0;
+    }
+
+    return CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS * osKernelGetTickFreq() / 1000;
+}
+
+/**
+ * @brief   Get what is left of a send timeout shared by a fan-out.
+ *
+ * @param   start Tick the fan-out started.
+ * @param   timeout Timeout of the whole fan-out in ticks.
+ *
+ * @retval  Returns the ticks left, 0 once the timeout has passed.
+ */
+static uint32_t service_send_remaining(uint32_t start, uint32_t timeout)
+{
+    uint32_t elapsed = osKernelGetTickCount() - start;
+
+    return (elapsed < timeout) ? timeout - elapsed : 0;
+}
+
+#ifndef DOC_HIDDEN
+/* The send path works on a private copy when it has to modify the message. */
+#define SERVICE_SEND_COPY (CONFIG_MSG_LAYOUT_ALIGNED || CONFIG_INTERCEPTOR_ENABLE)
+#endif
+
+#if CONFIG_MSG_LAYOUT_ALIGNED
+/**
+ * @brief   Global send sequence number.
+ */
+static uint32_t service_msg_seq;
+
+/**
+ * @brief   Fill the framework fields of an outgoing message.
+ *
+ * @param   message Pointer to the message copy to stamp.
+ */
+static void service_message_stamp(message_t* message)
+{
+#if CONFIG_MSG_DEADLINE_ENABLE
+    uint32_t ttl;
+#endif
+
+    message->seq = __atomic_add_fetch(&service_msg_seq, 1, __ATOMIC_RELAXED);
+    message->timestamp = osKernelGetTickCount();
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+    /* A deadline set by the sender, or kept across a redirect, wins. */
+    if (!message->deadline)
+    {
+        ttl = msg_id_to_ttl(message->id);
+        if (ttl)
+        {
+            message->deadline = message->timestamp + (uint32_t)((uint64_t)ttl * osKernelGetTickFreq() / 1000);
+            message->deadline += !message->deadline;
+        }
+    }
+#else
+    message->deadline = 0;
+#endif
+}
+#endif
+
+/**
+ * @brief   Release the resources attached to a message that is not delivered.
+ *
+ * @param   message Pointer to the message, with the framework flags.
+ *
+ * @ingroup Service_Control
+ */
+void service_message_discard(const message_t* message)
+{
+#if CONFIG_PAYLOAD_POOL_ENABLE
+    if (message->id & MSG_ID_FLAG_PAYLOAD)
+    {
+        payload_release(payload_from_handle(message->param3));
+    }
+#endif
+
+#if CONFIG_SERVICE_REQUEST_ENABLE
+    /* Fail the request now rather than let the caller time out. */
+    if (message->id & MSG_ID_FLAG_REQUEST)
+    {
+        (void)service_request_complete(MSG_ID_REQUEST_TAG(message->id),
+                                       NULL,
+                                       -EPIPE);
+    }
+#endif
+
+#if CONFIG_SERVICE_CREDIT_ENABLE
+    /* Handled or dropped, the credit goes back to the producer. */
+    if (message->id & MSG_ID_FLAG_CREDIT)
+    {
+        service_credit_grant(MSG_ID_CREDIT_CHANNEL(message->id));
+    }
+#endif
+
+#if CONFIG_SERVICE_STREAM_ENABLE
+    /* Handled or dropped, the stream may notify again. */
+    if (message->id & MSG_ID_FLAG_STREAM)
+    {
+        service_stream_grant(MSG_ID_STREAM_INDEX(message->id), 0);
+    }
+#endif
+
+    (void)message;
+}
+
+/**
+ * @brief   Put a message into the queue of a service and wake it up.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the RTOS status.
+ */
+static osStatus_t service_queue_put(const service_t*    svc,
+                                    const message_t*    message,
+                                    uint32_t            timeout)
+{
+    osStatus_t stat;
+#if CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+    uint32_t occupancy;
+#endif
+
+#if SERVICE_TRANSPORT_ENABLE
+    if (svc->transport)
+    {
+        return svc->transport->put(svc, message, timeout);
+    }
+#endif
+
+#if CONFIG_SERVICE_POOL_ENABLE
+    if (svc->pool)
+    {
+#if CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+        occupancy = service_pool_count(svc);
+#endif
+        stat = service_pool_put(svc, message, timeout);
+    }
+    else
+#endif
+    {
+#if CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+        occupancy = osMessageQueueGetCount(svc->queue_id);
+#endif
+        stat = osMessageQueuePut(svc->queue_id, message, 0, timeout);
+    }
+
+#if CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+    service_queue_tune_record(svc, occupancy, stat);
+#endif
+
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+    if (stat == osOK)
+    {
+        (void)osThreadFlagsSet(svc->thread_id, SERVICE_THREAD_FLAG_QUEUE);
+    }
+#endif
+
+    return stat;
+}
+
+/**
+ * @brief   Take the next message from the queue of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Pointer to the message buffer.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the RTOS status.
+ */
+static inline osStatus_t service_queue_get(const service_t*  svc,
+                                           message_t*        message,
+                                           uint32_t          timeout)
+{
+#if CONFIG_SERVICE_POOL_ENABLE
+    if (svc->pool)
+    {
+        return service_pool_get(svc, message, timeout);
+    }
+#endif
+
+    return osMessageQueueGet(svc->queue_id, message, NULL, timeout);
+}
+
+/**
+ * @brief   Run the framework steps before the message handler.
+ *
+ * @param   svc Pointer to the service handle, one replica of a replicated service.
+ * @param   message Pointer to the received message, with the framework flags.
+ * @param   flags Pointer to the framework flags stripped from the message id.
+ *
+ * @retval  Returns 0 if the handler must run, non-zero if the message was consumed.
+ */
+static inline int32_t service_dispatch_enter(service_t* svc, message_t* message, uint32_t* flags)
+{
+    const service_t* target = svc;
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+    /* A stale message only prolongs an overload, drop it unhandled. */
+    if (message->deadline &&
+        (int32_t)(osKernelGetTickCount() - message->deadline) > 0)
+    {
+        (void)__atomic_add_fetch(&svc->expired, 1, __ATOMIC_RELAXED);
+        service_message_discard(message);
+        return 1;
+    }
+#endif
+
+    switch (INTERCEPTOR_RUN(INTERCEPT_POINT_DISPATCH, &target, message))
+    {
+    case INTERCEPT_DROP:
+        service_message_discard(message);
+        return 1;
+    case INTERCEPT_REDIRECT:
+        /*
+         * The redirected message keeps its flags and payload reference.
+         * Back to the service itself, it would come back here forever.
+         */
+        if (!target ||
+            target == svc ||
+            target == svc - SERVICE_REPLICA_INDEX(svc) ||
+            service_unicast_message(target, message))
+        {
+            service_message_discard(message);
+        }
+        return 1;
+    default:
+        break;
+    }
+
+    *flags = message->id & MSG_ID_FLAGS_MASK;
+    message->id &= ~MSG_ID_FLAGS_MASK;
+
+#if CONFIG_PAYLOAD_POOL_ENABLE
+    /* The handler no longer sees the flag, msg_get_payload() checks here. */
+    svc->payload = (*flags & MSG_ID_FLAG_PAYLOAD) ? message->param3 : 0;
+#endif
+
+#if CONFIG_SERVICE_REQUEST_ENABLE
+    svc->request = (*flags & MSG_ID_FLAG_REQUEST) ? MSG_ID_REQUEST_TAG(*flags) : 0;
+#endif
+
+#if CONFIG_SERVICE_WATCHDOG_ENABLE
+    service_watchdog_begin(svc, message->id);
+#endif
+
+#if CONFIG_SERVICE_LOAD_ENABLE
+    service_load_begin(svc);
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief   Run the framework steps after the message handler.
+ *
+ * @param   svc Pointer to the service handle, one replica of a replicated service.
+ * @param   message Pointer to the handled message.
+ * @param   flags Framework flags returned by service_dispatch_enter().
+ */
+static void service_dispatch_leave(service_t* svc, message_t* message, uint32_t flags)
+{
+#if CONFIG_SERVICE_LOAD_ENABLE
+    service_load_end(svc, message->id);
+#endif
+
+#if CONFIG_SERVICE_WATCHDOG_ENABLE
+    service_watchdog_end(svc);
+#endif
+
+#if CONFIG_PAYLOAD_POOL_ENABLE
+    svc->payload = 0;
+#endif
+
+#if CONFIG_SERVICE_REQUEST_ENABLE
+    /* Replied or deferred, the discard below must not fail it. */
+    if (!svc->request)
+    {
+        flags &= ~MSG_ID_FLAG_REQUEST;
+    }
+
+    svc->request = 0;
+#endif
+
+#if CONFIG_SERVICE_STREAM_ENABLE
+    /* Handled, the consumer is notified again if it left data buffered. */
+    if (flags & MSG_ID_FLAG_STREAM)
+    {
+        flags &= ~MSG_ID_FLAG_STREAM;
+        service_stream_grant(MSG_ID_STREAM_INDEX(flags), 1);
+    }
+#endif
+
+    message->id |= flags;
+    service_message_discard(message);
+
+    (void)svc;
+}
+
+/**
+ * @brief   Dispatch one received message to the service.
+ *
+ * @param   svc Pointer to the service handle, one replica of a replicated service.
+ * @param   message Pointer to the received message, with the framework flags.
+ */
+static void service_dispatch(service_t* svc, message_t* message)
+{
+    const object* obj = svc->owner;
+    service_intf_t* intf = (service_intf_t*)obj->object_intf;
+    uint32_t flags;
+
+    if (service_dispatch_enter(svc, message, &flags))
+    {
+        return;
+    }
+
+    if (intf->message_handler)
+    {
+        intf->message_handler(obj, message);
+    }
+
+    service_dispatch_leave(svc, message, flags);
+}
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+/**
+ * @brief   Check whether a message is due before another one.
+ *
+ * Messages without deadline come last, ties keep the send order.
+ *
+ * @param   a Pointer to the first message.
+ * @param   b Pointer to the second message.
+ * @param   now Current tick.
+ *
+ * @retval  Returns non-zero if a is due first.
+ */
+static int32_t service_deadline_before(const message_t* a, const message_t* b, uint32_t now)
+{
+    int32_t due_a = a->deadline ? (int32_t)(a->deadline - now) : INT32_MAX;
+    int32_t due_b = b->deadline ? (int32_t)(b->deadline - now) : INT32_MAX;
+
+    if (due_a != due_b)
+    {
+        return due_a < due_b;
+    }
+
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/**
+ * @brief   Dispatch a batch of queued messages earliest deadline first.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   first Message already received, or NULL.
+ *
+ * @retval  Returns the number of messages dispatched.
+ */
+static uint32_t service_dispatch_edf(service_t* svc, const message_t* first)
+{
+    message_t batch[CONFIG_MSG_DEADLINE_EDF_BATCH];
+    message_t message;
+    uint32_t count = 0;
+    uint32_t total;
+    uint32_t best;
+    uint32_t now;
+    uint32_t i;
+
+    if (first)
+    {
+        batch[count++] = *first;
+    }
+
+    while (count < CONFIG_MSG_DEADLINE_EDF_BATCH &&
+           service_queue_get(svc, &batch[count], 0) == osOK)
+    {
+        count++;
+    }
+
+    total = count;
+    now = osKernelGetTickCount();
+
+    while (count)
+    {
+        best = 0;
+
+        for (i = 1; i < count; i++)
+        {
+            if (service_deadline_before(&batch[i], &batch[best], now))
+            {
+                best = i;
+            }
+        }
+
+        message = batch[best];
+        batch[best] = batch[--count];
+
+        service_dispatch(svc, &message);
+    }
+
+    return total;
+}
+
+/**
+ * @brief   Check whether a service dispatches earliest deadline first.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns non-zero if SERVICE_FLAG_EDF is set.
+ */
+static int32_t service_edf_enabled(const service_t* svc)
+{
+    const service_config_t* config =
+        (const service_config_t*)svc->owner->object_config;
+
+    return config && (config->flags & SERVICE_FLAG_EDF);
+}
+#endif
+
+#if CONFIG_SERVICE_CO_ENABLE
+/**
+ * @brief   Get how long the service thread may sleep.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the ticks until a coroutine await times out, osWaitForever if none waits.
+ */
+static uint32_t service_wake_timeout(const service_t* svc)
+{
+    int32_t left;
+
+    if (!svc->wake)
+    {
+        return osWaitForever;
+    }
+
+    left = (int32_t)(svc->wake - osKernelGetTickCount());
+
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/**
+ * @brief   Wake the coroutines of the service whose await timed out.
+ *
+ * Checked after every wait of the service thread, so a busy queue does
+ * not hold the timeouts back.
+ *
+ * @param   svc Pointer to the service handle.
+ */
+static void service_wake_dispatch(service_t* svc)
+{
+    message_t message;
+
+    if (!svc->wake || (int32_t)(osKernelGetTickCount() - svc->wake) < 0)
+    {
+        return;
+    }
+
+    /* The coroutines still waiting arm it again when fed. */
+    svc->wake = 0;
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = MSG_ID_SYS_CO_TIMEOUT;
+
+    service_dispatch(svc, &message);
+}
+
+#define SERVICE_WAIT_TIMEOUT(svc) service_wake_timeout(svc)
+#define SERVICE_WAKE_DISPATCH(svc) service_wake_dispatch(svc)
+#else
+#define SERVICE_WAIT_TIMEOUT(svc) osWaitForever
+#define SERVICE_WAKE_DISPATCH(svc)
+#endif
+
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+/**
+ * @brief   Deliver the pending signals as synthesized messages.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   signals Pending signal bits.
+ */
+static void service_dispatch_signals(service_t* svc, uint32_t signals)
+{
+    message_t message;
+    uint32_t bit;
+
+    for (bit = 0; signals; bit++, signals >>= 1)
+    {
+        if (!(signals & 1))
+        {
+            continue;
+        }
+
+        (void)memset(&message, 0, sizeof(message));
+        message.id = msg_signal_to_id(bit);
+
+        service_dispatch(svc, &message);
+    }
+}
+
+/**
+ * @brief   Service routine thread, processing signals and message loops.
+ *
+ * The thread sleeps on its thread flags. Signals are delivered first,
+ * then the message queue is drained without blocking.
+ *
+ * @param   argument Pointer to the service handle.
+ */
+static void service_routine_thread(void* argument)
+{
+    service_t* svc = (service_t*)argument;
+    message_t message;
+    uint32_t flags;
+#if CONFIG_MSG_DEADLINE_ENABLE
+    int32_t edf = service_edf_enabled(svc);
+#endif
+
+    while (1)
+    {
+        flags = osThreadFlagsWait(SERVICE_THREAD_FLAGS_ALL,
+                                  osFlagsWaitAny,
+                                  SERVICE_WAIT_TIMEOUT(svc));
+
+        SERVICE_WAKE_DISPATCH(svc);
+
+        if (flags & osFlagsError)
+        {
+            continue;
+        }
+
+        service_dispatch_signals(svc, flags & SERVICE_THREAD_FLAGS_SIGNAL);
+
+        if (flags & SERVICE_THREAD_FLAG_QUEUE)
+        {
+#if CONFIG_MSG_DEADLINE_ENABLE
+            if (edf)
+            {
+                while (service_dispatch_edf(svc, NULL))
+                {
+                }
+
+                continue;
+            }
+#endif
+
+            while (service_queue_get(svc, &message, 0) == osOK)
+            {
+                service_dispatch(svc, &message);
+            }
+        }
+    }
+}
+#else
 /**
  * @brief   Service routine thread, processing message loops.
  *
- * @param   argument Pointer to the service object handle.
+ * @param   argument Pointer to the service handle.
  */
 static void service_routine_thread(void* argument)
 {
-    object* obj = (object*)argument;
-    service_t* svc = (service_t*)obj->object_data;
-    service_intf_t* intf = (service_intf_t*)obj->object_intf;
+    service_t* svc = (service_t*)argument;
+    message_t message;
+    osStatus_t stat;
+#if CONFIG_MSG_DEADLINE_ENABLE
+    int32_t edf = service_edf_enabled(svc);
+#endif
+
+    while (1)
+    {
+        stat = service_queue_get(svc, &message, SERVICE_WAIT_TIMEOUT(svc));
+
+        SERVICE_WAKE_DISPATCH(svc);
+
+        if (stat != osOK)
+        {
+            continue;
+        }
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+        if (edf)
+        {
+            (void)service_dispatch_edf(svc, &message);
+            continue;
+        }
+#endif
+
+        service_dispatch(svc, &message);
+    }
+}
+#endif
+
+#if SERVICE_TRANSPORT_ENABLE
+/**
+ * @brief   Service routine thread for services backed by a transport.
+ *
+ * The message is dispatched in place from the transport slot.
+ *
+ * @param   argument Pointer to the service handle.
+ */
+static void service_transport_thread(void* argument)
+{
+    service_t* svc = (service_t*)argument;
+    message_t* message;
+
+    while (1)
+    {
+        message = svc->transport->get(svc, SERVICE_WAIT_TIMEOUT(svc));
+
+        SERVICE_WAKE_DISPATCH(svc);
+
+        if (!message)
+        {
+            continue;
+        }
+
+        service_dispatch(svc, message);
+
+        svc->transport->release(svc, message);
+    }
+}
+#endif
+
+#if CONFIG_SERVICE_DIRECT_ENABLE
+/**
+ * @brief   Wait for the next message the handler of a service in direct mode must run for.
+ *
+ * Signals and coroutine timeouts are still dispatched here, through the
+ * generic handler. The messages consumed before the handler, expired,
+ * dropped or redirected, are not returned.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Pointer to the message buffer.
+ * @param   flags Pointer to the framework flags stripped from the message id.
+ */
+void service_direct_receive(service_t* svc, message_t* message, uint32_t* flags)
+{
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+    uint32_t pending;
+
+    do
+    {
+        /* Drain the queue first, as the generic loop does after a wake up. */
+        while (service_queue_get(svc, message, 0) != osOK)
+        {
+            pending = osThreadFlagsWait(SERVICE_THREAD_FLAGS_ALL,
+                                        osFlagsWaitAny,
+                                        SERVICE_WAIT_TIMEOUT(svc));
+
+            SERVICE_WAKE_DISPATCH(svc);
+
+            if (!(pending & osFlagsError))
+            {
+                service_dispatch_signals(svc, pending & SERVICE_THREAD_FLAGS_SIGNAL);
+            }
+        }
+    } while (service_dispatch_enter(svc, message, flags));
+#else
+    osStatus_t stat;
+
+    do
+    {
+        stat = service_queue_get(svc, message, SERVICE_WAIT_TIMEOUT(svc));
+
+        SERVICE_WAKE_DISPATCH(svc);
+    } while (stat != osOK || service_dispatch_enter(svc, message, flags));
+#endif
+}
+
+/**
+ * @brief   Finish the message handled and wait for the next one, see service_direct_loop().
+ *
+ * One call per message keeps direct mode cheap without LTO=y as well.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Pointer to the handled message, receives the next one.
+ * @param   flags Pointer to the framework flags of the handled message, receives the next ones.
+ */
+void service_direct_next(service_t* svc, message_t* message, uint32_t* flags)
+{
+    service_dispatch_leave(svc, message, *flags);
+    service_direct_receive(svc, message, flags);
+}
+#endif
+
+/**
+ * @brief   Pick the thread function of one service handle.
+ *
+ * The receive loop generated by DECLARE_SERVICE() in direct mode serves
+ * the plain and pooled queues, transports and EDF batches keep the
+ * generic loops.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the thread function.
+ */
+static osThreadFunc_t service_thread_func(const service_t* svc)
+{
+#if SERVICE_TRANSPORT_ENABLE
+    if (svc->transport)
+    {
+        return service_transport_thread;
+    }
+#endif
+
+#if CONFIG_MSG_DEADLINE_ENABLE
+    if (service_edf_enabled(svc))
+    {
+        return service_routine_thread;
+    }
+#endif
+
+#if CONFIG_SERVICE_DIRECT_ENABLE
+    if (svc->direct)
+    {
+        return svc->direct;
+    }
+#endif
+
+    return service_routine_thread;
+}
+
+/**
+ * @brief   Entry of a service thread, publishes the handle for service_get_current().
+ *
+ * @param   argument Pointer to the service handle.
+ */
+static void service_thread_entry(void* argument)
+{
+    service_t* svc = (service_t*)argument;
+
+    vTaskSetThreadLocalStoragePointer(NULL, CONFIG_SERVICE_TLS_INDEX, svc);
+
+    service_thread_func(svc)(svc);
+}
+
+/**
+ * @brief   Create the queue and the thread of one service handle.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   config Pointer to the configuration space.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_start(service_t* svc, const service_config_t* const config)
+{
+    const object* obj = svc->owner;
+
+    if (!SERVICE_TRANSPORT(svc) && !SERVICE_POOL(svc))
+    {
+        svc->queue_id = osMessageQueueNew(config->msg_count,
+                                          sizeof(message_t),
+                                          &config->queue_attr);
+        if (!svc->queue_id)
+        {
+            pr_error("Service <%s> create message queue <%s> failed.",
+                     obj->name,
+                     config->queue_attr.name);
+            return -EINVAL;
+        }
+    }
+
+    svc->thread_id = osThreadNew(service_thread_entry,
+                                 (void*)svc,
+                                 &config->thread_attr);
+    if (!svc->thread_id)
+    {
+        pr_error("Service <%s> create thread <%s> failed.",
+                 obj->name,
+                 config->thread_attr.name);
+        return -EINVAL;
+    }
+
+#if CONFIG_SERVICE_AFFINITY_ENABLE
+    /* Placed by the traffic pass, or pinned as configured. */
+    if (!svc->affinity)
+    {
+        svc->affinity = config->affinity;
+    }
+
+    service_affinity_apply(svc);
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief   Delete the thread and the queue of one service handle.
+ *
+ * @param   svc Pointer to the service handle.
+ */
+static void service_stop(service_t* svc)
+{
+    const object* obj = svc->owner;
     message_t message;
     osStatus_t stat;
 
-    while (1)
+    if (svc->thread_id)
+    {
+        stat = osThreadTerminate(svc->thread_id);
+        if (stat != osOK)
+        {
+            pr_error("Service <%s> terminate thread <%s> failed, stat %d.",
+                     obj->name,
+                     osThreadGetName(svc->thread_id),
+                     stat);
+        }
+
+        /* The RTOS frees a terminated thread, its id is stale now. */
+        svc->thread_id = NULL;
+    }
+
+    /* Release what the messages left hold, payloads, requests and credits. */
+    if (svc->queue_id || SERVICE_POOL(svc))
     {
-        stat = osMessageQueueGet(svc->queue_id,
-                                 &message,
-                                 NULL,
-                                 osWaitForever);
-        if (stat != osOK)
+        while (service_queue_get(svc, &message, 0) == osOK)
         {
-            continue;
+            service_message_discard(&message);
         }
+    }
 
-        if (intf->message_handler)
+    if (svc->queue_id)
+    {
+        stat = osMessageQueueDelete(svc->queue_id);
+        if (stat != osOK)
         {
-            intf->message_handler(obj, &message);
+            pr_error("Service <%s> delete message queue failed, stat %d.",
+                     obj->name,
+                     stat);
         }
     }
 }
@@ -96,30 +926,74 @@ static int32_t service_init(const object*                   obj,
                             const service_config_t* const   config)
 {
     service_t* svc = (service_t*)obj->object_data;
+    uint32_t count = SERVICE_REPLICA_COUNT(svc);
+    uint32_t i;
     int32_t ret;
 
-    svc->queue_id = osMessageQueueNew(config->msg_count,
-                                      sizeof(message_t),
-                                      &config->queue_attr);
-    if (!svc->queue_id)
+#if CONFIG_SERVICE_REPLICA_ENABLE
+    /* Every replica needs its own stack, queue memory and control blocks. */
+    if (count > 1 &&
+        ((config->flags & SERVICE_FLAG_SHM_EXPORT) ||
+         config->thread_attr.stack_mem || config->thread_attr.cb_mem ||
+         config->queue_attr.mq_mem || config->queue_attr.cb_mem))
     {
-        pr_error("Service <%s> create message queue <%s> failed.",
-                 obj->name,
-                 config->queue_attr.name);
+        pr_error("Service <%s> replicas need RTOS allocated memory.", obj->name);
         return -EINVAL;
     }
+#endif
 
-    svc->thread_id = osThreadNew(service_routine_thread,
-                                 (void*)obj,
-                                 &config->thread_attr);
-    if (!svc->thread_id)
+#if CONFIG_SERVICE_POOL_ENABLE
+    if ((config->flags & SERVICE_FLAG_SHARED_POOL) &&
+        (config->flags & SERVICE_FLAG_SHM_EXPORT))
     {
-        pr_error("Service <%s> create thread <%s> failed.",
-                 obj->name,
-                 config->thread_attr.name);
+        pr_error("Service <%s> cannot both export and pool its queue.", obj->name);
         return -EINVAL;
     }
 
+    if (config->flags & SERVICE_FLAG_SHARED_POOL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            ret = service_pool_attach(&svc[i], config);
+            if (ret)
+            {
+                pr_error("Service <%s> attach to the shared pool failed, ret %d.",
+                         obj->name,
+                         ret);
+                return ret;
+            }
+        }
+    }
+#endif
+
+#if CONFIG_TRANSPORT_SHM_ENABLE
+    if (config->flags & SERVICE_FLAG_SHM_EXPORT)
+    {
+        ret = transport_shm_export(obj, config);
+        if (ret)
+        {
+            pr_error("Service <%s> export shared memory queue failed, ret %d.",
+                     obj->name,
+                     ret);
+            return ret;
+        }
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        svc[i].owner = obj;
+#if CONFIG_SERVICE_REPLICA_ENABLE
+        svc[i].replica = i;
+#endif
+
+        ret = service_start(&svc[i], config);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+
     if (svc->init)
     {
         ret = svc->init(obj);
@@ -142,35 +1016,32 @@ static int32_t service_init(const object*                   obj,
 static int32_t service_deinit(const object* obj)
 {
     service_t* svc = (service_t*)obj->object_data;
-    osStatus_t stat;
+    const service_config_t* config = (const service_config_t*)obj->object_config;
+    uint32_t count = SERVICE_REPLICA_COUNT(svc);
+    uint32_t i;
 
     if (svc->deinit)
     {
         svc->deinit(obj);
     }
 
-    if (svc->thread_id)
+    for (i = 0; i < count; i++)
     {
-        stat = osThreadTerminate(svc->thread_id);
-        if (stat != osOK)
-        {
-            pr_error("Service <%s> terminate thread <%s> failed, stat %d.",
-                     obj->name,
-                     osThreadGetName(svc->thread_id),
-                     stat);
-        }
+        service_stop(&svc[i]);
+
+#if CONFIG_SERVICE_POOL_ENABLE
+        service_pool_detach(&svc[i]);
+#endif
     }
 
-    if (svc->queue_id)
+#if CONFIG_TRANSPORT_SHM_ENABLE
+    if (svc->transport && config && (config->flags & SERVICE_FLAG_SHM_EXPORT))
     {
-        stat = osMessageQueueDelete(svc->queue_id);
-        if (stat != osOK)
-        {
-            pr_error("Service <%s> delete message queue failed, stat %d.",
-                     obj->name,
-                     stat);
-        }
+        transport_shm_unexport(obj);
     }
+#endif
+
+    (void)config;
 
     return 0;
 }
@@ -202,241 +1073,711 @@ const service_intf_t service_intf =
     .message_handler    = service_message_handler,
 };
 
-/**
- * @brief   Probe the service object.
- *
- * @param   obj Pointer to the service object handle.
- *
- * @retval  Returns 0 on success, negative error code otherwise.
- */
-int32_t service_probe(const object* obj)
-{
-    service_t* svc = (service_t*)obj->object_data;
-    const service_config_t* config =
-        (const service_config_t*)obj->object_config;
-    service_intf_t* intf = (service_intf_t*)obj->object_intf;
-    int32_t ret;
+/**
+ * @brief   Probe the service object.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+int32_t service_probe(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+    const service_config_t* config =
+        (const service_config_t*)obj->object_config;
+    service_intf_t* intf = (service_intf_t*)obj->object_intf;
+    int32_t ret;
+
+    svc->owner = obj;
+
+    if (intf->init)
+    {
+        ret = intf->init(obj, config);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Remove the service object.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+int32_t service_shutdown(const object* obj)
+{
+    service_intf_t* intf = (service_intf_t*)obj->object_intf;
+    int32_t ret;
+
+    if (intf->deinit)
+    {
+        ret = intf->deinit(obj);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+
+    pr_info("Object <%s> shutdown succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Get the thread ID for service.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns the thread ID.
+ *
+ * @ingroup Service_Property
+ */
+osThreadId_t service_get_thread_id(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+
+    return svc->thread_id;
+}
+
+/**
+ * @brief   Get the queue ID for service.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns the queue ID.
+ *
+ * @ingroup Service_Property
+ */
+osMessageQueueId_t service_get_queue_id(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+
+    return svc->queue_id;
+}
+
+/**
+ * @brief   Get the private data for service.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns the private data.
+ *
+ * @ingroup Service_Property
+ */
+void* service_get_priv_data(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+
+    return svc->priv;
+}
+
+/**
+ * @brief   Get the service handle.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns the service handle.
+ *
+ * @ingroup Service_Property
+ */
+service_t* service_get_svc(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+
+    return svc;
+}
+
+/**
+ * @brief   Get the number of messages dropped past their deadline.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @retval  Returns the drop count, summed over the replicas.
+ *
+ * @ingroup Service_Property
+ */
+uint32_t service_get_expired_count(const object* obj)
+{
+    uint32_t expired = 0;
+#if CONFIG_MSG_DEADLINE_ENABLE
+    const service_t* svc = (const service_t*)obj->object_data;
+    uint32_t count = SERVICE_REPLICA_COUNT(svc);
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        expired += __atomic_load_n(&svc[i].expired, __ATOMIC_RELAXED);
+    }
+#else
+    (void)obj;
+#endif
+
+    return expired;
+}
+
+/**
+ * @brief   Get the service handle of the calling thread.
+ *
+ * A service thread keeps its handle in a thread local storage pointer,
+ * so the lookup costs the same for any number of services.
+ *
+ * @retval  Returns the service handle, or NULL if the caller is not a service thread.
+ *
+ * @ingroup Service_Property
+ */
+service_t* service_get_current(void)
+{
+    osThreadId_t thread_id;
+
+    if (xPortIsInsideInterrupt())
+    {
+        return NULL;
+    }
+
+    thread_id = osThreadGetId();
+    if (!thread_id)
+    {
+        return NULL;
+    }
+
+    /* Other threads never set the slot, it reads NULL. */
+    return (service_t*)pvTaskGetThreadLocalStoragePointer((TaskHandle_t)thread_id,
+                                                          CONFIG_SERVICE_TLS_INDEX);
+}
+
+/**
+ * @brief   Broadcast event messages to all services.
+ *
+ * With the routing tables enabled, only the services consuming the
+ * message id and the wildcard services receive it. A full queue does
+ * not stop the services after it, the send returns -EPIPE once all
+ * were offered the message. The services share one send timeout, a
+ * blocked send waits at most CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS in all.
+ *
+ * A rate limiter on the message id may refuse the message with -EAGAIN,
+ * or hold it and return 0, see @ref Service_Rate. Requests and credited
+ * messages have a single receiver, an id with MSG_ID_FLAG_REQUEST or
+ * MSG_ID_FLAG_CREDIT is refused with -EINVAL.
+ *
+ * @param   message Message structure to send.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Control
+ */
+int32_t service_broadcast_message(const message_t* message)
+{
+#if CONFIG_SERVICE_ROUTES_ENABLE
+    service_t* const* route;
+#else
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+
+    const service_t* start = module_service$$Base;
+    const service_t* end = module_service$$Limit;
+#endif
+    const service_t* svc;
+    const service_t* dst;
+    osStatus_t stat;
+    uint32_t timeout;
+    uint32_t begin;
+    uint32_t n;
+    int32_t ret;
+#if SERVICE_SEND_COPY
+    message_t copy;
+#endif
+
+    if (!message || (message->id & MSG_ID_FLAGS_UNICAST))
+    {
+        return -EINVAL;
+    }
+
+#if CONFIG_SERVICE_ISR_RING_ENABLE
+    /* Keep the interrupt O(1), the dispatcher thread does the fan-out. */
+    if (xPortIsInsideInterrupt())
+    {
+        return service_broadcast_message_isr(message);
+    }
+#endif
+
+    timeout = service_get_send_timeout();
+
+#if SERVICE_SEND_COPY
+    copy = *message;
+    message = &copy;
+#endif
+
+    svc = NULL;
+    switch (INTERCEPTOR_RUN(INTERCEPT_POINT_BROADCAST, &svc, &copy))
+    {
+    case INTERCEPT_DROP:
+        service_message_discard(message);
+        return 0;
+    case INTERCEPT_REDIRECT:
+        return service_unicast_message(svc, message);
+    default:
+        break;
+    }
+
+    /* Over the rate, the message is refused or held by the limiter. */
+    ret = SERVICE_RATE_CHECK(NULL, message, timeout);
+    if (ret)
+    {
+        return ret < 0 ? ret : 0;
+    }
+
+#if CONFIG_MSG_LAYOUT_ALIGNED
+    service_message_stamp(&copy);
+#endif
 
-    svc->owner = obj;
+    /* One timeout for the whole fan-out, not one per full queue. */
+    begin = osKernelGetTickCount();
 
-    if (intf->init)
+#if CONFIG_SERVICE_ROUTES_ENABLE
+    for (route = service_routes_lookup(message->id); (svc = *route); route++)
+#else
+    for (svc = start; svc < end; svc++)
+#endif
     {
-        ret = intf->init(obj, config);
-        if (ret)
+        /* One destination, or the replicas of a replicated service. */
+        for (n = 0; (dst = SERVICE_REPLICA_FANOUT(svc, message, n)); n++)
         {
-            return ret;
+            stat = service_queue_put(dst, message, service_send_remaining(begin, timeout));
+            if (stat != osOK)
+            {
+                pr_error("Broadcast %s(0x%x) to <%s> failed, stat %d.",
+                         msg_id_to_str(message->id),
+                         message->id,
+                         dst->owner ? dst->owner->name : "",
+                         stat);
+
+                /* A full queue does not starve the services after it. */
+                ret = -EPIPE;
+            }
         }
     }
 
-    pr_info("Object <%s> probe succeed.", obj->name);
+    if (ret)
+    {
+        return ret;
+    }
+
+    pr_info("Broadcast %s(0x%x) succeed, 0x%x, 0x%x, 0x%x, 0x%x.",
+            msg_id_to_str(message->id),
+            message->id,
+            message->param0,
+            message->param1,
+            message->param2,
+            message->param3);
 
     return 0;
 }
 
 /**
- * @brief   Remove the service object.
+ * @brief   Unicast event messages to a specified service, waiting up to a timeout.
  *
- * @param   obj Pointer to the service object handle.
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
+ * @param   timeout Timeout in ticks to wait for room in the queue.
  *
  * @retval  Returns 0 on success, negative error code otherwise.
  */
-int32_t service_shutdown(const object* obj)
+static int32_t service_unicast_timeout(const service_t* svc,
+                                       const message_t* message,
+                                       uint32_t         timeout)
 {
-    service_intf_t* intf = (service_intf_t*)obj->object_intf;
+    osStatus_t stat;
     int32_t ret;
+#if SERVICE_SEND_COPY
+    message_t copy;
+#endif
 
-    if (intf->deinit)
+    if (!svc)
     {
-        ret = intf->deinit(obj);
-        if (ret)
+        return -EINVAL;
+    }
+
+    if (!message)
+    {
+        return -EINVAL;
+    }
+
+#if SERVICE_SEND_COPY
+    copy = *message;
+    message = &copy;
+#endif
+
+    switch (INTERCEPTOR_RUN(INTERCEPT_POINT_UNICAST, &svc, &copy))
+    {
+    case INTERCEPT_DROP:
+        service_message_discard(message);
+        return 0;
+    case INTERCEPT_REDIRECT:
+        /* Failed like a bad destination, the caller releases what the message holds. */
+        if (!svc)
         {
-            return ret;
+            return -EINVAL;
         }
+        break;
+    default:
+        break;
     }
 
-    pr_info("Object <%s> shutdown succeed.", obj->name);
+    /* Refused like on a full queue, the caller releases what the message holds. */
+    ret = SERVICE_RATE_CHECK(svc, message, timeout);
+    if (ret)
+    {
+        return ret < 0 ? ret : 0;
+    }
+
+    /* Same key, same replica, the messages of a key stay in order. */
+    svc = SERVICE_REPLICA_SELECT(svc, message);
+
+#if CONFIG_MSG_LAYOUT_ALIGNED
+    service_message_stamp(&copy);
+#endif
+
+    stat = service_queue_put(svc, message, timeout);
+    if (stat != osOK)
+    {
+        pr_error("Unicast %s(0x%x) failed, stat %d.",
+                 msg_id_to_str(message->id),
+                 message->id,
+                 stat);
+
+        return -EPIPE;
+    }
+
+    SERVICE_AFFINITY_COUNT(svc);
+
+    pr_info("Unicast %s(0x%x) succeed, 0x%x, 0x%x, 0x%x, 0x%x.",
+            msg_id_to_str(message->id),
+            message->id,
+            message->param0,
+            message->param1,
+            message->param2,
+            message->param3);
 
     return 0;
 }
 
 /**
- * @brief   Get the thread ID for service.
+ * @brief   Unicast event messages to a specified service.
  *
- * @param   obj Pointer to the service object handle.
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
  *
- * @retval  Returns the thread ID.
+ * @retval  Returns 0 on success, negative error code otherwise.
  *
- * @ingroup Service_Property
+ * @ingroup Service_Control
  */
-osThreadId_t service_get_thread_id(const object* obj)
+int32_t service_unicast_message(const service_t* svc, const message_t* message)
 {
-    service_t* svc = (service_t*)obj->object_data;
-
-    return svc->thread_id;
+    return service_unicast_timeout(svc, message, service_get_send_timeout());
 }
 
 /**
- * @brief   Get the queue ID for service.
+ * @brief   Unicast event messages to a specified service without blocking.
  *
- * @param   obj Pointer to the service object handle.
+ * For senders that must not wait on a full queue, e.g. monitors
+ * reporting on the services.
  *
- * @retval  Returns the queue ID.
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
  *
- * @ingroup Service_Property
+ * @retval  Returns 0 on success, -EPIPE if the queue is full, negative error code otherwise.
+ *
+ * @ingroup Service_Control
  */
-osMessageQueueId_t service_get_queue_id(const object* obj)
+int32_t service_post_message(const service_t* svc, const message_t* message)
 {
-    service_t* svc = (service_t*)obj->object_data;
-
-    return svc->queue_id;
+    return service_unicast_timeout(svc, message, 0);
 }
 
+#if CONFIG_PAYLOAD_POOL_ENABLE
 /**
- * @brief   Get the private data for service.
+ * @brief   Unicast a message with an attached payload to a specified service.
  *
- * @param   obj Pointer to the service object handle.
+ * The payload handle is carried in param3. The caller's reference is
+ * consumed whether the send succeeds or not, the receiving service
+ * drops its own reference after the message handler returns.
  *
- * @retval  Returns the private data.
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send, param3 is overwritten.
+ * @param   payload Payload allocated by payload_alloc().
  *
- * @ingroup Service_Property
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Control
  */
-void* service_get_priv_data(const object* obj)
+int32_t service_unicast_payload(const service_t*    svc,
+                                const message_t*    message,
+                                void*               payload)
 {
-    service_t* svc = (service_t*)obj->object_data;
+    message_t msg;
+    int32_t ret;
 
-    return svc->priv;
-}
+    if (!message || !payload_to_handle(payload))
+    {
+        payload_release(payload);
+        return -EINVAL;
+    }
 
-/**
- * @brief   Get the service handle.
- *
- * @param   obj Pointer to the service object handle.
- *
- * @retval  Returns the service handle.
- *
- * @ingroup Service_Property
- */
-service_t* service_get_svc(const object* obj)
-{
-    service_t* svc = (service_t*)obj->object_data;
+    msg = *message;
+    msg.id |= MSG_ID_FLAG_PAYLOAD;
+    msg.param3 = payload_to_handle(payload);
 
-    return svc;
+    ret = service_unicast_message(svc, &msg);
+    if (ret)
+    {
+        payload_release(payload);
+    }
+
+    return ret;
 }
 
 /**
- * @brief   Broadcast event messages to all services.
+ * @brief   Broadcast a message with an attached payload to all services.
  *
- * @param   message Message structure to send.
+ * Every service that receives the message holds one reference, the
+ * payload returns to its pool when the last message handler is done.
+ * The caller's reference is consumed whether the send succeeds or not.
+ * Like service_broadcast_message(), the services share one send timeout.
+ *
+ * @param   message Message structure to send, param3 is overwritten.
+ * @param   payload Payload allocated by payload_alloc().
  *
  * @retval  Returns 0 on success, negative error code otherwise.
  *
  * @ingroup Service_Control
  */
-int32_t service_broadcast_message(const message_t* message)
+int32_t service_broadcast_payload(const message_t* message, void* payload)
 {
+#if CONFIG_SERVICE_ROUTES_ENABLE
+    service_t* const* route;
+#else
     extern service_t module_service$$Base[];
     extern service_t module_service$$Limit[];
 
     const service_t* start = module_service$$Base;
     const service_t* end = module_service$$Limit;
+#endif
     const service_t* svc;
+    const service_t* dst;
+    message_t msg;
     osStatus_t stat;
     uint32_t timeout;
-    BaseType_t is_irq = xPortIsInsideInterrupt();
+    uint32_t begin;
+    uint32_t n;
+    int32_t ret = 0;
 
-    if (!message)
+    if (!message || (message->id & MSG_ID_FLAGS_UNICAST) || !payload_to_handle(payload))
     {
+        payload_release(payload);
         return -EINVAL;
     }
 
-    if (is_irq)
+    msg = *message;
+    msg.id |= MSG_ID_FLAG_PAYLOAD;
+    msg.param3 = payload_to_handle(payload);
+
+    timeout = service_get_send_timeout();
+
+    svc = NULL;
+    switch (INTERCEPTOR_RUN(INTERCEPT_POINT_BROADCAST, &svc, &msg))
     {
-        timeout = 0;
+    case INTERCEPT_DROP:
+        /* Releases the caller's reference, like any discarded payload message. */
+        service_message_discard(&msg);
+        return 0;
+    case INTERCEPT_REDIRECT:
+        /* The unicast path takes over the caller's reference. */
+        ret = service_unicast_message(svc, &msg);
+        if (ret)
+        {
+            payload_release(payload);
+        }
+        return ret;
+    default:
+        break;
     }
-    else
+
+    /* Never held, the message carries a payload. */
+    ret = SERVICE_RATE_CHECK(NULL, &msg, timeout);
+    if (ret)
     {
-        timeout = CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS * osKernelGetTickFreq() /
-                  1000;
+        payload_release(payload);
+        return ret;
     }
 
+#if CONFIG_MSG_LAYOUT_ALIGNED
+    service_message_stamp(&msg);
+#endif
+
+    begin = osKernelGetTickCount();
+
+#if CONFIG_SERVICE_ROUTES_ENABLE
+    for (route = service_routes_lookup(msg.id); (svc = *route); route++)
+#else
     for (svc = start; svc < end; svc++)
+#endif
     {
-        if (svc)
+        for (n = 0; (dst = SERVICE_REPLICA_FANOUT(svc, &msg, n)); n++)
         {
-            stat = osMessageQueuePut(svc->queue_id, message, 0, timeout);
+            payload_ref(payload);
+
+            stat = service_queue_put(dst, &msg, service_send_remaining(begin, timeout));
             if (stat != osOK)
             {
-                pr_error("Broadcast %s(0x%x) failed, stat %d.",
-                         msg_id_to_str(message->id),
+                payload_release(payload);
+
+                pr_error("Broadcast %s(0x%x) to <%s> failed, stat %d.",
+                         msg_id_to_str(msg.id),
                          message->id,
+                         dst->owner ? dst->owner->name : "",
                          stat);
 
-                return -EPIPE;
+                ret = -EPIPE;
             }
         }
     }
 
-    pr_info("Broadcast %s(0x%x) succeed, 0x%x, 0x%x, 0x%x, 0x%x.",
-            msg_id_to_str(message->id),
+    payload_release(payload);
+
+    pr_info("Broadcast %s(0x%x) with payload %p, 0x%x, 0x%x, 0x%x.",
+            msg_id_to_str(msg.id),
             message->id,
-            message->param0,
-            message->param1,
-            message->param2,
-            message->param3);
+            payload,
+            msg.param0,
+            msg.param1,
+            msg.param2);
 
-    return 0;
+    return ret;
 }
+#endif
 
+#if CONFIG_SERVICE_GROUP_ENABLE
 /**
- * @brief   Unicast event messages to a specified service.
+ * @brief   Multicast event messages to the members of a group.
  *
- * @param   svc Pointer to the service handle.
+ * The message is offered to every member in one pass, a full queue does
+ * not stop the others. The members share one send timeout, a blocked
+ * send waits at most CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS for the whole
+ * group, the members still full past it are reported in failed. One
+ * line is logged for the whole group. Like a broadcast, an id with
+ * MSG_ID_FLAG_REQUEST, MSG_ID_FLAG_CREDIT or MSG_ID_FLAG_STREAM is
+ * refused with -EINVAL, and a message dropped by an interceptor is
+ * discarded.
+ *
+ * @param   group Pointer to the group, see DECLARE_SERVICE_GROUP().
  * @param   message Message structure to send.
+ * @param   failed Receives the mask of the members not reached, bit i for member i, may be NULL.
  *
- * @retval  Returns 0 on success, negative error code otherwise.
+ * @retval  Returns 0 if every member got the message, -EPIPE if some did not, negative error code otherwise.
  *
  * @ingroup Service_Control
  */
-int32_t service_unicast_message(const service_t* svc, const message_t* message)
+int32_t service_multicast_message(const service_group_t* group,
+                                  const message_t* message,
+                                  uint32_t* failed)
 {
+    const service_t* svc;
+    const service_t* dst;
     osStatus_t stat;
     uint32_t timeout;
-    BaseType_t is_irq = xPortIsInsideInterrupt();
+    uint32_t begin;
+    uint32_t mask = 0;
+    uint32_t i, n;
+    int32_t ret;
+#if SERVICE_SEND_COPY
+    message_t copy;
+#endif
 
-    if (!svc)
+    if (failed)
     {
-        return -EINVAL;
+        *failed = 0;
     }
 
-    if (!message)
+    if (!group || !message || !group->svcs[0] || (message->id & MSG_ID_FLAGS_UNICAST))
     {
         return -EINVAL;
     }
 
-    if (is_irq)
+    timeout = service_get_send_timeout();
+
+#if SERVICE_SEND_COPY
+    copy = *message;
+    message = &copy;
+#endif
+
+    /* Seen by the interceptors like a broadcast to the group. */
+    svc = NULL;
+    switch (INTERCEPTOR_RUN(INTERCEPT_POINT_BROADCAST, &svc, &copy))
     {
-        timeout = 0;
+    case INTERCEPT_DROP:
+        service_message_discard(message);
+        return 0;
+    case INTERCEPT_REDIRECT:
+        return service_unicast_message(svc, message);
+    default:
+        break;
     }
-    else
+
+    ret = SERVICE_RATE_CHECK(NULL, message, timeout);
+    if (ret)
     {
-        timeout = CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS * osKernelGetTickFreq() /
-                  1000;
+        return ret < 0 ? ret : 0;
     }
 
-    stat = osMessageQueuePut(svc->queue_id, message, 0, timeout);
-    if (stat != osOK)
+#if CONFIG_MSG_LAYOUT_ALIGNED
+    service_message_stamp(&copy);
+#endif
+
+    /* One timeout for the whole group, not one per full member queue. */
+    begin = osKernelGetTickCount();
+
+    for (i = 0; i < group->count; i++)
     {
-        pr_error("Unicast %s(0x%x) failed, stat %d.",
+        svc = group->svcs[i];
+
+        for (n = 0; (dst = SERVICE_REPLICA_FANOUT(svc, message, n)); n++)
+        {
+            stat = service_queue_put(dst, message, service_send_remaining(begin, timeout));
+            if (stat != osOK)
+            {
+                mask |= 1u << i;
+            }
+        }
+    }
+
+    if (failed)
+    {
+        *failed = mask;
+    }
+
+    if (mask)
+    {
+        pr_error("Multicast %s(0x%x) to <%s> failed, members 0x%x of %u missed.",
                  msg_id_to_str(message->id),
                  message->id,
-                 stat);
+                 group->name,
+                 mask,
+                 group->count);
 
         return -EPIPE;
     }
 
-    pr_info("Unicast %s(0x%x) succeed, 0x%x, 0x%x, 0x%x, 0x%x.",
+    pr_info("Multicast %s(0x%x) to <%s> succeed, 0x%x, 0x%x, 0x%x, 0x%x.",
             msg_id_to_str(message->id),
             message->id,
+            group->name,
             message->param0,
             message->param1,
             message->param2,
@@ -444,3 +1785,113 @@ int32_t service_unicast_message(const service_t* svc, const message_t* message)
 
     return 0;
 }
+#endif
+
+/**
+ * @brief   Raise a signal on a specified service.
+ *
+ * Signals are parameterless messages declared in the message signal
+ * table. They set a thread flag instead of taking a queue slot, so they
+ * never fail on a full queue and are cheap to raise from interrupts.
+ * Repeated raises before delivery coalesce into one message. Message
+ * ids that are not signals fall back to service_unicast_message().
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   id Message id.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Control
+ */
+int32_t service_unicast_signal(const service_t* svc, uint32_t id)
+{
+    message_t message;
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+    int32_t bit = msg_id_to_signal(id);
+    uint32_t flags;
+
+    if (!svc)
+    {
+        return -EINVAL;
+    }
+
+    /* Thread flags cannot reach a service behind a transport. */
+    if (bit >= 0 && !SERVICE_TRANSPORT(svc))
+    {
+        flags = osThreadFlagsSet(svc->thread_id, 1u << bit);
+        if (flags & osFlagsError)
+        {
+            pr_error("Signal %s(0x%x) failed, flags 0x%x.",
+                     msg_id_to_str(id),
+                     id,
+                     flags);
+
+            return -EPIPE;
+        }
+
+        return 0;
+    }
+#endif
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = id;
+
+    return service_unicast_message(svc, &message);
+}
+
+/**
+ * @brief   Raise a signal on all services.
+ *
+ * Message ids that are not signals fall back to service_broadcast_message().
+ * Signals are coalesced and delivered in signal table order, see
+ * msg_id_to_signal(), so only order independent events are signals.
+ *
+ * @param   id Message id.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Control
+ */
+int32_t service_broadcast_signal(uint32_t id)
+{
+    message_t message;
+#if CONFIG_SERVICE_SIGNAL_ENABLE
+#if CONFIG_SERVICE_ROUTES_ENABLE
+    service_t* const* route;
+#else
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+#endif
+
+    const service_t* svc;
+    const service_t* dst;
+    int32_t bit = msg_id_to_signal(id);
+    int32_t ret = 0;
+    uint32_t n;
+
+    if (bit >= 0)
+    {
+#if CONFIG_SERVICE_ROUTES_ENABLE
+        for (route = service_routes_lookup(id); (svc = *route); route++)
+#else
+        for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+#endif
+        {
+            for (n = 0; (dst = SERVICE_REPLICA_FANOUT(svc, NULL, n)); n++)
+            {
+                if (service_unicast_signal(dst, id))
+                {
+                    ret = -EPIPE;
+                }
+            }
+        }
+
+        return ret;
+    }
+#endif
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = id;
+
+    return service_broadcast_message(&message);
+}
@@ -0,0 +1,612 @@
+/**
+ * @file source/src/service_affinity.c
+ * @brief Definition the service core affinity and placement.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_affinity.h"
+
+#if CONFIG_SERVICE_AFFINITY_ENABLE
+
+/**
+ * @defgroup Service_Affinity Service Affinity
+ *
+ * @brief Pin service threads to cores and co-locate chatty services.
+ *
+ * Each service thread is pinned to the core mask of its configuration,
+ * every replica alike.
+ *
+ * With CONFIG_SERVICE_TRAFFIC_ENABLE, unicasts between services are
+ * counted in a traffic matrix. The placement pass partitions the
+ * services over the cores so that the pairs exchanging the most
+ * messages share a core, with at most ceil(services / cores) services
+ * per core. A fixed affinity in the service configuration is always
+ * honored.
+ *
+ * The pass runs when the core objects are probed, before the service
+ * threads exist, using the DECLARE_SERVICE_TRAFFIC() profile of an
+ * earlier run. The profile names services, the count of an entry is
+ * spread over the replicas. service_affinity_rebalance() runs the pass
+ * again on the live counts and moves the threads.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Apply the core mask of a service to its thread.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @ingroup Service_Affinity
+ */
+void service_affinity_apply(const service_t* svc)
+{
+    if (!svc->thread_id || !svc->affinity)
+    {
+        return;
+    }
+
+    vTaskCoreAffinitySet((TaskHandle_t)svc->thread_id, svc->affinity);
+}
+
+#if CONFIG_SERVICE_TRAFFIC_ENABLE
+#ifndef DOC_HIDDEN
+#define SERVICE_CORE_MASK_ALL ((1u << CONFIG_SERVICE_CORE_NUM) - 1)
+
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Unicast counts, indexed by sender and receiver service.
+ */
+static uint32_t service_traffic[CONFIG_SERVICE_TRAFFIC_MAX][CONFIG_SERVICE_TRAFFIC_MAX];
+
+/**
+ * @brief   Symmetric pair weights used by the placement pass.
+ */
+static uint32_t service_weight[CONFIG_SERVICE_TRAFFIC_MAX][CONFIG_SERVICE_TRAFFIC_MAX];
+
+/**
+ * @brief   Service objects, indexed like the module_service section.
+ */
+static const object* service_affinity_objs[CONFIG_SERVICE_TRAFFIC_MAX];
+
+/**
+ * @brief   Number of services taking part in the placement.
+ */
+static uint32_t service_affinity_num;
+
+/**
+ * @brief   Get the traffic matrix index of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the index, or -1 if the service is not tracked.
+ */
+static int32_t service_affinity_index(const service_t* svc)
+{
+    if (svc < module_service$$Base || svc >= module_service$$Limit)
+    {
+        return -1;
+    }
+
+    if ((uint32_t)(svc - module_service$$Base) >= service_affinity_num)
+    {
+        return -1;
+    }
+
+    return (int32_t)(svc - module_service$$Base);
+}
+
+/**
+ * @brief   Get the cores a service may run on.
+ *
+ * @param   i Service index.
+ *
+ * @retval  Returns the core mask, never 0.
+ */
+static uint32_t service_affinity_allowed(uint32_t i)
+{
+    const service_config_t* config;
+    uint32_t mask;
+
+    if (!service_affinity_objs[i])
+    {
+        return SERVICE_CORE_MASK_ALL;
+    }
+
+    config = (const service_config_t*)service_affinity_objs[i]->object_config;
+    mask = config->affinity & SERVICE_CORE_MASK_ALL;
+
+    return mask ? mask : SERVICE_CORE_MASK_ALL;
+}
+
+/**
+ * @brief   Pick the least loaded core among the allowed ones.
+ *
+ * @param   allowed Allowed core mask.
+ * @param   load Number of services per core.
+ *
+ * @retval  Returns the core number.
+ */
+static int32_t service_affinity_least_loaded(uint32_t allowed, const uint32_t* load)
+{
+    int32_t best = -1;
+    int32_t c;
+
+    for (c = 0; c < CONFIG_SERVICE_CORE_NUM; c++)
+    {
+        if ((allowed & (1u << c)) && (best < 0 || load[c] < load[best]))
+        {
+            best = c;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief   Partition the services over the cores by the pair weights.
+ *
+ * Pinned services are placed first. Then, heaviest pair first, a service
+ * joins the core of its partner while that core has room. A final pass
+ * moves single services to the core they talk to most.
+ *
+ * @param   core Output of the core of each service.
+ */
+static void service_affinity_partition(int32_t* core)
+{
+    uint32_t load[CONFIG_SERVICE_CORE_NUM] = {0};
+    uint32_t capacity;
+    uint32_t allowed;
+    uint32_t best;
+    uint32_t bi, bj;
+    uint32_t i, j;
+    int32_t gain[CONFIG_SERVICE_CORE_NUM];
+    int32_t c;
+    uint32_t moved;
+
+    capacity = (service_affinity_num + CONFIG_SERVICE_CORE_NUM - 1) /
+               CONFIG_SERVICE_CORE_NUM;
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        allowed = service_affinity_allowed(i);
+
+        core[i] = -1;
+        if (!(allowed & (allowed - 1)))
+        {
+            core[i] = __builtin_ctz(allowed);
+            load[core[i]]++;
+        }
+    }
+
+    while (1)
+    {
+        best = 0;
+        bi = bj = 0;
+
+        for (i = 0; i < service_affinity_num; i++)
+        {
+            for (j = i + 1; j < service_affinity_num; j++)
+            {
+                if ((core[i] < 0 || core[j] < 0) && service_weight[i][j] > best)
+                {
+                    best = service_weight[i][j];
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+
+        if (!best)
+        {
+            break;
+        }
+
+        if (core[bi] < 0 && core[bj] < 0)
+        {
+            allowed = service_affinity_allowed(bi) & service_affinity_allowed(bj);
+            c = service_affinity_least_loaded(allowed, load);
+            if (c >= 0 && load[c] + 2 <= capacity)
+            {
+                core[bi] = core[bj] = c;
+                load[c] += 2;
+                continue;
+            }
+
+            c = service_affinity_least_loaded(service_affinity_allowed(bi), load);
+            core[bi] = c;
+            load[c]++;
+        }
+
+        if (core[bi] < 0)
+        {
+            i = bi;
+            bi = bj;
+            bj = i;
+        }
+
+        c = core[bi];
+        if (!((service_affinity_allowed(bj) & (1u << c)) && load[c] < capacity))
+        {
+            c = service_affinity_least_loaded(service_affinity_allowed(bj), load);
+        }
+
+        core[bj] = c;
+        load[c]++;
+    }
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        if (core[i] < 0)
+        {
+            core[i] = service_affinity_least_loaded(service_affinity_allowed(i), load);
+            load[core[i]]++;
+        }
+    }
+
+    do
+    {
+        moved = 0;
+
+        for (i = 0; i < service_affinity_num; i++)
+        {
+            allowed = service_affinity_allowed(i);
+            if (!(allowed & (allowed - 1)))
+            {
+                continue;
+            }
+
+            (void)memset(gain, 0, sizeof(gain));
+            for (j = 0; j < service_affinity_num; j++)
+            {
+                if (j != i)
+                {
+                    gain[core[j]] += (int32_t)service_weight[i][j];
+                }
+            }
+
+            for (c = 0; c < CONFIG_SERVICE_CORE_NUM; c++)
+            {
+                if ((allowed & (1u << c)) && load[c] < capacity &&
+                    gain[c] > gain[core[i]])
+                {
+                    load[core[i]]--;
+                    core[i] = c;
+                    load[c]++;
+                    moved++;
+                }
+            }
+        }
+    } while (moved);
+}
+
+/**
+ * @brief   Place the services and store the core masks in the service handles.
+ */
+static void service_affinity_place(void)
+{
+    int32_t core[CONFIG_SERVICE_TRAFFIC_MAX];
+    uint32_t i;
+
+    service_affinity_partition(core);
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        if (service_affinity_objs[i])
+        {
+            module_service$$Base[i].affinity = 1u << core[i];
+        }
+    }
+}
+
+/**
+ * @brief   Load the pair weights from the traffic profile.
+ */
+static void service_affinity_load_profile(void)
+{
+    extern service_traffic_t module_traffic$$Base[];
+    extern service_traffic_t module_traffic$$Limit[];
+
+    const service_traffic_t* entry;
+    const object* from;
+    const object* to;
+    const service_t* src;
+    const service_t* dst;
+    uint32_t weight;
+    uint32_t a, b;
+    int32_t i, j;
+
+    (void)memset(service_weight, 0, sizeof(service_weight));
+
+    for (entry = module_traffic$$Base; entry < module_traffic$$Limit; entry++)
+    {
+        from = object_get_binding(entry->from);
+        to = object_get_binding(entry->to);
+        if (!from || !to)
+        {
+            continue;
+        }
+
+        src = service_get_svc(from);
+        dst = service_get_svc(to);
+
+        /* Every replica pair gets its share, so every replica is placed by the profile. */
+        weight = entry->count / (SERVICE_REPLICA_COUNT(src) * SERVICE_REPLICA_COUNT(dst));
+        weight += !weight;
+
+        for (a = 0; a < SERVICE_REPLICA_COUNT(src); a++)
+        {
+            for (b = 0; b < SERVICE_REPLICA_COUNT(dst); b++)
+            {
+                i = service_affinity_index(&src[a]);
+                j = service_affinity_index(&dst[b]);
+                if (i < 0 || j < 0 || i == j)
+                {
+                    continue;
+                }
+
+                service_weight[i][j] += weight;
+                service_weight[j][i] += weight;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Collect the services and run the placement on the profile.
+ *
+ * @param   obj Pointer to the affinity object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_affinity_probe(const object* obj)
+{
+    extern object module_object_3$$Base[];
+    extern object module_object_3$$Limit[];
+
+    const object* entry;
+    const service_t* svc;
+    uint32_t num = module_service$$Limit - module_service$$Base;
+    uint32_t count;
+    uint32_t i;
+
+    if (num > CONFIG_SERVICE_TRAFFIC_MAX)
+    {
+        pr_error("Services %d exceed the traffic limit %d.",
+                 num,
+                 CONFIG_SERVICE_TRAFFIC_MAX);
+        return -ENOMEM;
+    }
+
+    service_affinity_num = num;
+
+    for (entry = module_object_3$$Base; entry < module_object_3$$Limit; entry++)
+    {
+        if (entry->probe != service_probe)
+        {
+            continue;
+        }
+
+        /* Every replica is a thread of its own to place. */
+        svc = (const service_t*)entry->object_data;
+        count = SERVICE_REPLICA_COUNT(svc);
+        for (i = 0; i < count; i++)
+        {
+            if (&svc[i] >= module_service$$Base && &svc[i] < module_service$$Limit)
+            {
+                service_affinity_objs[&svc[i] - module_service$$Base] = entry;
+            }
+        }
+    }
+
+    service_affinity_load_profile();
+    service_affinity_place();
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        if (service_affinity_objs[i])
+        {
+            pr_info("Service <%s> replica %u placed on core mask 0x%x.",
+                    service_affinity_objs[i]->name,
+                    (uint32_t)(&module_service$$Base[i] -
+                               (const service_t*)service_affinity_objs[i]->object_data),
+                    module_service$$Base[i].affinity);
+        }
+    }
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Count a unicast between two services.
+ *
+ * Sends from interrupts or from threads that are not services are ignored.
+ *
+ * @param   from Pointer to the sending service, may be NULL.
+ * @param   to Pointer to the receiving service.
+ *
+ * @ingroup Service_Affinity
+ */
+void service_affinity_count(const service_t* from, const service_t* to)
+{
+    int32_t i = service_affinity_index(from);
+    int32_t j = service_affinity_index(to);
+
+    if (i < 0 || j < 0)
+    {
+        return;
+    }
+
+    (void)__atomic_add_fetch(&service_traffic[i][j], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Place the services again on the live traffic and move the threads.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Affinity
+ */
+int32_t service_affinity_rebalance(void)
+{
+    uint32_t i, j;
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        for (j = 0; j < service_affinity_num; j++)
+        {
+            service_weight[i][j] =
+                __atomic_load_n(&service_traffic[i][j], __ATOMIC_RELAXED) +
+                __atomic_load_n(&service_traffic[j][i], __ATOMIC_RELAXED);
+        }
+    }
+
+    service_affinity_place();
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        service_affinity_apply(&module_service$$Base[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Dump the measured traffic and the part that crosses cores.
+ *
+ * Pairs where either service may run on several cores are reported as
+ * floating.
+ *
+ * @ingroup Service_Affinity
+ */
+void service_affinity_dump(void)
+{
+    const service_t* from;
+    const service_t* to;
+    const char* where;
+    uint32_t total = 0;
+    uint32_t cross = 0;
+    uint32_t floating = 0;
+    uint32_t count;
+    uint32_t i, j;
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        for (j = 0; j < service_affinity_num; j++)
+        {
+            count = __atomic_load_n(&service_traffic[i][j], __ATOMIC_RELAXED);
+            if (!count)
+            {
+                continue;
+            }
+
+            from = &module_service$$Base[i];
+            to = &module_service$$Base[j];
+
+            if (!from->affinity || !to->affinity ||
+                (from->affinity & (from->affinity - 1)) ||
+                (to->affinity & (to->affinity - 1)))
+            {
+                where = "floating";
+                floating += count;
+            }
+            else if (from->affinity != to->affinity)
+            {
+                where = "cross core";
+                cross += count;
+            }
+            else
+            {
+                where = "same core";
+            }
+
+            total += count;
+
+            pr_info("Traffic <%s>(0x%x) -> <%s>(0x%x) %u, %s.",
+                    service_affinity_objs[i] ? service_affinity_objs[i]->name : "",
+                    from->affinity,
+                    service_affinity_objs[j] ? service_affinity_objs[j]->name : "",
+                    to->affinity,
+                    count,
+                    where);
+        }
+    }
+
+    pr_info("Traffic total %u, cross core %u (%u%%), floating %u.",
+            total,
+            cross,
+            total ? (uint32_t)((uint64_t)cross * 100 / total) : 0,
+            floating);
+}
+
+/**
+ * @brief   Dump the measured traffic as a placement profile.
+ *
+ * The output can be saved as a source file for the next build, one
+ * DECLARE_SERVICE_TRAFFIC() per service pair.
+ *
+ * @ingroup Service_Affinity
+ */
+void service_affinity_dump_profile(void)
+{
+    uint32_t count;
+    uint32_t label = 0;
+    uint32_t i, j;
+
+    dbg_cli_output("/* Generated by service_affinity_dump_profile(). */\r\n");
+
+    for (i = 0; i < service_affinity_num; i++)
+    {
+        for (j = 0; j < service_affinity_num; j++)
+        {
+            count = __atomic_load_n(&service_traffic[i][j], __ATOMIC_RELAXED);
+            if (!count || !service_affinity_objs[i] || !service_affinity_objs[j])
+            {
+                continue;
+            }
+
+            dbg_cli_output("DECLARE_SERVICE_TRAFFIC(t%u, \"%s\", \"%s\", %u);\r\n",
+                           label++,
+                           service_affinity_objs[i]->name,
+                           service_affinity_objs[j]->name,
+                           count);
+        }
+    }
+}
+
+module_core("affinity",
+            affinity,
+            service_affinity_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_TRAFFIC_ENABLE */
+
+#endif /* CONFIG_SERVICE_AFFINITY_ENABLE */
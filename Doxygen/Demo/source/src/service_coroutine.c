@@ -0,0 +1,274 @@
+/**
+ * @file source/src/service_coroutine.c
+ * @brief Definition the stackless coroutines of the message handlers.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_coroutine.h"
+
+#if CONFIG_SERVICE_CO_ENABLE
+
+/**
+ * @defgroup Service_Coroutine Service Coroutine
+ *
+ * @brief Long operations in a message handler without blocking the service.
+ *
+ * A coroutine is a body function written as straight line code between
+ * SERVICE_CO_BEGIN() and SERVICE_CO_END(). At an await it returns to the
+ * message handler, and the service thread goes on with the next queued
+ * messages. The continuation is a service_co_t, typically in the service
+ * private data, so no thread or stack is added.
+ *
+ * @code
+ *  static int32_t flash_update(service_co_t* co, void* arg)
+ *  {
+ *      SERVICE_CO_BEGIN(co);
+ *      ...start the erase...
+ *      SERVICE_CO_AWAIT_MESSAGE(co, MSG_ID_FLASH_DONE, 100);
+ *      if (SERVICE_CO_TIMEDOUT(co))
+ *      {
+ *          ...
+ *      }
+ *      SERVICE_CO_END(co);
+ *  }
+ *
+ *  static void demo_message_handler(const object* obj, const message_t* const message)
+ *  {
+ *      demo_priv_t* priv = service_get_priv_data(obj);
+ *
+ *      if (service_co_feed(&priv->co, message))
+ *      {
+ *          return;
+ *      }
+ *
+ *      ...handle the message, service_co_start(&priv->co, flash_update, priv)...
+ *  }
+ * @endcode
+ *
+ * The handler feeds every message to its coroutines. An awaited message
+ * resumes the coroutine and is consumed, any other message goes on to
+ * the handler. When an await times out the service thread wakes up on
+ * its own and delivers MSG_ID_SYS_CO_TIMEOUT, which the handler feeds
+ * like the others and otherwise ignores.
+ *
+ * As with any protothread, local variables of the body do not survive an
+ * await, keep them in the argument, and an await must not be placed
+ * inside a switch statement of the body. Coroutines run on the service
+ * thread, start and feed them from its message handler only.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Make the service thread wake up for the timeout of the coroutine.
+ *
+ * @param   co Pointer to the coroutine.
+ */
+static void service_co_arm(const service_co_t* co)
+{
+    service_t* svc = co->svc;
+
+    if (!co->fn || !co->deadline)
+    {
+        return;
+    }
+
+    /* Only the service thread touches wake, the earliest deadline wins. */
+    if (!svc->wake || (int32_t)(co->deadline - svc->wake) < 0)
+    {
+        svc->wake = co->deadline;
+    }
+}
+
+/**
+ * @brief   Run the body of a coroutine up to its next await.
+ *
+ * @param   co Pointer to the coroutine.
+ */
+static void service_co_resume(service_co_t* co)
+{
+    co->wait_id = 0;
+    co->deadline = 0;
+
+    if (co->fn(co, co->arg) == SERVICE_CO_DONE)
+    {
+        co->fn = NULL;
+        co->line = 0;
+        return;
+    }
+
+    service_co_arm(co);
+}
+
+/**
+ * @brief   Start a coroutine and run it up to its first await.
+ *
+ * @param   co Pointer to the coroutine.
+ * @param   fn Body of the coroutine.
+ * @param   arg Body argument.
+ *
+ * @retval  Returns 0 on success, -EBUSY if the coroutine is running,
+ *          -EPERM if not called from a service thread, negative error
+ *          code otherwise.
+ *
+ * @ingroup Service_Coroutine
+ */
+int32_t service_co_start(service_co_t* co, service_co_fn fn, void* arg)
+{
+    service_t* svc;
+
+    if (!co || !fn)
+    {
+        return -EINVAL;
+    }
+
+    if (co->fn)
+    {
+        return -EBUSY;
+    }
+
+    svc = service_get_current();
+    if (!svc)
+    {
+        return -EPERM;
+    }
+
+    (void)memset(co, 0, sizeof(*co));
+    co->fn = fn;
+    co->arg = arg;
+    co->svc = svc;
+
+    service_co_resume(co);
+
+    return 0;
+}
+
+/**
+ * @brief   Feed a message received by the service to a coroutine.
+ *
+ * @param   co Pointer to the coroutine.
+ * @param   message Message received by the message handler.
+ *
+ * @retval  Returns 1 if the coroutine consumed the message, 0 if the
+ *          handler goes on with it.
+ *
+ * @ingroup Service_Coroutine
+ */
+int32_t service_co_feed(service_co_t* co, const message_t* message)
+{
+    if (!co || !message || !co->fn)
+    {
+        return 0;
+    }
+
+    if (co->wait_id && co->wait_id != SERVICE_CO_ANY &&
+        co->wait_id == (message->id & ~MSG_ID_FLAGS_MASK))
+    {
+        co->status = 0;
+        co->message = *message;
+        service_co_resume(co);
+        return 1;
+    }
+
+    if (co->deadline &&
+        (int32_t)(osKernelGetTickCount() - co->deadline) >= 0)
+    {
+        co->status = -ETIMEOUT;
+        (void)memset(&co->message, 0, sizeof(co->message));
+        service_co_resume(co);
+        return 0;
+    }
+
+    if (co->wait_id == SERVICE_CO_ANY)
+    {
+        co->status = 0;
+        co->message = *message;
+        service_co_resume(co);
+        return 0;
+    }
+
+    /* The wake up is cleared when MSG_ID_SYS_CO_TIMEOUT is sent, keep ours. */
+    service_co_arm(co);
+
+    return 0;
+}
+
+/**
+ * @brief   Set what a coroutine waits for, used by the await macros.
+ *
+ * @param   co Pointer to the coroutine.
+ * @param   id Message id awaited, 0 for none, SERVICE_CO_ANY for any.
+ * @param   timeout_ms Timeout in ms, 0 for none, with id 0 the shortest one.
+ *
+ * @ingroup Service_Coroutine
+ */
+void service_co_await(service_co_t* co, uint32_t id, uint32_t timeout_ms)
+{
+    uint32_t ticks;
+
+    co->wait_id = id;
+    co->status = 0;
+    co->deadline = 0;
+
+    /* Awaiting nothing for ever never resumes, it yields for a tick. */
+    if (timeout_ms || !id)
+    {
+        ticks = (uint32_t)((uint64_t)timeout_ms * osKernelGetTickFreq() / 1000);
+        co->deadline = osKernelGetTickCount() + (ticks ? ticks : 1);
+        co->deadline += !co->deadline;
+    }
+}
+
+/**
+ * @brief   Stop a coroutine where it waits.
+ *
+ * @param   co Pointer to the coroutine.
+ *
+ * @ingroup Service_Coroutine
+ */
+void service_co_cancel(service_co_t* co)
+{
+    if (co)
+    {
+        co->fn = NULL;
+        co->line = 0;
+        co->wait_id = 0;
+        co->deadline = 0;
+    }
+}
+
+/**
+ * @brief   Check whether a coroutine is running.
+ *
+ * @param   co Pointer to the coroutine.
+ *
+ * @retval  Returns non-zero if started and not done.
+ *
+ * @ingroup Service_Coroutine
+ */
+int32_t service_co_running(const service_co_t* co)
+{
+    return co && co->fn;
+}
+
+#endif /* CONFIG_SERVICE_CO_ENABLE */
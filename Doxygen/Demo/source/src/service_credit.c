@@ -0,0 +1,332 @@
+/**
+ * @file source/src/service_credit.c
+ * @brief Definition the credit-based flow control between services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_credit.h"
+
+#if CONFIG_SERVICE_CREDIT_ENABLE
+
+/**
+ * @defgroup Service_Credit Service Credit
+ *
+ * @brief Throttle a producer before the consumer queue fills up.
+ *
+ * A credit channel holds a window of credits for one producer and one
+ * consumer. The producer takes a credit with service_credit_acquire()
+ * before it generates the work, then sends it with service_credit_send().
+ * The message carries the channel in its id, and the credit returns when
+ * the consumer thread is done with it, handled or dropped.
+ *
+ * With no credit left, the producer throttles upstream instead of
+ * blocking inside service_unicast_message(), for example by pausing its
+ * sampling. If the channel has a resume threshold, the consumer sends
+ * the resume message id to the producer once that many credits are back,
+ * so a producer can wait from its own message loop.
+ *
+ * A channel must not be deinitialized while its messages are in flight.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Channels, indexed by the channel carried in the message id.
+ */
+static service_credit_t* service_credit_channels[CONFIG_SERVICE_CREDIT_MAX];
+
+/**
+ * @brief   Initialize a credit channel.
+ *
+ * @param   channel Pointer to the channel.
+ * @param   producer Service notified on resume, may be NULL.
+ * @param   consumer Service receiving the messages, a local service.
+ * @param   config Channel configuration.
+ *
+ * @retval  Returns 0 on success, -ENOSPC if all channels are used,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_Credit
+ */
+int32_t service_credit_init(service_credit_t* channel,
+                            const service_t* producer,
+                            const service_t* consumer,
+                            const service_credit_config_t* config)
+{
+    service_credit_t* expected;
+    uint32_t i;
+
+    if (!channel || !consumer || !config || !config->window)
+    {
+        return -EINVAL;
+    }
+
+    /* The credit is returned by the dispatch of the consumer, in this process. */
+    if (consumer < module_service$$Base || consumer >= module_service$$Limit)
+    {
+        return -EINVAL;
+    }
+
+    (void)memset(channel, 0, sizeof(*channel));
+    channel->producer = producer;
+    channel->consumer = consumer;
+    channel->window = config->window;
+    channel->resume = config->resume > config->window ? config->window : config->resume;
+    channel->resume_id = config->resume_id;
+
+    channel->credits = osSemaphoreNew(config->window, config->window, NULL);
+    if (!channel->credits)
+    {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < CONFIG_SERVICE_CREDIT_MAX; i++)
+    {
+        expected = NULL;
+        channel->index = i;
+
+        if (__atomic_compare_exchange_n(&service_credit_channels[i], &expected, channel, 0,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        {
+            return 0;
+        }
+    }
+
+    (void)osSemaphoreDelete(channel->credits);
+    channel->credits = NULL;
+
+    return -ENOSPC;
+}
+
+/**
+ * @brief   Deinitialize a credit channel.
+ *
+ * @param   channel Pointer to the channel.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Credit
+ */
+int32_t service_credit_deinit(service_credit_t* channel)
+{
+    if (!channel || !channel->credits ||
+        channel->index >= CONFIG_SERVICE_CREDIT_MAX ||
+        service_credit_channels[channel->index] != channel)
+    {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&service_credit_channels[channel->index], NULL, __ATOMIC_RELEASE);
+
+    (void)osSemaphoreDelete(channel->credits);
+    channel->credits = NULL;
+
+    return 0;
+}
+
+/**
+ * @brief   Take one credit.
+ *
+ * @param   channel Pointer to the channel.
+ * @param   timeout Timeout in ticks, 0 to only try.
+ *
+ * @retval  Returns 0 on success, -EBUSY or -ETIMEOUT if no credit is
+ *          available, negative error code otherwise.
+ *
+ * @ingroup Service_Credit
+ */
+int32_t service_credit_acquire(service_credit_t* channel, uint32_t timeout)
+{
+    if (!channel || !channel->credits)
+    {
+        return -EINVAL;
+    }
+
+    if (osSemaphoreAcquire(channel->credits, timeout) == osOK)
+    {
+        return 0;
+    }
+
+    __atomic_store_n(&channel->waiting, 1, __ATOMIC_SEQ_CST);
+    (void)__atomic_add_fetch(&channel->stats.starved, 1, __ATOMIC_RELAXED);
+
+    /* All credits may have come back before the flag was set, nobody would resume us. */
+    if (osSemaphoreAcquire(channel->credits, 0) == osOK)
+    {
+        __atomic_store_n(&channel->waiting, 0, __ATOMIC_SEQ_CST);
+        return 0;
+    }
+
+    return timeout ? -ETIMEOUT : -EBUSY;
+}
+
+/**
+ * @brief   Get the number of credits available.
+ *
+ * @param   channel Pointer to the channel.
+ *
+ * @retval  Returns the credit count.
+ *
+ * @ingroup Service_Credit
+ */
+uint32_t service_credit_available(const service_credit_t* channel)
+{
+    if (!channel || !channel->credits)
+    {
+        return 0;
+    }
+
+    return osSemaphoreGetCount(channel->credits);
+}
+
+/**
+ * @brief   Send a message with a credit taken by service_credit_acquire().
+ *
+ * The credit returns to the channel on failure.
+ *
+ * @param   channel Pointer to the channel.
+ * @param   message Message structure to send, not a request.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Credit
+ */
+int32_t service_credit_send(service_credit_t* channel, const message_t* message)
+{
+    message_t msg;
+    int32_t ret;
+
+    if (!channel || !channel->credits || !message ||
+        (message->id & MSG_ID_FLAGS_MASK))
+    {
+        return -EINVAL;
+    }
+
+    msg = *message;
+    msg.id |= MSG_ID_FLAG_CREDIT | (channel->index << MSG_ID_REQUEST_TAG_SHIFT);
+
+    ret = service_unicast_message(channel->consumer, &msg);
+    if (ret)
+    {
+        (void)osSemaphoreRelease(channel->credits);
+        return ret;
+    }
+
+    (void)__atomic_add_fetch(&channel->stats.sent, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief   Return the credit of a message the consumer is done with.
+ *
+ * Called by the framework after the message handler, or when the
+ * message is dropped.
+ *
+ * @param   index Channel carried in the message id.
+ *
+ * @ingroup Service_Credit
+ */
+void service_credit_grant(uint32_t index)
+{
+    service_credit_t* channel;
+    message_t message;
+    uint32_t available;
+    uint32_t waiting = 1;
+
+    if (index >= CONFIG_SERVICE_CREDIT_MAX)
+    {
+        return;
+    }
+
+    channel = __atomic_load_n(&service_credit_channels[index], __ATOMIC_ACQUIRE);
+    if (!channel)
+    {
+        return;
+    }
+
+    (void)osSemaphoreRelease(channel->credits);
+    (void)__atomic_add_fetch(&channel->stats.granted, 1, __ATOMIC_RELAXED);
+
+    if (!channel->resume || !channel->producer)
+    {
+        return;
+    }
+
+    available = osSemaphoreGetCount(channel->credits);
+    if (available < channel->resume)
+    {
+        return;
+    }
+
+    if (!__atomic_compare_exchange_n(&channel->waiting, &waiting, 0, 0,
+                                     __ATOMIC_SEQ_CST,
+                                     __ATOMIC_SEQ_CST))
+    {
+        return;
+    }
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = channel->resume_id;
+    message.param0 = available;
+
+    if (service_unicast_message(channel->producer, &message))
+    {
+        /* The next credit back tries again. */
+        __atomic_store_n(&channel->waiting, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    (void)__atomic_add_fetch(&channel->stats.resumes, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Get the channel statistics.
+ *
+ * @param   channel Pointer to the channel.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Credit
+ */
+int32_t service_credit_get_stats(const service_credit_t* channel,
+                                 service_credit_stats_t* stats)
+{
+    if (!channel || !stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = channel->stats;
+
+    return 0;
+}
+
+#endif /* CONFIG_SERVICE_CREDIT_ENABLE */
@@ -0,0 +1,176 @@
+/**
+ * @file source/src/service_group.c
+ * @brief Definition the multicast groups of services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_group.h"
+
+#if CONFIG_SERVICE_GROUP_ENABLE
+
+/**
+ * @defgroup Service_Group Service Group
+ *
+ * @brief Multicast groups, sending one message to a fixed set of services.
+ *
+ * DECLARE_SERVICE_GROUP() names the member services. The core level of
+ * object_init() resolves the names once into an array of service handles,
+ * before any service thread runs, so a send walks that array only.
+ *
+ * service_multicast_message() computes the timeout, runs the interceptor
+ * and the rate limiter and stamps the message once for the whole group,
+ * then offers it to every member, also past a full queue, and logs one
+ * line. The members share the timeout, so a group of full queues blocks
+ * the sender once, not once per member. The members that did not get it are returned as a bit mask, for
+ * the caller to retry these only.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+extern service_group_t module_group$$Base[];
+extern service_group_t module_group$$Limit[];
+#endif
+
+/**
+ * @brief   Resolve the member names of one group.
+ *
+ * @param   group Pointer to the group.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_group_resolve(const service_group_t* group)
+{
+    const object* obj;
+    uint32_t i, j;
+
+    if (!group->count || group->count > CONFIG_SERVICE_GROUP_MEMBERS)
+    {
+        pr_error("Service group <%s> has %u members, 1 to %u allowed.",
+                 group->name,
+                 group->count,
+                 CONFIG_SERVICE_GROUP_MEMBERS);
+        return -E2BIG;
+    }
+
+    for (i = 0; i < group->count; i++)
+    {
+        obj = object_get_binding(group->members[i]);
+        if (!obj || obj->object_intf != &service_intf)
+        {
+            pr_error("Service group <%s> member <%s> is not a service.",
+                     group->name,
+                     group->members[i]);
+            return -ENOENT;
+        }
+
+        group->svcs[i] = service_get_svc(obj);
+
+        /* A member listed twice would get every message twice. */
+        for (j = 0; j < i; j++)
+        {
+            if (group->svcs[j] == group->svcs[i])
+            {
+                pr_error("Service group <%s> lists <%s> twice.",
+                         group->name,
+                         group->members[i]);
+                return -EEXIST;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Resolve the members of every group.
+ *
+ * @param   obj Pointer to the group object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_group_probe(const object* obj)
+{
+    const service_group_t* group;
+    int32_t ret;
+
+    for (group = module_group$$Base; group < module_group$$Limit; group++)
+    {
+        if (service_group_get_binding(group->name) != group)
+        {
+            pr_error("Service group <%s> declared twice.", group->name);
+            return -EEXIST;
+        }
+
+        ret = service_group_resolve(group);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+
+    pr_info("Object <%s> probe succeed, %u groups.",
+            obj->name,
+            (uint32_t)(module_group$$Limit - module_group$$Base));
+
+    return 0;
+}
+
+/**
+ * @brief   Get a multicast group by name.
+ *
+ * @param   name Name of the group.
+ *
+ * @retval  Returns the group, or NULL if no group has the name.
+ *
+ * @ingroup Service_Group
+ */
+const service_group_t* service_group_get_binding(const char* const name)
+{
+    const service_group_t* group;
+
+    if (!name)
+    {
+        return NULL;
+    }
+
+    for (group = module_group$$Base; group < module_group$$Limit; group++)
+    {
+        if (!strcmp(name, group->name))
+        {
+            return group;
+        }
+    }
+
+    return NULL;
+}
+
+module_core("group",
+            group,
+            service_group_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_GROUP_ENABLE */
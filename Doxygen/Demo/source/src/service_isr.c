@@ -0,0 +1,272 @@
+/**
+ * @file source/src/service_isr.c
+ * @brief Definition the interrupt posting ring.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "msg_ring.h"
+#include "service_isr.h"
+
+#if CONFIG_SERVICE_ISR_RING_ENABLE
+
+/**
+ * @defgroup Service_ISR Service ISR
+ *
+ * @brief Post messages from interrupts in constant time.
+ *
+ * Interrupts push the message into one lock-free ring and set a thread
+ * flag, whatever the number of services. Nested interrupts may post
+ * concurrently. A dispatcher thread drains the ring and sends each
+ * message with the normal blocking semantics of service_unicast_message()
+ * and service_broadcast_message(), so a full service queue delays the
+ * message instead of dropping it.
+ *
+ * When the ring is enabled, service_broadcast_message() called from an
+ * interrupt is deferred through the ring as well.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+#define SERVICE_ISR_THREAD_FLAG     0x00000001
+#define SERVICE_ISR_TAG_BROADCAST   0
+#define SERVICE_ISR_RING_MEM        (sizeof(msg_ring_t) + \
+                                     CONFIG_SERVICE_ISR_RING_SIZE * sizeof(msg_ring_slot_t))
+
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Messages posted from interrupts, tagged with the service index + 1, or 0 for broadcast.
+ */
+static uint8_t service_isr_ring_mem[SERVICE_ISR_RING_MEM] __attribute__((aligned(64)));
+
+#define service_isr_ring ((msg_ring_t*)service_isr_ring_mem)
+
+/**
+ * @brief   Dispatcher thread.
+ */
+static osThreadId_t service_isr_thread_id;
+
+/**
+ * @brief   Ring statistics.
+ */
+static service_isr_stats_t service_isr_stats;
+
+/**
+ * @brief   Push a message into the ring and wake the dispatcher.
+ *
+ * @param   message Message structure to post.
+ * @param   tag Destination tag.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_isr_post(const message_t* message, uint32_t tag)
+{
+    uint32_t count;
+    uint32_t peak;
+
+    if (!service_isr_thread_id)
+    {
+        return -ENODEV;
+    }
+
+    if (msg_ring_push(service_isr_ring, message, tag))
+    {
+        (void)__atomic_add_fetch(&service_isr_stats.overflows, 1, __ATOMIC_RELAXED);
+        return -EFULL;
+    }
+
+    (void)__atomic_add_fetch(&service_isr_stats.posted, 1, __ATOMIC_RELAXED);
+
+    count = msg_ring_count(service_isr_ring);
+    peak = __atomic_load_n(&service_isr_stats.peak, __ATOMIC_RELAXED);
+    while (count > peak &&
+           !__atomic_compare_exchange_n(&service_isr_stats.peak, &peak, count, 1,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+    {
+    }
+
+    (void)osThreadFlagsSet(service_isr_thread_id, SERVICE_ISR_THREAD_FLAG);
+
+    return 0;
+}
+
+/**
+ * @brief   Dispatcher thread, sending the posted messages.
+ *
+ * @param   argument Not used.
+ */
+static void service_isr_thread(void* argument)
+{
+    msg_ring_slot_t* slot;
+    message_t message;
+    uint32_t tag;
+    int32_t ret;
+
+    (void)argument;
+
+    while (1)
+    {
+        (void)osThreadFlagsWait(SERVICE_ISR_THREAD_FLAG, osFlagsWaitAny, osWaitForever);
+
+        while ((slot = msg_ring_peek(service_isr_ring)))
+        {
+            /* Free the slot before blocking on a service queue. */
+            message = slot->message;
+            tag = slot->tag;
+            msg_ring_consume(service_isr_ring, slot);
+
+            if (tag == SERVICE_ISR_TAG_BROADCAST)
+            {
+                ret = service_broadcast_message(&message);
+            }
+            else
+            {
+                ret = service_unicast_message(&module_service$$Base[tag - 1], &message);
+
+                /* Refused, release what the message holds like its sender would. */
+                if (ret)
+                {
+                    service_message_discard(&message);
+                }
+            }
+
+            if (ret)
+            {
+                service_isr_stats.failed++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Start the dispatcher thread.
+ *
+ * @param   obj Pointer to the object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_isr_probe(const object* obj)
+{
+    static const osThreadAttr_t attr =
+    {
+        .name       = "service_isr",
+        .stack_size = CONFIG_SERVICE_ISR_STACK_SIZE,
+        .priority   = osPriorityHigh,
+    };
+
+    (void)msg_ring_init(service_isr_ring, CONFIG_SERVICE_ISR_RING_SIZE);
+
+    service_isr_thread_id = osThreadNew(service_isr_thread, NULL, &attr);
+    if (!service_isr_thread_id)
+    {
+        pr_error("Object <%s> create thread <%s> failed.", obj->name, attr.name);
+        return -EINVAL;
+    }
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Post a message to a specified service from an interrupt.
+ *
+ * Only services declared with DECLARE_SERVICE() can be posted to.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
+ *
+ * @retval  Returns 0 on success, -EFULL if the ring is full,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_ISR
+ */
+int32_t service_unicast_message_isr(const service_t* svc, const message_t* message)
+{
+    if (!svc || !message)
+    {
+        return -EINVAL;
+    }
+
+    if (svc < module_service$$Base || svc >= module_service$$Limit)
+    {
+        return -EINVAL;
+    }
+
+    return service_isr_post(message, (uint32_t)(svc - module_service$$Base) + 1);
+}
+
+/**
+ * @brief   Post a message to all services from an interrupt.
+ *
+ * @param   message Message structure to send.
+ *
+ * @retval  Returns 0 on success, -EFULL if the ring is full,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_ISR
+ */
+int32_t service_broadcast_message_isr(const message_t* message)
+{
+    if (!message || (message->id & MSG_ID_FLAGS_UNICAST))
+    {
+        return -EINVAL;
+    }
+
+    return service_isr_post(message, SERVICE_ISR_TAG_BROADCAST);
+}
+
+/**
+ * @brief   Get the posting ring statistics.
+ *
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_ISR
+ */
+int32_t service_isr_get_stats(service_isr_stats_t* stats)
+{
+    if (!stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = service_isr_stats;
+
+    return 0;
+}
+
+module_core("service_isr",
+            service_isr,
+            service_isr_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_ISR_RING_ENABLE */
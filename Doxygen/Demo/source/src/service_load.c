@@ -0,0 +1,717 @@
+/**
+ * @file source/src/service_load.c
+ * @brief Definition the handler CPU time accounting of the services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_load.h"
+
+#if CONFIG_SERVICE_LOAD_ENABLE
+
+/**
+ * @defgroup Service_Load Service Load
+ *
+ * @brief Handler CPU time and load average of each service.
+ *
+ * The dispatch reads the kernel system timer before and after every
+ * message handler, and adds the difference to the service and to the
+ * pair of the service and the message id. The system timer runs at the
+ * core clock on most ports, so short handlers are measured too.
+ *
+ * Once a second the update turns the handler time of the last second
+ * into the 1 s load of the service, and folds it into the 10 s and 60 s
+ * load averages, which decay exponentially like the Unix load average.
+ * A handler running over several seconds is accounted when it returns,
+ * the part above 100 % is carried to the next seconds.
+ *
+ * The time is the wall time of the handler, a handler preempted by a
+ * higher priority thread is charged for the preemption too.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Load state of one service.
+ */
+typedef struct
+{
+    uint32_t    seq;            /**< Odd while the handler totals are updated. */
+    uint32_t    start;          /**< System timer when the running handler started. */
+    uint64_t    cycles;         /**< Handler time in system timer cycles. */
+    uint32_t    messages;       /**< Messages handled. */
+    uint32_t    window;         /**< Handler cycles not yet taken by the update. */
+    uint32_t    carry;          /**< Handler cycles above 100 % kept for the next update. */
+    uint32_t    load[3];        /**< 1 s, 10 s and 60 s load, 65536 for 100 %. */
+} service_load_state_t;
+
+/**
+ * @brief   Handler time of a service and message id pair.
+ */
+typedef struct
+{
+    uint32_t    key;            /**< Service index + 1 in the high half, message id in the low half, 0 if free. */
+    uint32_t    messages;       /**< Messages handled. */
+    uint64_t    cycles;         /**< Handler time in system timer cycles. */
+} service_load_entry_t;
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+
+#define SERVICE_LOAD_READ_SPIN  16
+#define SERVICE_LOAD_ONE        65536
+#endif
+
+/**
+ * @brief   Decay of the 10 s and 60 s averages per second, exp(-1/10) and exp(-1/60) in Q16.
+ */
+static const uint32_t service_load_decay[3] = { 0, 59299, 64453 };
+
+/**
+ * @brief   Load state, indexed like the module_service section.
+ */
+static service_load_state_t service_load_state[CONFIG_SERVICE_LOAD_MAX];
+
+/**
+ * @brief   Handler time per service and message id, open addressing.
+ */
+static service_load_entry_t service_load_entries[CONFIG_SERVICE_LOAD_IDS];
+
+/**
+ * @brief   Messages not accounted per id, the table was full.
+ */
+static uint32_t service_load_misses;
+
+/**
+ * @brief   System timer at the last update, valid if service_load_started.
+ */
+static uint32_t service_load_last;
+static uint32_t service_load_started;
+
+/**
+ * @brief   Get the index of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the index, or -1 if the service is not tracked.
+ */
+static int32_t service_load_index(const service_t* svc)
+{
+    if (svc < module_service$$Base || svc >= module_service$$Limit ||
+        svc - module_service$$Base >= CONFIG_SERVICE_LOAD_MAX)
+    {
+        return -1;
+    }
+
+    return (int32_t)(svc - module_service$$Base);
+}
+
+/**
+ * @brief   Find or claim the entry of a service and message id pair.
+ *
+ * @param   key Entry key, see service_load_entry_t.
+ * @param   claim Non-zero to claim a free entry if not found.
+ *
+ * @retval  Returns the entry, or NULL if not found.
+ */
+static service_load_entry_t* service_load_entry(uint32_t key, int32_t claim)
+{
+    service_load_entry_t* entry;
+    uint32_t pos = (key * 2654435761u) % CONFIG_SERVICE_LOAD_IDS;
+    uint32_t cur;
+    uint32_t i;
+
+    for (i = 0; i < CONFIG_SERVICE_LOAD_IDS; i++)
+    {
+        entry = &service_load_entries[(pos + i) % CONFIG_SERVICE_LOAD_IDS];
+
+        cur = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+        if (cur == key)
+        {
+            return entry;
+        }
+
+        if (cur)
+        {
+            continue;
+        }
+
+        if (!claim)
+        {
+            return NULL;
+        }
+
+        /* Other services claim entries too, keys are never released. */
+        if (__atomic_compare_exchange_n(&entry->key, &cur, key, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+            cur == key)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Convert system timer cycles to us.
+ *
+ * @param   cycles Cycle count.
+ *
+ * @retval  Returns the time in us.
+ */
+static uint64_t service_load_us(uint64_t cycles)
+{
+    uint32_t freq = osKernelGetSysTimerFreq();
+
+    return freq ? cycles * 1000000 / freq : cycles;
+}
+
+/**
+ * @brief   Convert a Q16 load to per mille.
+ *
+ * @param   load Load, 65536 for 100 %.
+ *
+ * @retval  Returns the load in per mille.
+ */
+static uint32_t service_load_permille(uint32_t load)
+{
+    return (uint32_t)(((uint64_t)load * 1000 + SERVICE_LOAD_ONE / 2) / SERVICE_LOAD_ONE);
+}
+
+/**
+ * @brief   Mark the start of a message handler.
+ *
+ * @param   svc Pointer to the service handle.
+ */
+void service_load_begin(service_t* svc)
+{
+    int32_t index = service_load_index(svc);
+
+    if (index >= 0)
+    {
+        service_load_state[index].start = osKernelGetSysTimerCount();
+    }
+}
+
+/**
+ * @brief   Mark the end of a message handler and account its time.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   id Message id, without the framework flags.
+ */
+void service_load_end(service_t* svc, uint32_t id)
+{
+    service_load_state_t* state;
+    service_load_entry_t* entry;
+    int32_t index = service_load_index(svc);
+    uint32_t cycles;
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    state = &service_load_state[index];
+    cycles = osKernelGetSysTimerCount() - state->start;
+
+    entry = service_load_entry(((uint32_t)(index + 1) << 16) | (id & 0xFFFF), 1);
+    if (!entry)
+    {
+        (void)__atomic_add_fetch(&service_load_misses, 1, __ATOMIC_RELAXED);
+    }
+
+    /* Only the service thread writes the totals, readers retry on seq. */
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    state->cycles += cycles;
+    state->messages++;
+
+    if (entry)
+    {
+        entry->cycles += cycles;
+        entry->messages++;
+    }
+
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELEASE);
+
+    (void)__atomic_add_fetch(&state->window, cycles, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Update the load averages of the services.
+ *
+ * Called every second by the load thread, or from a timer when
+ * CONFIG_SERVICE_LOAD_THREAD is 0.
+ *
+ * @ingroup Service_Load
+ */
+void service_load_update(void)
+{
+    service_load_state_t* state;
+    uint32_t now = osKernelGetSysTimerCount();
+    uint32_t elapsed = now - service_load_last;
+    uint64_t busy;
+    uint32_t sample;
+    uint32_t i;
+    uint32_t k;
+
+    service_load_last = now;
+
+    if (!service_load_started || !elapsed)
+    {
+        service_load_started = 1;
+        return;
+    }
+
+    for (i = 0; i < CONFIG_SERVICE_LOAD_MAX; i++)
+    {
+        state = &service_load_state[i];
+
+        busy = (uint64_t)__atomic_exchange_n(&state->window, 0, __ATOMIC_RELAXED) +
+               state->carry;
+
+        if (busy > elapsed)
+        {
+            state->carry = (uint32_t)(busy - elapsed);
+            busy = elapsed;
+        }
+        else
+        {
+            state->carry = 0;
+        }
+
+        sample = (uint32_t)(busy * SERVICE_LOAD_ONE / elapsed);
+
+        state->load[0] = sample;
+
+        for (k = 1; k < 3; k++)
+        {
+            state->load[k] = (uint32_t)(((uint64_t)state->load[k] * service_load_decay[k] +
+                                         (uint64_t)sample * (SERVICE_LOAD_ONE - service_load_decay[k])) >> 16);
+        }
+    }
+}
+
+#if CONFIG_SERVICE_LOAD_THREAD
+/**
+ * @brief   Load update thread.
+ *
+ * @param   argument Not used.
+ */
+static void service_load_thread(void* argument)
+{
+    uint32_t period = osKernelGetTickFreq();
+
+    (void)argument;
+
+    while (1)
+    {
+        service_load_update();
+
+        (void)osDelay(period ? period : 1000);
+    }
+}
+#endif
+
+/**
+ * @brief   Start the update thread.
+ *
+ * @param   obj Pointer to the load object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_load_probe(const object* obj)
+{
+#if CONFIG_SERVICE_LOAD_THREAD
+    static const osThreadAttr_t attr =
+    {
+        .name       = "load",
+        .stack_size = CONFIG_SERVICE_LOAD_STACK_SIZE,
+        .priority   = osPriorityHigh,
+    };
+
+    if (!osThreadNew(service_load_thread, NULL, &attr))
+    {
+        pr_error("Object <%s> create thread <%s> failed.", obj->name, attr.name);
+        return -EINVAL;
+    }
+#endif
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Wait until the handler totals of a service are not being updated.
+ *
+ * @param   spin Attempts so far, reset when the reader slept.
+ *
+ * @retval  Returns 0 to retry, -EBUSY if the totals stayed busy in interrupt context.
+ */
+static int32_t service_load_backoff(uint32_t* spin)
+{
+    if (++*spin < SERVICE_LOAD_READ_SPIN)
+    {
+        return 0;
+    }
+
+    if (xPortIsInsideInterrupt())
+    {
+        return -EBUSY;
+    }
+
+    (void)osDelay(1);
+    *spin = 0;
+
+    return 0;
+}
+
+/**
+ * @brief   Get the load states of the replicas of a service.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   count Returns the number of states, the replicas past
+ *                CONFIG_SERVICE_LOAD_MAX are not tracked.
+ *
+ * @retval  Returns the index of the first state, or -1 if the service is not tracked.
+ */
+static int32_t service_load_range(const object* obj, uint32_t* count)
+{
+    const service_t* svc = service_get_svc(obj);
+    int32_t index = service_load_index(svc);
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    *count = SERVICE_REPLICA_COUNT(svc);
+    if (*count > (uint32_t)(CONFIG_SERVICE_LOAD_MAX - index))
+    {
+        *count = (uint32_t)(CONFIG_SERVICE_LOAD_MAX - index);
+    }
+
+    return index;
+}
+
+/**
+ * @brief   Read the sequences of consecutive load states.
+ *
+ * Every update moves a sequence forward, so the sum only repeats if
+ * none of the states changed.
+ *
+ * @param   index Index of the first state.
+ * @param   count Number of states.
+ * @param   busy Set to non-zero if a state is being updated.
+ *
+ * @retval  Returns the sum of the sequences.
+ */
+static uint32_t service_load_seq(int32_t index, uint32_t count, uint32_t* busy)
+{
+    uint32_t sum = 0;
+    uint32_t seq;
+    uint32_t i;
+
+    *busy = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        seq = __atomic_load_n(&service_load_state[index + i].seq, __ATOMIC_ACQUIRE);
+        *busy |= seq & 1;
+        sum += seq;
+    }
+
+    return sum;
+}
+
+/**
+ * @brief   Get the handler CPU time and the load of a service.
+ *
+ * The replicas of a replicated service are summed, its load may go
+ * above 100 % on several cores.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, -EBUSY if the service updated its totals
+ *          in interrupt context, negative error code otherwise.
+ *
+ * @ingroup Service_Load
+ */
+int32_t service_load_get_stats(const object* obj, service_load_stats_t* stats)
+{
+    const service_load_state_t* state;
+    uint64_t cycles;
+    uint32_t messages;
+    uint32_t count;
+    uint32_t busy;
+    uint32_t seq;
+    uint32_t spin = 0;
+    uint32_t i;
+    int32_t index;
+
+    if (!obj || !stats)
+    {
+        return -EINVAL;
+    }
+
+    index = service_load_range(obj, &count);
+    if (index < 0)
+    {
+        return -ENOENT;
+    }
+
+    while (1)
+    {
+        seq = service_load_seq(index, count, &busy);
+        if (!busy)
+        {
+            cycles = 0;
+            messages = 0;
+
+            for (i = 0; i < count; i++)
+            {
+                cycles += service_load_state[index + i].cycles;
+                messages += service_load_state[index + i].messages;
+            }
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (service_load_seq(index, count, &busy) == seq)
+            {
+                break;
+            }
+        }
+
+        if (service_load_backoff(&spin))
+        {
+            return -EBUSY;
+        }
+    }
+
+    (void)memset(stats, 0, sizeof(*stats));
+    stats->time_us = service_load_us(cycles);
+    stats->messages = messages;
+
+    for (i = 0; i < count; i++)
+    {
+        state = &service_load_state[index + i];
+
+        stats->load_1s += service_load_permille(state->load[0]);
+        stats->load_10s += service_load_permille(state->load[1]);
+        stats->load_60s += service_load_permille(state->load[2]);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Get the handler CPU time of a service per message id, most time first.
+ *
+ * The replicas of a replicated service are summed per message id.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   stats Output array.
+ * @param   count Size of the output array.
+ *
+ * @retval  Returns the number of message ids copied.
+ *
+ * @ingroup Service_Load
+ */
+uint32_t service_load_get_id_stats(const object* obj,
+                                   service_load_id_stats_t* stats,
+                                   uint32_t count)
+{
+    const service_load_entry_t* entry;
+    const service_load_entry_t* other;
+    service_load_id_stats_t cur;
+    uint32_t replicas;
+    uint32_t busy;
+    uint32_t seq;
+    uint32_t spin = 0;
+    uint32_t owner;
+    uint32_t num;
+    uint32_t key;
+    uint32_t i;
+    uint32_t j;
+    int32_t index;
+
+    if (!obj || !stats || !count)
+    {
+        return 0;
+    }
+
+    index = service_load_range(obj, &replicas);
+    if (index < 0)
+    {
+        return 0;
+    }
+
+    while (1)
+    {
+        num = 0;
+
+        seq = service_load_seq(index, replicas, &busy);
+        if (!busy)
+        {
+            for (i = 0; i < CONFIG_SERVICE_LOAD_IDS; i++)
+            {
+                entry = &service_load_entries[i];
+
+                key = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+                owner = key >> 16;
+                if (owner < (uint32_t)(index + 1) || owner > (uint32_t)index + replicas)
+                {
+                    continue;
+                }
+
+                cur.id = key & 0xFFFF;
+                cur.messages = 0;
+                cur.time_us = 0; /* In cycles until the copy is done. */
+
+                /* Sum the id over the replicas at its first entry, skip it at the others. */
+                for (j = 0; j < CONFIG_SERVICE_LOAD_IDS; j++)
+                {
+                    other = &service_load_entries[j];
+
+                    key = __atomic_load_n(&other->key, __ATOMIC_ACQUIRE);
+                    owner = key >> 16;
+                    if (owner < (uint32_t)(index + 1) || owner > (uint32_t)index + replicas ||
+                        (key & 0xFFFF) != cur.id)
+                    {
+                        continue;
+                    }
+
+                    if (j < i)
+                    {
+                        break;
+                    }
+
+                    cur.messages += other->messages;
+                    cur.time_us += other->cycles;
+                }
+
+                if (j < CONFIG_SERVICE_LOAD_IDS)
+                {
+                    continue;
+                }
+
+                /* Insertion by time, the least one falls off a full array. */
+                for (j = num < count ? num++ : count;
+                     j > 0 && stats[j - 1].time_us < cur.time_us; j--)
+                {
+                    if (j < count)
+                    {
+                        stats[j] = stats[j - 1];
+                    }
+                }
+
+                if (j < count)
+                {
+                    stats[j] = cur;
+                }
+            }
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (service_load_seq(index, replicas, &busy) == seq)
+            {
+                break;
+            }
+        }
+
+        if (service_load_backoff(&spin))
+        {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        stats[i].time_us = service_load_us(stats[i].time_us);
+    }
+
+    return num;
+}
+
+/**
+ * @brief   Dump the load of the services and their busiest message ids.
+ *
+ * @ingroup Service_Load
+ */
+void service_load_dump(void)
+{
+    service_load_id_stats_t ids[4];
+    service_load_stats_t stats;
+    const service_t* svc;
+    uint32_t num;
+    uint32_t i;
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        /* One line per service, the replicas are summed. */
+        if (!svc->owner || SERVICE_REPLICA_INDEX(svc) || service_load_get_stats(svc->owner, &stats))
+        {
+            continue;
+        }
+
+        pr_info("Service <%s> load %u.%u%% %u.%u%% %u.%u%%, %u messages in %u.%03u ms.",
+                svc->owner->name,
+                stats.load_1s / 10, stats.load_1s % 10,
+                stats.load_10s / 10, stats.load_10s % 10,
+                stats.load_60s / 10, stats.load_60s % 10,
+                stats.messages,
+                (uint32_t)(stats.time_us / 1000),
+                (uint32_t)(stats.time_us % 1000));
+
+        num = service_load_get_id_stats(svc->owner, ids, sizeof(ids) / sizeof(ids[0]));
+        for (i = 0; i < num; i++)
+        {
+            pr_info("    %s(0x%x) %u messages in %u.%03u ms.",
+                    msg_id_to_str(ids[i].id),
+                    ids[i].id,
+                    ids[i].messages,
+                    (uint32_t)(ids[i].time_us / 1000),
+                    (uint32_t)(ids[i].time_us % 1000));
+        }
+    }
+
+    num = __atomic_load_n(&service_load_misses, __ATOMIC_RELAXED);
+    if (num)
+    {
+        pr_info("%u messages not accounted per id, CONFIG_SERVICE_LOAD_IDS too small.", num);
+    }
+}
+
+module_core("load",
+            load,
+            service_load_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_LOAD_ENABLE */
@@ -0,0 +1,684 @@
+/**
+ * @file source/src/service_pool.c
+ * @brief Definition the message pool shared by the service queues.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_pool.h"
+
+#if CONFIG_SERVICE_POOL_ENABLE
+
+/**
+ * @defgroup Service_Pool Service Pool
+ *
+ * @brief One message pool for the queues of many services.
+ *
+ * A service configured with SERVICE_FLAG_SHARED_POOL gets no RTOS queue.
+ * Its messages are nodes of one global pool of CONFIG_SERVICE_POOL_SIZE
+ * messages, linked into a list per service. The service reserves
+ * msg_count nodes, always available to it, and queues at most msg_cap
+ * messages, drawing the nodes above its reservation from the part of
+ * the pool nobody reserved. Queues sized for their own worst burst
+ * rarely fill at the same time, so a pool smaller than their sum serves
+ * them all.
+ *
+ * For example, 8 services with 16 messages queues take 8 * (16 * 20 +
+ * 80) = 3200 bytes of packed messages and queue control blocks, with
+ * CONFIG_SERVICE_POOL_CB_SIZE = 80. A 64 messages pool with 4 messages
+ * reserved per service and a cap of 16 takes 64 * 22 = 1408 bytes of
+ * nodes and links, 8 * 80 = 640 bytes of semaphores, one per service,
+ * 80 bytes for the semaphore of the waiting senders and
+ * CONFIG_SERVICE_POOL_QUEUES * 36 = 576 bytes of queue slots, 2704 bytes
+ * in all. Each service still accepts its burst of 16 while the others
+ * hold fewer than 20 of the 32 shared nodes. The saving grows with the
+ * queue sizes and shrinks with the unused queue slots.
+ * service_pool_dump() reports the same comparison for the services of
+ * the running system.
+ *
+ * The pool is a stack of free nodes with a tagged head, each service
+ * list is a stack pushed by the senders and taken whole by the service
+ * thread, which reverses it to restore the send order. All of it is
+ * lock-free, so sending from interrupts works as with an RTOS queue.
+ * A sender blocked on a full queue or pool waits on one semaphore of
+ * the pool, released for each waiting sender when the service threads
+ * take a message, and looks again.
+ *
+ * The pool only replaces the RTOS queue, service_queue_put() and the
+ * receive loops of the service thread branch to it, so signals, EDF,
+ * direct mode, requests and queue tuning work as with a plain queue.
+ *
+ * @ingroup Service_API
+ */
+
+_Static_assert(CONFIG_SERVICE_POOL_SIZE < 0xFFFF, "pool nodes are 16 bits indexes");
+
+#ifndef DOC_HIDDEN
+/* End of a list. */
+#define SERVICE_POOL_NIL 0xFFFF
+#endif
+
+/**
+ * @brief   Queue of one service in the pool.
+ */
+typedef struct
+{
+    service_t*      svc;        /**< Service handle, NULL if the queue is unused. */
+    osSemaphoreId_t count;      /**< Messages in the queue. */
+    uint32_t        pushed;     /**< Stack of the messages sent, newest first. */
+    uint32_t        first;      /**< Messages taken by the service thread, oldest first. */
+    uint32_t        reserved;   /**< Nodes always available to the service. */
+    uint32_t        cap;        /**< Most nodes the service holds. */
+    uint32_t        used;       /**< Nodes the service holds. */
+    uint32_t        peak;       /**< Most nodes the service held at once. */
+    uint32_t        failures;   /**< Sends refused. */
+} service_pool_queue_t;
+
+/**
+ * @brief   Pool nodes, a message each.
+ */
+static message_t service_pool_nodes[CONFIG_SERVICE_POOL_SIZE];
+
+/**
+ * @brief   Link of each node, in the free stack or in a service list.
+ */
+static uint16_t service_pool_next[CONFIG_SERVICE_POOL_SIZE];
+
+/**
+ * @brief   Free stack head, node index in the low 16 bits and an ABA tag above.
+ */
+static uint32_t service_pool_free;
+
+/**
+ * @brief   Free nodes above the reservations.
+ */
+static uint32_t service_pool_shared;
+
+/**
+ * @brief   Nodes holding a message, and their peak.
+ */
+static uint32_t service_pool_used;
+static uint32_t service_pool_peak;
+
+/**
+ * @brief   Set once the free stack is built.
+ */
+static uint32_t service_pool_ready;
+
+/**
+ * @brief   Senders waiting for a node, and the semaphore they wait on.
+ */
+static uint32_t service_pool_waiters;
+static osSemaphoreId_t service_pool_space;
+
+/**
+ * @brief   Queues of the attached services.
+ */
+static service_pool_queue_t service_pool_queues[CONFIG_SERVICE_POOL_QUEUES];
+
+/**
+ * @brief   Take a node from the free stack.
+ *
+ * @retval  Returns the node index, SERVICE_POOL_NIL if the stack is empty.
+ */
+static uint32_t service_pool_pop(void)
+{
+    uint32_t head = __atomic_load_n(&service_pool_free, __ATOMIC_ACQUIRE);
+    uint32_t index;
+    uint32_t next;
+
+    do
+    {
+        index = head & 0xFFFF;
+        if (index == SERVICE_POOL_NIL)
+        {
+            return SERVICE_POOL_NIL;
+        }
+
+        /* May read a node taken meanwhile, the tag fails the CAS then. */
+        next = __atomic_load_n(&service_pool_next[index], __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&service_pool_free, &head,
+                                          (head & 0xFFFF0000) + 0x10000 + next, 1,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_ACQUIRE));
+
+    return index;
+}
+
+/**
+ * @brief   Give a node back to the free stack.
+ *
+ * @param   index Node index.
+ */
+static void service_pool_push(uint32_t index)
+{
+    uint32_t head = __atomic_load_n(&service_pool_free, __ATOMIC_RELAXED);
+
+    do
+    {
+        __atomic_store_n(&service_pool_next[index], (uint16_t)(head & 0xFFFF), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&service_pool_free, &head,
+                                          (head & 0xFFFF0000) + 0x10000 + index, 1,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief   Build the free stack, once.
+ */
+static void service_pool_setup(void)
+{
+    uint32_t expected = 0;
+    uint32_t i;
+
+    if (!__atomic_compare_exchange_n(&service_pool_ready, &expected, 1, 0,
+                                     __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&service_pool_ready, __ATOMIC_ACQUIRE) != 2)
+        {
+        }
+
+        return;
+    }
+
+    for (i = 0; i < CONFIG_SERVICE_POOL_SIZE; i++)
+    {
+        service_pool_next[i] = (uint16_t)(i + 1 < CONFIG_SERVICE_POOL_SIZE ? i + 1 : SERVICE_POOL_NIL);
+    }
+
+    __atomic_store_n(&service_pool_free, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&service_pool_shared, CONFIG_SERVICE_POOL_SIZE, __ATOMIC_RELAXED);
+
+    service_pool_space = osSemaphoreNew(CONFIG_SERVICE_POOL_SIZE, 0, NULL);
+
+    __atomic_store_n(&service_pool_ready, 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Account one more node for a queue.
+ *
+ * Within its reservation a queue always gets the node, above it the node
+ * comes from the shared part, up to the cap of the queue.
+ *
+ * @param   queue Pointer to the queue.
+ *
+ * @retval  Returns 0 on success, -ENOMEM if the queue may not hold another node.
+ */
+static int32_t service_pool_claim(service_pool_queue_t* queue)
+{
+    uint32_t used = __atomic_load_n(&queue->used, __ATOMIC_RELAXED);
+    uint32_t shared;
+    uint32_t total;
+    int32_t borrowed;
+
+    while (1)
+    {
+        if (used >= queue->cap)
+        {
+            return -ENOMEM;
+        }
+
+        borrowed = (used >= queue->reserved);
+        if (borrowed)
+        {
+            shared = __atomic_load_n(&service_pool_shared, __ATOMIC_RELAXED);
+            do
+            {
+                if (!shared)
+                {
+                    return -ENOMEM;
+                }
+            } while (!__atomic_compare_exchange_n(&service_pool_shared, &shared, shared - 1, 1,
+                                                  __ATOMIC_ACQUIRE,
+                                                  __ATOMIC_RELAXED));
+        }
+
+        if (__atomic_compare_exchange_n(&queue->used, &used, used + 1, 0,
+                                        __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+        {
+            break;
+        }
+
+        /* Lost the race, give the shared node back and look again. */
+        if (borrowed)
+        {
+            (void)__atomic_add_fetch(&service_pool_shared, 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    if (used + 1 > __atomic_load_n(&queue->peak, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&queue->peak, used + 1, __ATOMIC_RELAXED);
+    }
+
+    total = __atomic_add_fetch(&service_pool_used, 1, __ATOMIC_RELAXED);
+    if (total > __atomic_load_n(&service_pool_peak, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&service_pool_peak, total, __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Account one node less for a queue.
+ *
+ * @param   queue Pointer to the queue.
+ */
+static void service_pool_unclaim(service_pool_queue_t* queue)
+{
+    uint32_t used = __atomic_fetch_sub(&queue->used, 1, __ATOMIC_RELEASE);
+
+    (void)__atomic_sub_fetch(&service_pool_used, 1, __ATOMIC_RELAXED);
+
+    /* The nodes above the reservation were shared ones. */
+    if (used > queue->reserved)
+    {
+        (void)__atomic_add_fetch(&service_pool_shared, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief   Queue a message to a pooled service.
+ *
+ * @param   svc Pointer to the service handle, attached to the pool.
+ * @param   message Message to queue.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the RTOS status.
+ *
+ * @ingroup Service_Pool
+ */
+osStatus_t service_pool_put(const service_t*    svc,
+                            const message_t*    message,
+                            uint32_t            timeout)
+{
+    service_pool_queue_t* queue = (service_pool_queue_t*)svc->pool;
+    osStatus_t stat = osErrorResource;
+    uint32_t elapsed;
+    uint32_t start;
+    uint32_t index;
+    uint32_t head;
+
+    while (service_pool_claim(queue))
+    {
+        if (!timeout || !service_pool_space)
+        {
+            (void)__atomic_add_fetch(&queue->failures, 1, __ATOMIC_RELAXED);
+            return stat;
+        }
+
+        /* Count in before the last look, a node freed after it wakes us. */
+        (void)__atomic_add_fetch(&service_pool_waiters, 1, __ATOMIC_SEQ_CST);
+
+        if (!service_pool_claim(queue))
+        {
+            (void)__atomic_sub_fetch(&service_pool_waiters, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        start = osKernelGetTickCount();
+        stat = osSemaphoreAcquire(service_pool_space, timeout);
+
+        (void)__atomic_sub_fetch(&service_pool_waiters, 1, __ATOMIC_RELAXED);
+
+        if (stat != osOK)
+        {
+            (void)__atomic_add_fetch(&queue->failures, 1, __ATOMIC_RELAXED);
+            return osErrorTimeout;
+        }
+
+        /* Woken for any freed node, it may have gone to another sender. */
+        stat = osErrorTimeout;
+        if (timeout != osWaitForever)
+        {
+            elapsed = osKernelGetTickCount() - start;
+            timeout = (elapsed < timeout) ? timeout - elapsed : 0;
+        }
+    }
+
+    /* Nodes are given back before they are unclaimed, a claim always finds one. */
+    index = service_pool_pop();
+
+    service_pool_nodes[index] = *message;
+
+    head = __atomic_load_n(&queue->pushed, __ATOMIC_RELAXED);
+    do
+    {
+        __atomic_store_n(&service_pool_next[index], (uint16_t)head, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&queue->pushed, &head, index, 1,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+
+    return osSemaphoreRelease(queue->count);
+}
+
+/**
+ * @brief   Take the next message of a pooled service.
+ *
+ * Called by the service thread only.
+ *
+ * @param   svc Pointer to the service handle, attached to the pool.
+ * @param   message Pointer to the message buffer.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the RTOS status, osOK with a message.
+ *
+ * @ingroup Service_Pool
+ */
+osStatus_t service_pool_get(const service_t* svc, message_t* message, uint32_t timeout)
+{
+    service_pool_queue_t* queue = (service_pool_queue_t*)svc->pool;
+    osStatus_t stat;
+    uint32_t waiters;
+    uint32_t index;
+    uint32_t next;
+    uint32_t prev;
+
+    stat = osSemaphoreAcquire(queue->count, timeout);
+    if (stat != osOK)
+    {
+        return stat;
+    }
+
+    /* Only this thread takes from the queue, reverse the pushed stack into send order. */
+    if (queue->first == SERVICE_POOL_NIL)
+    {
+        index = __atomic_exchange_n(&queue->pushed, SERVICE_POOL_NIL, __ATOMIC_ACQUIRE);
+        prev = SERVICE_POOL_NIL;
+
+        while (index != SERVICE_POOL_NIL)
+        {
+            next = service_pool_next[index];
+            service_pool_next[index] = (uint16_t)prev;
+            prev = index;
+            index = next;
+        }
+
+        queue->first = prev;
+    }
+
+    index = queue->first;
+    if (index == SERVICE_POOL_NIL)
+    {
+        return osErrorResource;
+    }
+
+    queue->first = service_pool_next[index];
+
+    *message = service_pool_nodes[index];
+
+    service_pool_push(index);
+    service_pool_unclaim(queue);
+
+    /* Each waiting sender looks again, the ones the node does not fit wait again. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    waiters = __atomic_load_n(&service_pool_waiters, __ATOMIC_RELAXED);
+    while (waiters--)
+    {
+        (void)osSemaphoreRelease(service_pool_space);
+    }
+
+    return osOK;
+}
+
+/**
+ * @brief   Get the messages queued to a pooled service.
+ *
+ * @param   svc Pointer to the service handle, attached to the pool.
+ *
+ * @retval  Returns the message count.
+ *
+ * @ingroup Service_Pool
+ */
+uint32_t service_pool_count(const service_t* svc)
+{
+    return __atomic_load_n(&((service_pool_queue_t*)svc->pool)->used, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief   Attach a service handle to the shared pool.
+ *
+ * Called by the service initialization for services configured with
+ * SERVICE_FLAG_SHARED_POOL, once per replica.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   config Pointer to the service configuration, msg_count nodes
+ *                 are reserved and msg_cap bounds the queue, 0 for the
+ *                 pool size.
+ *
+ * @retval  Returns 0 on success, -ENOMEM if the pool cannot hold the
+ *          reservation, -ENOSPC if all queues are used, negative error
+ *          code otherwise.
+ *
+ * @ingroup Service_Pool
+ */
+int32_t service_pool_attach(service_t* svc, const service_config_t* const config)
+{
+    service_pool_queue_t* queue;
+    service_t* expected;
+    uint32_t shared;
+    uint32_t cap;
+    uint32_t i;
+
+    if (!svc || !config)
+    {
+        return -EINVAL;
+    }
+
+    cap = config->msg_cap ? config->msg_cap : CONFIG_SERVICE_POOL_SIZE;
+    if (cap < config->msg_count || cap > CONFIG_SERVICE_POOL_SIZE)
+    {
+        return -EINVAL;
+    }
+
+    service_pool_setup();
+
+    /* The reservation leaves the shared part for good. */
+    shared = __atomic_load_n(&service_pool_shared, __ATOMIC_RELAXED);
+    do
+    {
+        if (shared < config->msg_count)
+        {
+            return -ENOMEM;
+        }
+    } while (!__atomic_compare_exchange_n(&service_pool_shared, &shared, shared - config->msg_count, 1,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+
+    for (i = 0; i < CONFIG_SERVICE_POOL_QUEUES; i++)
+    {
+        queue = &service_pool_queues[i];
+        expected = NULL;
+
+        if (!__atomic_compare_exchange_n(&queue->svc, &expected, svc, 0,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_RELAXED))
+        {
+            continue;
+        }
+
+        queue->pushed = SERVICE_POOL_NIL;
+        queue->first = SERVICE_POOL_NIL;
+        queue->reserved = config->msg_count;
+        queue->cap = cap;
+        queue->used = 0;
+        queue->peak = 0;
+        queue->failures = 0;
+
+        queue->count = osSemaphoreNew(cap, 0, NULL);
+        if (!queue->count)
+        {
+            __atomic_store_n(&queue->svc, NULL, __ATOMIC_RELEASE);
+            break;
+        }
+
+        svc->pool = queue;
+
+        return 0;
+    }
+
+    (void)__atomic_add_fetch(&service_pool_shared, config->msg_count, __ATOMIC_RELEASE);
+
+    return (i < CONFIG_SERVICE_POOL_QUEUES) ? -ENOMEM : -ENOSPC;
+}
+
+/**
+ * @brief   Detach a service handle from the shared pool.
+ *
+ * The service thread must be stopped and the queue drained, the
+ * service deinitialization discards the messages left before.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @ingroup Service_Pool
+ */
+void service_pool_detach(service_t* svc)
+{
+    service_pool_queue_t* queue;
+
+    if (!svc || !svc->pool)
+    {
+        return;
+    }
+
+    queue = (service_pool_queue_t*)svc->pool;
+
+    (void)osSemaphoreDelete(queue->count);
+    queue->count = NULL;
+
+    (void)__atomic_add_fetch(&service_pool_shared, queue->reserved, __ATOMIC_RELEASE);
+
+    svc->pool = NULL;
+
+    __atomic_store_n(&queue->svc, NULL, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Get the shared pool statistics.
+ *
+ * @param   stats Returns the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Pool
+ */
+int32_t service_pool_get_stats(service_pool_stats_t* stats)
+{
+    const service_pool_queue_t* queue;
+    uint32_t i;
+
+    if (!stats)
+    {
+        return -EINVAL;
+    }
+
+    (void)memset(stats, 0, sizeof(*stats));
+    stats->size = CONFIG_SERVICE_POOL_SIZE;
+    stats->ram = sizeof(service_pool_nodes) + sizeof(service_pool_next) +
+                 sizeof(service_pool_queues) + CONFIG_SERVICE_POOL_CB_SIZE;
+    stats->peak = __atomic_load_n(&service_pool_peak, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&service_pool_ready, __ATOMIC_ACQUIRE) != 2)
+    {
+        stats->free = CONFIG_SERVICE_POOL_SIZE;
+        stats->shared = CONFIG_SERVICE_POOL_SIZE;
+        return 0;
+    }
+
+    stats->free = CONFIG_SERVICE_POOL_SIZE - __atomic_load_n(&service_pool_used, __ATOMIC_RELAXED);
+    stats->shared = __atomic_load_n(&service_pool_shared, __ATOMIC_RELAXED);
+
+    for (i = 0; i < CONFIG_SERVICE_POOL_QUEUES; i++)
+    {
+        queue = &service_pool_queues[i];
+        if (!__atomic_load_n(&queue->svc, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+
+        stats->queues++;
+        stats->reserved += queue->reserved;
+        stats->failures += __atomic_load_n(&queue->failures, __ATOMIC_RELAXED);
+
+        /* The semaphore of the pool queue against the control block of a queue. */
+        stats->ram += CONFIG_SERVICE_POOL_CB_SIZE;
+        stats->queue_ram += (queue->cap < CONFIG_SERVICE_POOL_SIZE ? queue->cap : queue->reserved) *
+                            sizeof(message_t) + CONFIG_SERVICE_POOL_CB_SIZE;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Dump the shared pool usage and the RAM it saves.
+ *
+ * @ingroup Service_Pool
+ */
+void service_pool_dump(void)
+{
+    const service_pool_queue_t* queue;
+    service_pool_stats_t stats;
+    int32_t saved;
+    uint32_t i;
+
+    (void)service_pool_get_stats(&stats);
+
+    for (i = 0; i < CONFIG_SERVICE_POOL_QUEUES; i++)
+    {
+        queue = &service_pool_queues[i];
+        if (!queue->svc)
+        {
+            continue;
+        }
+
+        pr_info("Pool <%s> replica %u used %u, peak %u, reserved %u, cap %u, failures %u.",
+                queue->svc->owner ? queue->svc->owner->name : "",
+                SERVICE_REPLICA_INDEX(queue->svc),
+                queue->used,
+                queue->peak,
+                queue->reserved,
+                queue->cap,
+                queue->failures);
+    }
+
+    pr_info("Pool %u nodes, free %u, shared %u, reserved %u, peak %u, failures %u.",
+            stats.size,
+            stats.free,
+            stats.shared,
+            stats.reserved,
+            stats.peak,
+            stats.failures);
+
+    saved = (int32_t)stats.queue_ram - (int32_t)stats.ram;
+
+    pr_info("Pool RAM %u bytes for %u queues of %u bytes, %s %d bytes.",
+            stats.ram,
+            stats.queues,
+            stats.queue_ram,
+            (saved >= 0) ? "saved" : "added",
+            (saved >= 0) ? saved : -saved);
+}
+
+#endif /* CONFIG_SERVICE_POOL_ENABLE */
@@ -0,0 +1,562 @@
+/**
+ * @file source/src/service_queue_tune.c
+ * @brief Definition the service queue sizing recommendations.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_queue_tune.h"
+
+#if CONFIG_SERVICE_QUEUE_TUNE_ENABLE
+
+/**
+ * @defgroup Service_Queue_Tune Service Queue Tune
+ *
+ * @brief Recommend queue sizes from the load observed during a run.
+ *
+ * Every enqueue records the queue occupancy the message finds and the
+ * time since the previous arrival. The share of arrivals that find n or
+ * more messages queued is the share a queue of n slots would have
+ * refused. It is counted on the arrivals themselves, so it holds for
+ * bursty senders as well, no time average is assumed.
+ *
+ * The recommendation is the smallest size whose observed full
+ * probability is within CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM. When the
+ * run is too short for that tail to be measured, or the queue was full
+ * so the tail is cut off, a geometric tail is fitted to the measured
+ * part of the histogram and the larger of both sizes is used.
+ *
+ * The tail is fitted to the occupancies measured, bursts included. The
+ * squared coefficient of variation cv2 of the inter-arrival time only
+ * tells bursty senders, above 1, from smooth ones, it does not change
+ * the size.
+ *
+ * The replicas of a replicated service have a queue each of the same
+ * size, their statistics are merged into one recommendation for all.
+ *
+ * service_queue_tune_dump_header() prints the recommendations as
+ * CONFIG_<SERVICE>_MSG_COUNT macros. A service configuration takes its
+ * msg_count from that macro with an #ifndef default, see
+ * source/sim/sim_demo.c, and make SERVICE_CONF=<saved header> includes
+ * the header in every source of the next build.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   64 bits sum updated by several senders with 32 bits atomics.
+ */
+typedef struct
+{
+    uint32_t    lo;     /**< Low word. */
+    uint32_t    hi;     /**< High word, with the carries of the low word. */
+} service_queue_sum_t;
+
+/**
+ * @brief   Queue statistics of one service.
+ */
+typedef struct
+{
+    uint32_t            hist[CONFIG_SERVICE_QUEUE_TUNE_BUCKETS];    /**< Arrivals by occupancy found. */
+    uint32_t            arrivals;                                   /**< Messages offered. */
+    uint32_t            full;                                       /**< Arrivals that found the queue full. */
+    uint32_t            peak;                                       /**< Highest occupancy found. */
+    service_queue_sum_t occupancy_sum;                              /**< Sum of the occupancy found. */
+    uint32_t            last_tick;                                  /**< Tick of the previous arrival. */
+    service_queue_sum_t gap_sum;                                    /**< Sum of the inter-arrival ticks. */
+    service_queue_sum_t gap_sq_sum;                                 /**< Sum of the squared inter-arrival ticks. */
+} service_queue_stats_t;
+
+/**
+ * @brief   Merged queue statistics of a service.
+ */
+typedef struct
+{
+    uint32_t    hist[CONFIG_SERVICE_QUEUE_TUNE_BUCKETS];    /**< Arrivals by occupancy found. */
+    uint32_t    arrivals;                                   /**< Messages offered. */
+    uint32_t    full;                                       /**< Arrivals that found the queue full. */
+    uint32_t    peak;                                       /**< Highest occupancy found. */
+    uint64_t    occupancy_sum;                              /**< Sum of the occupancy found. */
+    uint64_t    gap_sum;                                    /**< Sum of the inter-arrival ticks. */
+    uint64_t    gap_sq_sum;                                 /**< Sum of the squared inter-arrival ticks. */
+} service_queue_merged_t;
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Queue statistics, indexed like the module_service section.
+ */
+static service_queue_stats_t service_queue_stats[CONFIG_SERVICE_QUEUE_TUNE_MAX];
+
+/**
+ * @brief   Get the statistics of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the statistics, or NULL if the service is not tracked.
+ */
+static service_queue_stats_t* service_queue_tune_stats(const service_t* svc)
+{
+    if (svc < module_service$$Base || svc >= module_service$$Limit ||
+        svc - module_service$$Base >= CONFIG_SERVICE_QUEUE_TUNE_MAX)
+    {
+        return NULL;
+    }
+
+    return &service_queue_stats[svc - module_service$$Base];
+}
+
+/**
+ * @brief   Add to a sum shared by the senders.
+ *
+ * The target has no 64 bits atomics. The add that wraps the low word
+ * is the one whose result is below what it added, it carries once.
+ *
+ * @param   sum Pointer to the sum.
+ * @param   value Value to add.
+ */
+static void service_queue_tune_add(service_queue_sum_t* sum, uint64_t value)
+{
+    uint32_t lo = (uint32_t)value;
+    uint32_t hi = (uint32_t)(value >> 32);
+
+    if (__atomic_add_fetch(&sum->lo, lo, __ATOMIC_RELAXED) < lo)
+    {
+        hi++;
+    }
+
+    if (hi)
+    {
+        (void)__atomic_add_fetch(&sum->hi, hi, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief   Read a sum shared by the senders.
+ *
+ * @param   sum Pointer to the sum.
+ *
+ * @retval  Returns the sum, a carry in flight shows at the next read.
+ */
+static uint64_t service_queue_tune_load(const service_queue_sum_t* sum)
+{
+    uint32_t hi;
+    uint32_t lo;
+
+    do
+    {
+        hi = __atomic_load_n(&sum->hi, __ATOMIC_RELAXED);
+        lo = __atomic_load_n(&sum->lo, __ATOMIC_RELAXED);
+    } while (hi != __atomic_load_n(&sum->hi, __ATOMIC_RELAXED));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief   Merge the statistics of every replica of a service.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   stats Output of the merged statistics.
+ * @param   queues Output of the number of queues merged.
+ *
+ * @retval  Returns the number of inter-arrival gaps in the sums, or -1 if a replica is not tracked.
+ */
+static int32_t service_queue_tune_merge(const object*            obj,
+                                        service_queue_merged_t* stats,
+                                        uint32_t*               queues)
+{
+    const service_t* svc = service_get_svc(obj);
+    const service_queue_stats_t* replica;
+    uint32_t gaps = 0;
+    uint32_t i, n;
+
+    (void)memset(stats, 0, sizeof(*stats));
+
+    *queues = SERVICE_REPLICA_COUNT(svc);
+
+    for (i = 0; i < *queues; i++)
+    {
+        replica = service_queue_tune_stats(&svc[i]);
+        if (!replica)
+        {
+            return -1;
+        }
+
+        for (n = 0; n < CONFIG_SERVICE_QUEUE_TUNE_BUCKETS; n++)
+        {
+            stats->hist[n] += replica->hist[n];
+        }
+
+        stats->arrivals += replica->arrivals;
+        stats->full += replica->full;
+        stats->peak = (replica->peak > stats->peak) ? replica->peak : stats->peak;
+        stats->occupancy_sum += service_queue_tune_load(&replica->occupancy_sum);
+        stats->gap_sum += service_queue_tune_load(&replica->gap_sum);
+        stats->gap_sq_sum += service_queue_tune_load(&replica->gap_sq_sum);
+
+        /* The first arrival of each queue has no gap. */
+        gaps += replica->arrivals ? replica->arrivals - 1 : 0;
+    }
+
+    return (int32_t)gaps;
+}
+
+/**
+ * @brief   Record an arrival on a service queue.
+ *
+ * Called by the service send path around osMessageQueuePut().
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   occupancy Messages in the queue before the put.
+ * @param   stat Status of the put.
+ *
+ * @ingroup Service_Queue_Tune
+ */
+void service_queue_tune_record(const service_t* svc,
+                               uint32_t         occupancy,
+                               osStatus_t       stat)
+{
+    service_queue_stats_t* stats = service_queue_tune_stats(svc);
+    const service_config_t* config;
+    uint32_t now = osKernelGetTickCount();
+    uint32_t last;
+    uint32_t gap;
+    uint32_t peak;
+
+    if (!stats || !svc->owner)
+    {
+        return;
+    }
+
+    config = (const service_config_t*)svc->owner->object_config;
+
+    if (stat != osOK && occupancy < config->msg_count)
+    {
+        occupancy = config->msg_count;
+    }
+
+    if (occupancy >= config->msg_count)
+    {
+        (void)__atomic_add_fetch(&stats->full, 1, __ATOMIC_RELAXED);
+    }
+
+    (void)__atomic_add_fetch(&stats->hist[(occupancy < CONFIG_SERVICE_QUEUE_TUNE_BUCKETS) ?
+                                          occupancy : CONFIG_SERVICE_QUEUE_TUNE_BUCKETS - 1],
+                             1,
+                             __ATOMIC_RELAXED);
+    service_queue_tune_add(&stats->occupancy_sum, occupancy);
+
+    peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+    while (occupancy > peak &&
+           !__atomic_compare_exchange_n(&stats->peak, &peak, occupancy, 1,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+    {
+    }
+
+    last = __atomic_exchange_n(&stats->last_tick, now, __ATOMIC_RELAXED);
+    if (__atomic_add_fetch(&stats->arrivals, 1, __ATOMIC_RELAXED) > 1)
+    {
+        gap = now - last;
+        service_queue_tune_add(&stats->gap_sum, gap);
+        service_queue_tune_add(&stats->gap_sq_sum, (uint64_t)gap * gap);
+    }
+}
+
+/**
+ * @brief   Size a queue from a geometric tail fitted to the histogram.
+ *
+ * P(occupancy >= n) = rho^n. Occupancies above top are cut off by the
+ * queue size, so rho is the censored estimate
+ * sum(min(occ, top)) / (sum(min(occ, top)) + arrivals finding less than top).
+ *
+ * @param   stats Pointer to the statistics.
+ * @param   top Highest occupancy that is measured exactly.
+ * @param   saturated Output set if the size hits the limit.
+ *
+ * @retval  Returns the queue size.
+ */
+static uint32_t service_queue_tune_fit(const service_queue_merged_t* stats,
+                                       uint32_t top,
+                                       uint8_t* saturated)
+{
+    uint64_t sum = 0;
+    uint64_t below = 0;
+    uint64_t rho_q16;
+    uint64_t tail_ppb = 1000000000ull;
+    uint32_t n;
+
+    for (n = 0; n < CONFIG_SERVICE_QUEUE_TUNE_BUCKETS; n++)
+    {
+        sum += (uint64_t)stats->hist[n] * ((n < top) ? n : top);
+        below += (n < top) ? stats->hist[n] : 0;
+    }
+
+    if (!sum)
+    {
+        return 0;
+    }
+
+    rho_q16 = (sum << 16) / (sum + below);
+
+    n = 0;
+    while (tail_ppb > CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM * 1000ull)
+    {
+        if (n >= CONFIG_SERVICE_QUEUE_TUNE_COUNT_MAX)
+        {
+            *saturated = 1;
+            break;
+        }
+
+        tail_ppb = (tail_ppb * rho_q16) >> 16;
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief   Get the queue load and sizing recommendation of a service.
+ *
+ * A replicated service gets one recommendation for the queue of each
+ * replica, ram_delta covers all of them.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   tune Output of the recommendation.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Queue_Tune
+ */
+int32_t service_queue_tune_get(const object* obj, service_queue_tune_t* tune)
+{
+    const service_config_t* config;
+    service_queue_merged_t merged;
+    const service_queue_merged_t* stats = &merged;
+    uint64_t allowed;
+    uint64_t tail = 0;
+    uint64_t cv2;
+    uint32_t queues;
+    uint32_t top;
+    int32_t gaps;
+    int32_t n;
+
+    if (!obj || !tune)
+    {
+        return -EINVAL;
+    }
+
+    gaps = service_queue_tune_merge(obj, &merged, &queues);
+    if (gaps < 0)
+    {
+        return -ENOENT;
+    }
+
+    config = (const service_config_t*)obj->object_config;
+
+    (void)memset(tune, 0, sizeof(*tune));
+    tune->arrivals = stats->arrivals;
+    tune->full = stats->full;
+    tune->peak = stats->peak;
+    tune->configured = config->msg_count;
+    tune->recommended = config->msg_count;
+
+    if (!stats->arrivals)
+    {
+        return 0;
+    }
+
+    tune->mean_x100 = (uint32_t)(stats->occupancy_sum * 100 / stats->arrivals);
+
+    if (gaps && stats->gap_sum)
+    {
+        /* cv2 = var / mean^2 = gaps * sum(gap^2) / sum(gap)^2 - 1. */
+        cv2 = (uint64_t)gaps * stats->gap_sq_sum * 100 / (stats->gap_sum * stats->gap_sum);
+        tune->cv2_x100 = (cv2 > 100) ? (uint32_t)(cv2 - 100) : 0;
+    }
+
+    /* Arrivals allowed to find the queue full, in millionths. */
+    allowed = (uint64_t)stats->arrivals * CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM;
+
+    tune->recommended = 0;
+    for (n = CONFIG_SERVICE_QUEUE_TUNE_BUCKETS - 1; n >= 0; n--)
+    {
+        tail += stats->hist[n];
+        if (tail * 1000000 > allowed)
+        {
+            tune->recommended = n + 1;
+            break;
+        }
+    }
+
+    top = (config->msg_count < CONFIG_SERVICE_QUEUE_TUNE_BUCKETS - 1) ?
+          config->msg_count : CONFIG_SERVICE_QUEUE_TUNE_BUCKETS - 1;
+
+    /* Cut off by a full queue, or fewer than 10 expected tail events. */
+    if (tune->recommended > top || allowed < 10 * 1000000ull)
+    {
+        n = (int32_t)service_queue_tune_fit(stats, top, &tune->saturated);
+        if ((uint32_t)n > tune->recommended)
+        {
+            tune->recommended = (uint32_t)n;
+        }
+    }
+
+    if (!tune->recommended)
+    {
+        tune->recommended = 1;
+    }
+
+    tune->ram_delta = ((int32_t)tune->recommended - (int32_t)config->msg_count) *
+                      (int32_t)sizeof(message_t) * (int32_t)queues;
+
+    return 0;
+}
+
+/**
+ * @brief   Clear the statistics of all services, e.g. after start up.
+ *
+ * @ingroup Service_Queue_Tune
+ */
+void service_queue_tune_reset(void)
+{
+    (void)memset(service_queue_stats, 0, sizeof(service_queue_stats));
+}
+
+/**
+ * @brief   Dump the queue load and recommendation of all services.
+ *
+ * @ingroup Service_Queue_Tune
+ */
+void service_queue_tune_dump(void)
+{
+    const service_t* svc;
+    service_queue_tune_t tune;
+    int32_t delta = 0;
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        /* The first handle covers the replicas. */
+        if (SERVICE_REPLICA_INDEX(svc) || !svc->owner || service_queue_tune_get(svc->owner, &tune))
+        {
+            continue;
+        }
+
+        pr_info("Service <%s> queue %u, arrivals %u, full %u, peak %u, "
+                "mean %u.%02u, cv2 %u.%02u, recommended %u%s.",
+                svc->owner->name,
+                tune.configured,
+                tune.arrivals,
+                tune.full,
+                tune.peak,
+                tune.mean_x100 / 100,
+                tune.mean_x100 % 100,
+                tune.cv2_x100 / 100,
+                tune.cv2_x100 % 100,
+                tune.recommended,
+                tune.saturated ? " (saturated)" : "");
+
+        delta += tune.ram_delta;
+    }
+
+    pr_info("Total queue RAM %s %d bytes.",
+            (delta > 0) ? "added" : "saved",
+            (delta > 0) ? delta : -delta);
+}
+
+/**
+ * @brief   Dump the recommended queue sizes as a C header.
+ *
+ * The output can be saved as a configuration header for the next build,
+ * one CONFIG_<SERVICE>_MSG_COUNT macro per service, the default of the
+ * msg_count of its configuration. Build with make SERVICE_CONF=<header>.
+ *
+ * @ingroup Service_Queue_Tune
+ */
+void service_queue_tune_dump_header(void)
+{
+    const service_t* svc;
+    service_queue_tune_t tune;
+    char macro[32];
+    int32_t delta = 0;
+    uint32_t i;
+
+    dbg_cli_output("/* Generated by service_queue_tune_dump_header(), "
+                   "target %u ppm. */\r\n",
+                   CONFIG_SERVICE_QUEUE_TUNE_DROP_PPM);
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        /* Replicas share the configuration, merged into the first one. */
+        if (SERVICE_REPLICA_INDEX(svc) || !svc->owner || service_queue_tune_get(svc->owner, &tune))
+        {
+            continue;
+        }
+
+        for (i = 0; svc->owner->name[i] && i < sizeof(macro) - 1; i++)
+        {
+            char c = svc->owner->name[i];
+
+            if (c >= 'a' && c <= 'z')
+            {
+                c = (char)(c - 'a' + 'A');
+            }
+            else if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')))
+            {
+                c = '_';
+            }
+
+            macro[i] = c;
+        }
+
+        macro[i] = '\0';
+
+        /* A truncated name would define a macro nobody reads. */
+        if (svc->owner->name[i])
+        {
+            dbg_cli_output("/* Service <%s> skipped, name longer than %u characters. */\r\n",
+                           svc->owner->name,
+                           (uint32_t)(sizeof(macro) - 1));
+            continue;
+        }
+
+        dbg_cli_output("#define CONFIG_%s_MSG_COUNT %u /* was %u, %+d bytes, "
+                       "arrivals %u, full %u, peak %u%s */\r\n",
+                       macro,
+                       tune.recommended,
+                       tune.configured,
+                       tune.ram_delta,
+                       tune.arrivals,
+                       tune.full,
+                       tune.peak,
+                       tune.saturated ? ", saturated" : "");
+
+        delta += tune.ram_delta;
+    }
+
+    dbg_cli_output("/* Queue RAM %+d bytes. */\r\n", delta);
+}
+
+#endif /* CONFIG_SERVICE_QUEUE_TUNE_ENABLE */
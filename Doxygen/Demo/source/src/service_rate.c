@@ -0,0 +1,523 @@
+/**
+ * @file source/src/service_rate.c
+ * @brief Definition the token-bucket rate limits on the send path.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_rate.h"
+
+#if CONFIG_SERVICE_RATE_ENABLE
+
+/**
+ * @defgroup Service_Rate Service Rate
+ *
+ * @brief Keep a runaway producer from flooding the service queues.
+ *
+ * A rate limiter is a token bucket on one message id, for any sender or
+ * for one sending service. service_broadcast_message(),
+ * service_unicast_message() and the payload variants take a token before
+ * queueing the message. Over the rate, the policy of the limiter decides:
+ *
+ * - SERVICE_RATE_DROP, the send fails with -EAGAIN.
+ * - SERVICE_RATE_DELAY, the sender sleeps until a token is back, and
+ *   fails with -EAGAIN if that is longer than the send timeout. Senders
+ *   in interrupt context never sleep.
+ * - SERVICE_RATE_COALESCE, the send succeeds and the message is held,
+ *   replacing the one held before for the same destination.
+ *   service_rate_poll() sends the held message once a token is back, a
+ *   newer message to the same destination sent in the meantime makes it
+ *   obsolete. A limiter holds one message, while it holds one for
+ *   another destination the send fails with -EAGAIN. Messages with a
+ *   payload, a request or a credit attached are refused instead.
+ *
+ * The bucket is a single tick word, taking a token is one CAS and no
+ * lock, so limits also apply to interrupts. Messages sent from an
+ * interrupt have no sending service and only match limiters for any
+ * sender. Signals are not limited, repeated signals coalesce already.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+/* State of the held message. */
+#define SERVICE_RATE_HELD_EMPTY 0
+#define SERVICE_RATE_HELD_BUSY  1
+#define SERVICE_RATE_HELD_FULL  2
+#endif
+
+/**
+ * @brief   Limiters.
+ */
+static service_rate_t* service_rate_limiters[CONFIG_SERVICE_RATE_MAX];
+
+/**
+ * @brief   Bit (id % 32) is set if a limiter may exist for the message id.
+ *
+ * Keeps the send path of unlimited ids to one load and one test.
+ */
+static uint32_t service_rate_filter;
+
+/**
+ * @brief   Initialize a rate limiter.
+ *
+ * The bucket starts full, the first burst messages go through at once.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   config Limiter configuration.
+ *
+ * @retval  Returns 0 on success, -ENOSPC if all limiters are used,
+ *          -ERANGE if the period is too long, negative error code otherwise.
+ *
+ * @ingroup Service_Rate
+ */
+int32_t service_rate_init(service_rate_t* limiter, const service_rate_config_t* config)
+{
+    service_rate_t* expected;
+    uint64_t interval;
+    uint64_t tolerance;
+    uint64_t horizon;
+    uint32_t freq;
+    uint32_t burst;
+    uint32_t i;
+
+    if (!limiter || !config || !config->rate || !config->period_ms ||
+        config->policy > SERVICE_RATE_COALESCE)
+    {
+        return -EINVAL;
+    }
+
+    freq = osKernelGetTickFreq();
+    burst = config->burst ? config->burst : 1;
+
+    /* The tick is the resolution, a faster rate is a burst per tick. */
+    interval = (uint64_t)config->period_ms * freq / 1000 / config->rate;
+    interval = interval ? interval : 1;
+    tolerance = interval * (burst - 1);
+
+    /* A delayed sender reserves its token, up to the send timeout ahead. */
+    horizon = tolerance + interval + CONFIG_MSG_SEND_BLOCK_TIMEOUT_MS * freq / 1000;
+    if (horizon > INT32_MAX)
+    {
+        return -ERANGE;
+    }
+
+    (void)memset(limiter, 0, sizeof(*limiter));
+    limiter->id = config->id & ~MSG_ID_FLAGS_MASK;
+    limiter->sender = config->sender;
+    limiter->policy = config->policy;
+    limiter->interval = (uint32_t)interval;
+    limiter->tolerance = (uint32_t)tolerance;
+    limiter->horizon = (uint32_t)horizon;
+    limiter->tat = osKernelGetTickCount();
+
+    for (i = 0; i < CONFIG_SERVICE_RATE_MAX; i++)
+    {
+        expected = NULL;
+        limiter->index = i;
+
+        if (__atomic_compare_exchange_n(&service_rate_limiters[i], &expected, limiter, 0,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        {
+            (void)__atomic_fetch_or(&service_rate_filter,
+                                    1u << (limiter->id & 31),
+                                    __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+
+    return -ENOSPC;
+}
+
+/**
+ * @brief   Deinitialize a rate limiter.
+ *
+ * A held message is dropped. The limiter must not be in use by a sender.
+ *
+ * @param   limiter Pointer to the limiter.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Rate
+ */
+int32_t service_rate_deinit(service_rate_t* limiter)
+{
+    if (!limiter || limiter->index >= CONFIG_SERVICE_RATE_MAX ||
+        service_rate_limiters[limiter->index] != limiter)
+    {
+        return -EINVAL;
+    }
+
+    /* The filter bit stays, it may be shared and a stale bit only costs a lookup. */
+    __atomic_store_n(&service_rate_limiters[limiter->index], NULL, __ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n(&limiter->held, SERVICE_RATE_HELD_EMPTY, __ATOMIC_ACQUIRE) ==
+        SERVICE_RATE_HELD_FULL)
+    {
+        service_message_discard(&limiter->held_msg);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Find the limiter of a message sent by the calling thread.
+ *
+ * @param   id Message id, without flags.
+ *
+ * @retval  Returns the limiter of the calling service, else the limiter
+ *          for any sender, NULL if the message id is not limited.
+ */
+static service_rate_t* service_rate_find(uint32_t id)
+{
+    service_rate_t* limiter;
+    service_rate_t* any = NULL;
+    const service_t* current;
+    const object* sender = NULL;
+    int32_t resolved = 0;
+    uint32_t i;
+
+    if (!(__atomic_load_n(&service_rate_filter, __ATOMIC_ACQUIRE) & (1u << (id & 31))))
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < CONFIG_SERVICE_RATE_MAX; i++)
+    {
+        limiter = __atomic_load_n(&service_rate_limiters[i], __ATOMIC_ACQUIRE);
+        if (!limiter || limiter->id != id)
+        {
+            continue;
+        }
+
+        if (!limiter->sender)
+        {
+            any = any ? any : limiter;
+            continue;
+        }
+
+        /* Looking the calling service up scans the services, only do it once and if needed. */
+        if (!resolved)
+        {
+            current = service_get_current();
+            sender = current ? current->owner : NULL;
+            resolved = 1;
+        }
+
+        if (limiter->sender == sender)
+        {
+            return limiter;
+        }
+    }
+
+    return any;
+}
+
+/**
+ * @brief   Get the bucket state of a limiter.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   tat Theoretical arrival time read from the limiter.
+ * @param   base Returns the arrival time the next token is counted from.
+ *
+ * @retval  Returns the ticks until a token is available, 0 if one is.
+ */
+static uint32_t service_rate_wait(const service_rate_t* limiter, uint32_t tat, uint32_t* base)
+{
+    uint32_t now = osKernelGetTickCount();
+    int32_t ahead = (int32_t)(tat - now);
+
+    /* In the past, or farther ahead than any sender can push it, the bucket is full. */
+    if (ahead < 0 || ahead > (int32_t)limiter->horizon)
+    {
+        *base = now;
+        return 0;
+    }
+
+    *base = tat;
+
+    return (uint32_t)ahead > limiter->tolerance ? (uint32_t)ahead - limiter->tolerance : 0;
+}
+
+/**
+ * @brief   Take a token.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   timeout Ticks the caller may wait for the token.
+ * @param   wait Returns the ticks to wait before the token is valid.
+ *
+ * @retval  Returns 0 on success, -EAGAIN if the token is further than timeout.
+ */
+static int32_t service_rate_take(service_rate_t* limiter, uint32_t timeout, uint32_t* wait)
+{
+    uint32_t tat = __atomic_load_n(&limiter->tat, __ATOMIC_RELAXED);
+    uint32_t base;
+
+    do
+    {
+        *wait = service_rate_wait(limiter, tat, &base);
+        if (*wait > timeout)
+        {
+            return -EAGAIN;
+        }
+    } while (!__atomic_compare_exchange_n(&limiter->tat, &tat, base + limiter->interval, 1,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+
+    return 0;
+}
+
+/**
+ * @brief   Take the held message slot of a limiter for one destination.
+ *
+ * An empty slot is taken. A slot holding a message with the same id to
+ * the same destination is taken and that message discarded, it is
+ * obsolete. A message to another destination stays held.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   svc Destination service, NULL for a broadcast.
+ * @param   id Message id, without the framework flags.
+ *
+ * @retval  Returns 0 with the slot busy, -EBUSY if it is held for another
+ *          destination or another thread is on it.
+ */
+static int32_t service_rate_claim(service_rate_t*   limiter,
+                                  const service_t*  svc,
+                                  uint32_t          id)
+{
+    uint32_t state = __atomic_load_n(&limiter->held, __ATOMIC_RELAXED);
+
+    do
+    {
+        if (state == SERVICE_RATE_HELD_BUSY)
+        {
+            return -EBUSY;
+        }
+    } while (!__atomic_compare_exchange_n(&limiter->held, &state, SERVICE_RATE_HELD_BUSY, 1,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED));
+
+    if (state == SERVICE_RATE_HELD_FULL)
+    {
+        if (limiter->held_svc != svc || limiter->held_msg.id != id)
+        {
+            __atomic_store_n(&limiter->held, SERVICE_RATE_HELD_FULL, __ATOMIC_RELEASE);
+            return -EBUSY;
+        }
+
+        service_message_discard(&limiter->held_msg);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Hold a message over the rate, replacing the one held before for the same destination.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   svc Destination service, NULL for a broadcast.
+ * @param   message Message to hold, without framework flags.
+ *
+ * @retval  Returns 0 on success, -EBUSY if a message to another
+ *          destination is held or another thread is on the held message.
+ */
+static int32_t service_rate_hold(service_rate_t*    limiter,
+                                 const service_t*   svc,
+                                 const message_t*   message)
+{
+    if (service_rate_claim(limiter, svc, message->id))
+    {
+        return -EBUSY;
+    }
+
+    limiter->held_svc = svc;
+    limiter->held_msg = *message;
+
+    __atomic_store_n(&limiter->held, SERVICE_RATE_HELD_FULL, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief   Apply the rate limit of a message about to be sent.
+ *
+ * Called by the send functions, after the interceptors and before the
+ * message is queued.
+ *
+ * @param   svc Destination service, NULL for a broadcast.
+ * @param   message Message to send.
+ * @param   timeout Send timeout in ticks, 0 in interrupt context.
+ *
+ * @retval  Returns 0 to send the message, SERVICE_RATE_HELD if the limiter
+ *          keeps it for later, -EAGAIN if it is over the rate.
+ *
+ * @ingroup Service_Rate
+ */
+int32_t service_rate_check(const service_t* svc,
+                           const message_t* message,
+                           uint32_t timeout)
+{
+    service_rate_t* limiter;
+    uint32_t wait;
+
+    if (!message)
+    {
+        return -EINVAL;
+    }
+
+    limiter = service_rate_find(message->id & ~MSG_ID_FLAGS_MASK);
+    if (!limiter)
+    {
+        return 0;
+    }
+
+    if (limiter->policy != SERVICE_RATE_DELAY)
+    {
+        timeout = 0;
+    }
+
+    if (!service_rate_take(limiter, timeout, &wait))
+    {
+        /* This message is newer than the one held for the same destination. */
+        if (__atomic_load_n(&limiter->held, __ATOMIC_RELAXED) == SERVICE_RATE_HELD_FULL &&
+            !service_rate_claim(limiter, svc, message->id & ~MSG_ID_FLAGS_MASK))
+        {
+            __atomic_store_n(&limiter->held, SERVICE_RATE_HELD_EMPTY, __ATOMIC_RELEASE);
+        }
+
+        if (wait)
+        {
+            (void)osDelay(wait);
+            (void)__atomic_add_fetch(&limiter->stats.delayed, 1, __ATOMIC_RELAXED);
+        }
+
+        (void)__atomic_add_fetch(&limiter->stats.accepted, 1, __ATOMIC_RELAXED);
+
+        return 0;
+    }
+
+    /* A held message would keep its payload, request or credit for an unknown time. */
+    if (limiter->policy == SERVICE_RATE_COALESCE &&
+        !(message->id & MSG_ID_FLAGS_MASK) &&
+        !service_rate_hold(limiter, svc, message))
+    {
+        (void)__atomic_add_fetch(&limiter->stats.coalesced, 1, __ATOMIC_RELAXED);
+
+        return SERVICE_RATE_HELD;
+    }
+
+    (void)__atomic_add_fetch(&limiter->stats.rejected, 1, __ATOMIC_RELAXED);
+
+    return -EAGAIN;
+}
+
+/**
+ * @brief   Send the held messages whose limiter has a token back.
+ *
+ * Call periodically, for example from a timer or the idle thread, with
+ * a period close to the shortest limiter interval. Not from interrupts.
+ *
+ * @ingroup Service_Rate
+ */
+void service_rate_poll(void)
+{
+    service_rate_t* limiter;
+    const service_t* svc;
+    message_t message;
+    uint32_t expected;
+    uint32_t base;
+    uint32_t wait;
+    uint32_t i;
+
+    for (i = 0; i < CONFIG_SERVICE_RATE_MAX; i++)
+    {
+        limiter = __atomic_load_n(&service_rate_limiters[i], __ATOMIC_ACQUIRE);
+        if (!limiter || __atomic_load_n(&limiter->held, __ATOMIC_ACQUIRE) != SERVICE_RATE_HELD_FULL)
+        {
+            continue;
+        }
+
+        /*
+         * The send below takes the token of a limiter for any sender. A
+         * limiter of one sender does not match this thread, take it here.
+         */
+        if (limiter->sender)
+        {
+            if (service_rate_take(limiter, 0, &wait))
+            {
+                continue;
+            }
+        }
+        else if (service_rate_wait(limiter, __atomic_load_n(&limiter->tat, __ATOMIC_RELAXED), &base))
+        {
+            continue;
+        }
+
+        expected = SERVICE_RATE_HELD_FULL;
+        if (!__atomic_compare_exchange_n(&limiter->held, &expected, SERVICE_RATE_HELD_BUSY, 0,
+                                         __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED))
+        {
+            continue;
+        }
+
+        svc = limiter->held_svc;
+        message = limiter->held_msg;
+
+        __atomic_store_n(&limiter->held, SERVICE_RATE_HELD_EMPTY, __ATOMIC_RELEASE);
+
+        if (svc)
+        {
+            (void)service_unicast_message(svc, &message);
+        }
+        else
+        {
+            (void)service_broadcast_message(&message);
+        }
+    }
+}
+
+/**
+ * @brief   Get the statistics of a rate limiter.
+ *
+ * @param   limiter Pointer to the limiter.
+ * @param   stats Returns the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Rate
+ */
+int32_t service_rate_get_stats(const service_rate_t* limiter,
+                               service_rate_stats_t* stats)
+{
+    if (!limiter || !stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = limiter->stats;
+
+    return 0;
+}
+
+#endif /* CONFIG_SERVICE_RATE_ENABLE */
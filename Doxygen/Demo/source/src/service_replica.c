@@ -0,0 +1,186 @@
+/**
+ * @file source/src/service_replica.c
+ * @brief Definition the sharded service replicas.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framework.h"
+#include "service_replica.h"
+
+#if CONFIG_SERVICE_REPLICA_ENABLE
+
+/**
+ * @defgroup Service_Replica Service Replica
+ *
+ * @brief Scale one service over several threads and cores.
+ *
+ * A service declared with DECLARE_SERVICE_REPLICATED() runs one thread
+ * and one queue per replica. The replicas are consecutive entries of the
+ * module_service section, so each one has its own stack, watchdog,
+ * queue statistics and core placement, while the object stays single.
+ *
+ * A unicast picks the replica by hashing the message parameter named by
+ * service_config_t::shard_key, so all the messages with the same key go
+ * through the same queue in order. A broadcast reaches the replica of its
+ * key, or every replica with SERVICE_FLAG_BROADCAST_ALL. Signals raised
+ * with service_unicast_signal() go to the first replica. A message sent
+ * to a replica other than the first, see service_replica_get(), skips
+ * the hash and stays on that replica.
+ *
+ * The handlers of all replicas share the private data and may run at
+ * the same time, they must protect shared state themselves. Replicas
+ * need thread stacks and queues allocated by the RTOS, and cannot be
+ * exported to shared memory.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Get the configuration of a replica set.
+ *
+ * @param   base Pointer to the first replica.
+ *
+ * @retval  Returns the configuration, or NULL before the probe.
+ */
+static const service_config_t* service_replica_config(const service_t* base)
+{
+    if (!base->owner)
+    {
+        return NULL;
+    }
+
+    return (const service_config_t*)base->owner->object_config;
+}
+
+/**
+ * @brief   Get the replica handling a message.
+ *
+ * @param   svc Pointer to any replica of the service.
+ * @param   message Message to route, NULL for the first replica.
+ *
+ * @retval  Returns the replica, svc itself if the service is not replicated
+ *          or svc is a replica other than the first.
+ *
+ * @ingroup Service_Replica
+ */
+const service_t* service_replica_select(const service_t* svc, const message_t* message)
+{
+    const service_config_t* config;
+    uint32_t key;
+
+    /* Only the logical handle is hashed, a replica picked by index keeps the message. */
+    if (!svc || svc->replicas < 2 || svc->replica)
+    {
+        return svc;
+    }
+
+    config = service_replica_config(svc);
+    if (!config || !message)
+    {
+        return svc;
+    }
+
+    switch (config->shard_key)
+    {
+    case SERVICE_SHARD_KEY_PARAM1:
+        key = message->param1;
+        break;
+    case SERVICE_SHARD_KEY_PARAM2:
+        key = message->param2;
+        break;
+    case SERVICE_SHARD_KEY_PARAM3:
+        key = message->param3;
+        break;
+    default:
+        key = message->param0;
+        break;
+    }
+
+    /* Fibonacci hashing spreads sequential keys, the multiply maps it without a division. */
+    key *= 0x9E3779B1u;
+
+    return &svc[((uint64_t)key * svc->replicas) >> 32];
+}
+
+/**
+ * @brief   Enumerate the replicas a broadcast reaches.
+ *
+ * Only the first replica fans out, so a scan of the module_service
+ * section delivers each broadcast once per service.
+ *
+ * @param   svc Pointer to a service.
+ * @param   message Message broadcast.
+ * @param   n Destination index, from 0.
+ *
+ * @retval  Returns the n-th destination, or NULL when done.
+ *
+ * @ingroup Service_Replica
+ */
+const service_t* service_replica_fanout(const service_t* svc,
+                                        const message_t* message,
+                                        uint32_t n)
+{
+    const service_config_t* config;
+
+    if (!svc || svc->replicas < 2)
+    {
+        return n ? NULL : svc;
+    }
+
+    if (svc->replica)
+    {
+        return NULL;
+    }
+
+    config = service_replica_config(svc);
+    if (config && (config->flags & SERVICE_FLAG_BROADCAST_ALL))
+    {
+        return n < svc->replicas ? &svc[n] : NULL;
+    }
+
+    return n ? NULL : service_replica_select(svc, message);
+}
+
+/**
+ * @brief   Get a replica by index.
+ *
+ * @param   svc Pointer to any replica of the service.
+ * @param   index Replica index.
+ *
+ * @retval  Returns the replica, or NULL if the index is out of range.
+ *
+ * @ingroup Service_Replica
+ */
+const service_t* service_replica_get(const service_t* svc, uint32_t index)
+{
+    if (!svc)
+    {
+        return NULL;
+    }
+
+    if (svc->replicas < 2)
+    {
+        return index ? NULL : svc;
+    }
+
+    return index < svc->replicas ? svc - svc->replica + index : NULL;
+}
+
+#endif /* CONFIG_SERVICE_REPLICA_ENABLE */
@@ -0,0 +1,610 @@
+/**
+ * @file source/src/service_request.c
+ * @brief Definition the service request/response.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_replica.h"
+#include "service_request.h"
+
+#if CONFIG_SERVICE_REQUEST_ENABLE
+
+/**
+ * @defgroup Service_Request Service Request
+ *
+ * @brief Request/response calls between services.
+ *
+ * A request is a unicast message flagged with MSG_ID_FLAG_REQUEST and a
+ * correlation tag. The tag selects a slot in the request table, where the
+ * reply is stored for the caller. While a request is outstanding the
+ * responder thread runs at least at the caller's priority, so a medium
+ * priority thread cannot starve it. The responder returns to its own
+ * priority when its last outstanding request completes.
+ *
+ * A request that is dropped, or that the handler returns from without
+ * replying or deferring, completes with -EPIPE. Requests stay within
+ * this processor, services behind a transport are not supported.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+#define SERVICE_REQUEST_FREE    0
+#define SERVICE_REQUEST_PENDING 1
+#define SERVICE_REQUEST_DONE    2
+
+/* Tags are gen * CONFIG_SERVICE_REQUEST_MAX + slot, never 0. */
+#define SERVICE_REQUEST_TAG_NUM (MSG_ID_REQUEST_TAG_MASK >> MSG_ID_REQUEST_TAG_SHIFT)
+#define SERVICE_REQUEST_GEN_NUM (SERVICE_REQUEST_TAG_NUM / CONFIG_SERVICE_REQUEST_MAX)
+
+_Static_assert(SERVICE_REQUEST_GEN_NUM >= 2, "CONFIG_SERVICE_REQUEST_MAX is too large");
+#endif
+
+/**
+ * @brief   Request slot structure.
+ */
+typedef struct
+{
+    uint32_t            tag;        /**< Correlation tag, 0 if the slot is free. */
+    uint32_t            state;      /**< SERVICE_REQUEST_xxx. */
+    osThreadId_t        caller;     /**< Thread waiting for the response, or NULL. */
+    service_t*          responder;  /**< Service lending the caller's priority. */
+    service_response_fn cb;         /**< Response callback, or NULL for a future. */
+    void*               arg;        /**< Callback argument. */
+    int32_t             status;     /**< Completion status. */
+    message_t           response;   /**< Response message. */
+} service_request_slot_t;
+
+/**
+ * @brief   Request table.
+ */
+static service_request_slot_t service_request_slots[CONFIG_SERVICE_REQUEST_MAX];
+
+/**
+ * @brief   Last tag generation.
+ */
+static uint32_t service_request_gen;
+
+/**
+ * @brief   Lock of the request table and the inherited priorities.
+ */
+static osMutexId_t service_request_mutex;
+
+/**
+ * @brief   Get the slot of a tag.
+ *
+ * @param   tag Correlation tag.
+ *
+ * @retval  Returns the slot, or NULL if the tag is not outstanding.
+ */
+static service_request_slot_t* service_request_find(uint32_t tag)
+{
+    service_request_slot_t* slot;
+
+    if (!tag || tag >= SERVICE_REQUEST_TAG_NUM)
+    {
+        return NULL;
+    }
+
+    slot = &service_request_slots[tag % CONFIG_SERVICE_REQUEST_MAX];
+
+    return (slot->tag == tag) ? slot : NULL;
+}
+
+/**
+ * @brief   Lend a priority to the responder thread.
+ *
+ * @param   svc Pointer to the responder service handle.
+ * @param   priority Priority of the caller.
+ */
+static void service_request_inherit(service_t* svc, osPriority_t priority)
+{
+    osPriority_t current = osThreadGetPriority(svc->thread_id);
+
+    if (!svc->inherit_count++)
+    {
+        svc->base_priority = current;
+    }
+
+    if (priority > current)
+    {
+        (void)osThreadSetPriority(svc->thread_id, priority);
+    }
+}
+
+/**
+ * @brief   Return a lent priority.
+ *
+ * The responder keeps the highest lent priority until its last
+ * outstanding request completes.
+ *
+ * @param   svc Pointer to the responder service handle.
+ */
+static void service_request_disinherit(service_t* svc)
+{
+    if (svc->inherit_count && !--svc->inherit_count)
+    {
+        (void)osThreadSetPriority(svc->thread_id, svc->base_priority);
+    }
+}
+
+/**
+ * @brief   Free a slot and return its lent priority, with the lock held.
+ *
+ * @param   slot Pointer to the slot.
+ */
+static void service_request_free(service_request_slot_t* slot)
+{
+    if (slot->state == SERVICE_REQUEST_PENDING)
+    {
+        service_request_disinherit(slot->responder);
+    }
+
+    slot->tag = 0;
+    slot->state = SERVICE_REQUEST_FREE;
+}
+
+/**
+ * @brief   Create the request table lock.
+ *
+ * @param   obj Pointer to the request object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_request_probe(const object* obj)
+{
+    static const osMutexAttr_t attr =
+    {
+        .name       = "service_request",
+        .attr_bits  = 0,
+    };
+
+    service_request_mutex = osMutexNew(&attr);
+    if (!service_request_mutex)
+    {
+        pr_error("Object <%s> create mutex failed.", obj->name);
+        return -ENOMEM;
+    }
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+/**
+ * @brief   Send a request without waiting for the response.
+ *
+ * With a callback, the callback gets the response and the handle is
+ * freed after it returns. Without one, the handle is a future that must
+ * be collected by service_request_wait() or service_request_cancel().
+ * Several requests can be outstanding at once to pipeline them.
+ *
+ * @param   svc Pointer to the responder service handle.
+ * @param   request Request message.
+ * @param   cb Response callback, or NULL.
+ * @param   arg Callback argument.
+ *
+ * @retval  Returns the positive request handle, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request_async(const service_t*      svc,
+                              const message_t*      request,
+                              service_response_fn   cb,
+                              void*                 arg)
+{
+    service_request_slot_t* slot = NULL;
+    const service_t* responder;
+    osThreadId_t caller;
+    message_t msg;
+    uint32_t tag;
+    uint32_t i;
+    int32_t ret;
+
+    if (!svc || !request || (request->id & MSG_ID_FLAGS_MASK))
+    {
+        return -EINVAL;
+    }
+
+    if (SERVICE_TRANSPORT(svc))
+    {
+        return -ENOSUPPORT;
+    }
+
+    if (xPortIsInsideInterrupt())
+    {
+        return -EPERM;
+    }
+
+    /* The replica the unicast will pick is the one to lend the priority to. */
+    responder = SERVICE_REPLICA_SELECT(svc, request);
+
+    caller = osThreadGetId();
+    if (caller == responder->thread_id)
+    {
+        return -EBUSY;
+    }
+
+    (void)osMutexAcquire(service_request_mutex, osWaitForever);
+
+    for (i = 0; i < CONFIG_SERVICE_REQUEST_MAX; i++)
+    {
+        if (service_request_slots[i].state == SERVICE_REQUEST_FREE)
+        {
+            slot = &service_request_slots[i];
+            break;
+        }
+    }
+
+    if (!slot)
+    {
+        (void)osMutexRelease(service_request_mutex);
+        return -EBUSY;
+    }
+
+    if (++service_request_gen >= SERVICE_REQUEST_GEN_NUM)
+    {
+        service_request_gen = 1;
+    }
+
+    tag = service_request_gen * CONFIG_SERVICE_REQUEST_MAX + i;
+
+    slot->tag = tag;
+    slot->state = SERVICE_REQUEST_PENDING;
+    slot->caller = cb ? NULL : caller;
+    slot->responder = (service_t*)responder;
+    slot->cb = cb;
+    slot->arg = arg;
+    slot->status = 0;
+
+    service_request_inherit(slot->responder, osThreadGetPriority(caller));
+
+    (void)osMutexRelease(service_request_mutex);
+
+    msg = *request;
+    msg.id |= MSG_ID_FLAG_REQUEST | (tag << MSG_ID_REQUEST_TAG_SHIFT);
+
+    ret = service_unicast_message(svc, &msg);
+    if (ret)
+    {
+        (void)osMutexAcquire(service_request_mutex, osWaitForever);
+        if (slot->tag == tag)
+        {
+            service_request_free(slot);
+        }
+        (void)osMutexRelease(service_request_mutex);
+
+        return ret;
+    }
+
+    return (int32_t)tag;
+}
+
+/**
+ * @brief   Wait for the response of a request sent without a callback.
+ *
+ * The handle is freed when the function returns, a request that is not
+ * answered in time is cancelled.
+ *
+ * @param   handle Request handle.
+ * @param   response Output of the response message, may be NULL.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the status passed by the responder, -ETIMEOUT on
+ *          timeout, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request_wait(int32_t handle, message_t* response, uint32_t timeout)
+{
+    service_request_slot_t* slot;
+    uint32_t start = osKernelGetTickCount();
+    uint32_t elapsed;
+    int32_t ret;
+
+    while (1)
+    {
+        (void)osMutexAcquire(service_request_mutex, osWaitForever);
+
+        slot = service_request_find((uint32_t)handle);
+        if (!slot || slot->cb)
+        {
+            (void)osMutexRelease(service_request_mutex);
+            return -EINVAL;
+        }
+
+        if (slot->state == SERVICE_REQUEST_DONE)
+        {
+            if (response)
+            {
+                *response = slot->response;
+            }
+
+            ret = slot->status;
+            service_request_free(slot);
+            (void)osMutexRelease(service_request_mutex);
+
+            return ret;
+        }
+
+        elapsed = osKernelGetTickCount() - start;
+        if (timeout != osWaitForever && elapsed >= timeout)
+        {
+            service_request_free(slot);
+            (void)osMutexRelease(service_request_mutex);
+
+            return -ETIMEOUT;
+        }
+
+        slot->caller = osThreadGetId();
+
+        (void)osMutexRelease(service_request_mutex);
+
+        /* A stale flag from a cancelled request only costs one more pass. */
+        (void)osThreadFlagsWait(SERVICE_THREAD_FLAG_RESPONSE,
+                                osFlagsWaitAny,
+                                (timeout == osWaitForever) ? osWaitForever :
+                                timeout - elapsed);
+    }
+}
+
+/**
+ * @brief   Send a request and wait for the response.
+ *
+ * @param   svc Pointer to the responder service handle.
+ * @param   request Request message.
+ * @param   response Output of the response message, may be NULL.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the status passed by the responder, -ETIMEOUT on
+ *          timeout, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request(const service_t*    svc,
+                        const message_t*    request,
+                        message_t*          response,
+                        uint32_t            timeout)
+{
+    int32_t handle;
+
+    handle = service_request_async(svc, request, NULL, NULL);
+    if (handle < 0)
+    {
+        return handle;
+    }
+
+    return service_request_wait(handle, response, timeout);
+}
+
+/**
+ * @brief   Cancel an outstanding request.
+ *
+ * A later reply to the request is ignored.
+ *
+ * @param   handle Request handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request_cancel(int32_t handle)
+{
+    service_request_slot_t* slot;
+
+    (void)osMutexAcquire(service_request_mutex, osWaitForever);
+
+    slot = service_request_find((uint32_t)handle);
+    if (!slot)
+    {
+        (void)osMutexRelease(service_request_mutex);
+        return -EINVAL;
+    }
+
+    service_request_free(slot);
+
+    (void)osMutexRelease(service_request_mutex);
+
+    return 0;
+}
+
+/**
+ * @brief   Complete a request.
+ *
+ * Used by the reply functions and by the service dispatch when a
+ * request is discarded.
+ *
+ * @param   tag Correlation tag.
+ * @param   response Response message, or NULL on error.
+ * @param   status Completion status.
+ *
+ * @retval  Returns 0 on success, -ENOENT if the request is no longer outstanding.
+ */
+int32_t service_request_complete(uint32_t           tag,
+                                 const message_t*   response,
+                                 int32_t            status)
+{
+    service_request_slot_t* slot;
+    service_response_fn cb;
+    message_t msg;
+    osThreadId_t caller;
+    void* arg;
+
+    if (response)
+    {
+        msg = *response;
+    }
+    else
+    {
+        (void)memset(&msg, 0, sizeof(msg));
+    }
+
+    (void)osMutexAcquire(service_request_mutex, osWaitForever);
+
+    slot = service_request_find(tag);
+    if (!slot || slot->state != SERVICE_REQUEST_PENDING)
+    {
+        (void)osMutexRelease(service_request_mutex);
+        return -ENOENT;
+    }
+
+    service_request_disinherit(slot->responder);
+
+    cb = slot->cb;
+    arg = slot->arg;
+    caller = slot->caller;
+
+    if (cb)
+    {
+        slot->tag = 0;
+        slot->state = SERVICE_REQUEST_FREE;
+    }
+    else
+    {
+        slot->response = msg;
+        slot->status = status;
+        slot->state = SERVICE_REQUEST_DONE;
+    }
+
+    (void)osMutexRelease(service_request_mutex);
+
+    if (cb)
+    {
+        cb((int32_t)tag, &msg, status, arg);
+    }
+    else if (caller)
+    {
+        (void)osThreadFlagsSet(caller, SERVICE_THREAD_FLAG_RESPONSE);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Reply to the request being handled.
+ *
+ * Call from the message handler of the responder.
+ *
+ * @param   obj Pointer to the responder service object handle.
+ * @param   response Response message.
+ *
+ * @retval  Returns 0 on success, -EPERM outside the handler of obj, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_reply(const object* obj, const message_t* response)
+{
+    service_t* svc;
+    uint32_t tag;
+
+    if (!obj || !response)
+    {
+        return -EINVAL;
+    }
+
+    /* The replica handling the request, not the first one. */
+    svc = service_get_current();
+    if (!svc || svc->owner != obj)
+    {
+        return -EPERM;
+    }
+
+    tag = svc->request;
+    if (!tag)
+    {
+        return -ENOENT;
+    }
+
+    svc->request = 0;
+
+    return service_request_complete(tag, response, 0);
+}
+
+/**
+ * @brief   Keep the request being handled open after the handler returns.
+ *
+ * The responder answers later with service_request_reply(). The caller
+ * keeps lending its priority until then.
+ *
+ * @param   obj Pointer to the responder service object handle.
+ *
+ * @retval  Returns the request handle, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request_defer(const object* obj)
+{
+    service_t* svc;
+    uint32_t tag;
+
+    if (!obj)
+    {
+        return -EINVAL;
+    }
+
+    svc = service_get_current();
+    if (!svc || svc->owner != obj)
+    {
+        return -EPERM;
+    }
+
+    tag = svc->request;
+    if (!tag)
+    {
+        return -ENOENT;
+    }
+
+    svc->request = 0;
+
+    return (int32_t)tag;
+}
+
+/**
+ * @brief   Reply to a deferred request.
+ *
+ * @param   handle Handle returned by service_request_defer().
+ * @param   response Response message.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Request
+ */
+int32_t service_request_reply(int32_t handle, const message_t* response)
+{
+    if (handle <= 0 || !response)
+    {
+        return -EINVAL;
+    }
+
+    return service_request_complete((uint32_t)handle, response, 0);
+}
+
+module_core("request",
+            request,
+            service_request_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_REQUEST_ENABLE */
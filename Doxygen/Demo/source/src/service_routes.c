@@ -0,0 +1,221 @@
+/**
+ * @file source/src/service_routes.c
+ * @brief Definition the build-time service routing tables.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framework.h"
+#include "service_routes.h"
+
+#if CONFIG_SERVICE_ROUTES_ENABLE
+
+/**
+ * @defgroup Service_Routes Service Routes
+ *
+ * @brief Static routing tables generated from the service declarations.
+ *
+ * Each service lists the message ids it consumes and produces with
+ * SERVICE_CONSUMES() and SERVICE_PRODUCES(). Building with ROUTES=y runs
+ * scripts/gen_routes.py over the sources, which generates one sorted
+ * table mapping each consumed id to its destination services, and a
+ * Graphviz graph of the message flow for the documentation. The build
+ * fails on an id that is produced but consumed by no service.
+ *
+ * Broadcasts then look the id up and only queue the message to its
+ * consumers, instead of to every service. Services without any
+ * SERVICE_CONSUMES() are wildcards, they appear in every route and
+ * receive the ids missing from the table as well.
+ *
+ * The script only sees the services under ROUTE_DIRS. The core level of
+ * object_init() checks that every linked service is in the tables and
+ * fails on one that is not, it would receive no broadcast at all.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Check if a service is in a destination list.
+ *
+ * @param   list NULL terminated destination list.
+ * @param   svc Pointer to the first handle of the service.
+ *
+ * @retval  Returns non-zero if the service is in the list.
+ */
+static int32_t service_routes_contain(service_t* const* list, const service_t* svc)
+{
+    for (; *list; list++)
+    {
+        if (*list == svc)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Get the name of a service before its object initialized it.
+ *
+ * @param   svc Pointer to the first handle of the service.
+ *
+ * @retval  Returns the service name, "" if no object owns the handle.
+ */
+static const char* service_routes_name(const service_t* svc)
+{
+    extern object module_object_3$$Base[];
+    extern object module_object_3$$Limit[];
+
+    const object* entry;
+
+    for (entry = module_object_3$$Base; entry < module_object_3$$Limit; entry++)
+    {
+        if (entry->object_data == svc)
+        {
+            return entry->name;
+        }
+    }
+
+    return "";
+}
+
+/**
+ * @brief   Check that the generated tables know every linked service.
+ *
+ * @param   obj Pointer to the routes object handle.
+ *
+ * @retval  Returns 0 on success, -ENOENT if a service is in no route.
+ */
+static int32_t service_routes_probe(const object* obj)
+{
+    const service_t* svc;
+    int32_t ret = 0;
+    uint32_t found;
+    uint32_t i;
+
+    /* Routes hold the first replica, step over the others. */
+    for (svc = module_service$$Base;
+         svc < module_service$$Limit;
+         svc += SERVICE_REPLICA_COUNT(svc))
+    {
+        found = service_routes_contain(service_routes_default, svc);
+
+        for (i = 0; !found && i < service_routes_num; i++)
+        {
+            found = service_routes_contain(service_routes[i].services, svc);
+        }
+
+        if (!found)
+        {
+            pr_error("Service <%s> is in no route, add its sources to ROUTE_DIRS.",
+                     service_routes_name(svc));
+            ret = -ENOENT;
+        }
+    }
+
+    if (!ret)
+    {
+        pr_info("Object <%s> probe succeed.", obj->name);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief   Get the destination services of a message id.
+ *
+ * @param   id Message id, flags are ignored.
+ *
+ * @retval  Returns the NULL terminated destination list, the wildcard
+ *          services if the id is not in the table.
+ *
+ * @ingroup Service_Routes
+ */
+service_t* const* service_routes_lookup(uint32_t id)
+{
+    uint32_t low = 0;
+    uint32_t high = service_routes_num;
+    uint32_t mid;
+
+    id &= ~MSG_ID_FLAGS_MASK;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+
+        if (service_routes[mid].id == id)
+        {
+            return service_routes[mid].services;
+        }
+
+        if (service_routes[mid].id < id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return service_routes_default;
+}
+
+/**
+ * @brief   Dump the routing tables.
+ *
+ * @ingroup Service_Routes
+ */
+void service_routes_dump(void)
+{
+    service_t* const* svc;
+    uint32_t i;
+
+    for (i = 0; i < service_routes_num; i++)
+    {
+        for (svc = service_routes[i].services; *svc; svc++)
+        {
+            pr_info("Route %s(0x%x) -> <%s>.",
+                    msg_id_to_str(service_routes[i].id),
+                    service_routes[i].id,
+                    (*svc)->owner ? (*svc)->owner->name : "");
+        }
+    }
+
+    for (svc = service_routes_default; *svc; svc++)
+    {
+        pr_info("Route * -> <%s>.", (*svc)->owner ? (*svc)->owner->name : "");
+    }
+}
+
+module_core("routes",
+            routes,
+            service_routes_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_ROUTES_ENABLE */
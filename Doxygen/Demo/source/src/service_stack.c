@@ -0,0 +1,265 @@
+/**
+ * @file source/src/service_stack.c
+ * @brief Definition the service stack monitor.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_stack.h"
+
+#if CONFIG_SERVICE_STACK_MONITOR_ENABLE
+
+/**
+ * @defgroup Service_Stack Service Stack
+ *
+ * @brief Measure the stack high-water-mark of the service threads.
+ *
+ * The kernel fills every new stack with a known value, tskSTACK_FILL_BYTE
+ * (0xA5) with tskSET_NEW_STACKS_TO_KNOWN_VALUE on FreeRTOS, static
+ * thread_attr.stack_mem stacks included, and osThreadGetStackSpace()
+ * reports the untouched part of it. The peak usage is derived from that
+ * high-water-mark only, a pattern painted before osThreadNew() would be
+ * overwritten by the kernel fill.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Measure the current stack high-water-mark of one service handle.
+ *
+ * @param   svc Pointer to the service handle, one replica of a replicated service.
+ * @param   size Output of the stack size in bytes.
+ *
+ * @retval  Returns the peak usage in bytes.
+ */
+static uint32_t service_stack_measure(const service_t* svc, uint32_t* size)
+{
+    const service_config_t* config =
+        (const service_config_t*)svc->owner->object_config;
+    uint32_t total;
+    uint32_t space;
+
+    *size = config->thread_attr.stack_size;
+
+    if (!svc->thread_id)
+    {
+        return 0;
+    }
+
+    /* The stack the thread runs on, the configured one if not reported. */
+    total = osThreadGetStackSize(svc->thread_id);
+    if (!total)
+    {
+        total = *size;
+    }
+
+    if (!*size)
+    {
+        *size = total;
+    }
+
+    space = osThreadGetStackSpace(svc->thread_id);
+
+    return (total > space) ? total - space : 0;
+}
+
+/**
+ * @brief   Get the stack usage of a service.
+ *
+ * Every replica of a replicated service is measured, the usage is the
+ * one of the deepest replica, the size they all share must fit it.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   usage Output of the stack usage.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stack
+ */
+int32_t service_stack_get_usage(const object* obj, service_stack_usage_t* usage)
+{
+    service_t* svc;
+    uint32_t count;
+    uint32_t peak;
+    uint32_t i;
+
+    if (!obj || !usage)
+    {
+        return -EINVAL;
+    }
+
+    svc = (service_t*)obj->object_data;
+    count = SERVICE_REPLICA_COUNT(svc);
+
+    usage->peak = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        peak = service_stack_measure(&svc[i], &usage->size);
+        if (peak > svc[i].stack_peak)
+        {
+            svc[i].stack_peak = peak;
+        }
+
+        if (svc[i].stack_peak > usage->peak)
+        {
+            usage->peak = svc[i].stack_peak;
+        }
+    }
+
+    usage->recommended = usage->peak +
+                         usage->peak * CONFIG_SERVICE_STACK_MARGIN_PERCENT / 100;
+    usage->recommended = (usage->recommended + 7) & ~7u;
+
+    return 0;
+}
+
+/**
+ * @brief   Update the stack high-water-mark of all services.
+ *
+ * Cheap enough to be called from a periodic timer or the idle hook.
+ *
+ * @ingroup Service_Stack
+ */
+void service_stack_scan(void)
+{
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+
+    const service_t* svc;
+    service_stack_usage_t usage;
+
+    /* The first handle measures the replicas too. */
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        if (!SERVICE_REPLICA_INDEX(svc) && svc->owner)
+        {
+            (void)service_stack_get_usage(svc->owner, &usage);
+        }
+    }
+}
+
+/**
+ * @brief   Dump the stack usage of all services.
+ *
+ * @ingroup Service_Stack
+ */
+void service_stack_dump(void)
+{
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+
+    const service_t* svc;
+    service_stack_usage_t usage;
+    uint32_t count;
+    uint32_t configured = 0;
+    uint32_t recommended = 0;
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        if (SERVICE_REPLICA_INDEX(svc) || !svc->owner || service_stack_get_usage(svc->owner, &usage))
+        {
+            continue;
+        }
+
+        count = SERVICE_REPLICA_COUNT(svc);
+
+        pr_info("Service <%s> stack size %u, peak %u, recommended %u, %u threads.",
+                svc->owner->name,
+                usage.size,
+                usage.peak,
+                usage.recommended,
+                count);
+
+        configured += usage.size * count;
+        recommended += usage.recommended * count;
+    }
+
+    pr_info("Total stack size %u, recommended %u.", configured, recommended);
+}
+
+/**
+ * @brief   Dump the recommended stack sizes as a C header.
+ *
+ * The output can be saved as a configuration header for the next build,
+ * one CONFIG_<SERVICE>_STACK_SIZE macro per service. A service
+ * configuration takes its stack_size from that macro with an #ifndef
+ * default, see source/sim/sim_demo.c, and make SERVICE_CONF=<saved header>
+ * includes the header in every source. A service whose name does not fit
+ * a macro is listed in a comment instead.
+ *
+ * @ingroup Service_Stack
+ */
+void service_stack_dump_header(void)
+{
+    extern service_t module_service$$Base[];
+    extern service_t module_service$$Limit[];
+
+    const service_t* svc;
+    service_stack_usage_t usage;
+    char macro[32];
+    uint32_t i;
+
+    dbg_cli_output("/* Generated by service_stack_dump_header(). */\r\n");
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        /* Replicas share the configuration, sized by the deepest one. */
+        if (SERVICE_REPLICA_INDEX(svc) || !svc->owner || service_stack_get_usage(svc->owner, &usage))
+        {
+            continue;
+        }
+
+        for (i = 0; svc->owner->name[i] && i < sizeof(macro) - 1; i++)
+        {
+            char c = svc->owner->name[i];
+
+            if (c >= 'a' && c <= 'z')
+            {
+                c = (char)(c - 'a' + 'A');
+            }
+            else if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')))
+            {
+                c = '_';
+            }
+
+            macro[i] = c;
+        }
+
+        macro[i] = '\0';
+
+        /* A truncated name would define a macro nobody reads. */
+        if (svc->owner->name[i])
+        {
+            dbg_cli_output("/* Service <%s> skipped, name longer than %u characters. */\r\n",
+                           svc->owner->name,
+                           (uint32_t)(sizeof(macro) - 1));
+            continue;
+        }
+
+        dbg_cli_output("#define CONFIG_%s_STACK_SIZE %u /* peak %u */\r\n",
+                       macro,
+                       usage.recommended,
+                       usage.peak);
+    }
+}
+
+#endif /* CONFIG_SERVICE_STACK_MONITOR_ENABLE */
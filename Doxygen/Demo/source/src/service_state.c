@@ -0,0 +1,441 @@
+/**
+ * @file source/src/service_state.c
+ * @brief Definition the shared state board.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_state.h"
+
+#if CONFIG_SERVICE_STATE_ENABLE
+
+/**
+ * @defgroup Service_State Service State
+ *
+ * @brief Current values of the system state, readable by any service.
+ *
+ * The board is a fixed table of typed slots. A service reads the current
+ * value of a slot at any time, a service starting late does not miss
+ * the changes made before it ran. The owner of a slot writes it, and the
+ * subscribed services receive MSG_ID_SYS_STATE_CHANGED with the slot and
+ * its version, a few bytes instead of the value in every queue.
+ *
+ * Each slot is protected by a sequence lock. Reads take no lock and
+ * retry if they overlap an update. A write that overlaps another write
+ * of the same slot fails with -EBUSY, each slot is meant to have a
+ * single writer. A reader that keeps finding an update in progress,
+ * because it preempted the writer, sleeps a tick to let it finish, and
+ * gives up with -EBUSY in interrupt context.
+ *
+ * The version counts the updates of a slot. A subscriber that reads the
+ * slot when notified can ignore notifications for older versions.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+
+/* Read attempts before a reader assumes it preempted the writer. */
+#define SERVICE_STATE_READ_SPIN 16
+/* Words of the largest slot value. */
+#define SERVICE_STATE_WORDS ((CONFIG_SERVICE_STATE_SIZE + 3) / 4)
+#endif
+
+/**
+ * @brief   Slot descriptor.
+ */
+typedef struct
+{
+    uint32_t    size;       /**< Value size in bytes. */
+    const char* name;       /**< Slot name. */
+} service_state_desc_t;
+
+/**
+ * @brief   Slot storage.
+ */
+typedef struct
+{
+    uint32_t    seq;                        /**< Odd during an update, twice the version otherwise. */
+    uint32_t    subscribers;                /**< Bit n set if service n in module_service is notified. */
+    uint32_t    value[SERVICE_STATE_WORDS]; /**< Current value. */
+} service_state_slot_t;
+
+/**
+ * @brief   The slot table, indexed by service_state_id_e.
+ */
+static const service_state_desc_t service_state_desc[SERVICE_STATE_NUM] =
+{
+    [SERVICE_STATE_SYS_STARTUP]    = { sizeof(uint32_t), "SYS_STARTUP"    },
+    [SERVICE_STATE_BLE_CONNECTION] = { sizeof(uint32_t), "BLE_CONNECTION" },
+    [SERVICE_STATE_LED_MODE]       = { sizeof(uint32_t), "LED_MODE"       },
+};
+
+/**
+ * @brief   The board.
+ */
+static service_state_slot_t service_state_slots[SERVICE_STATE_NUM];
+
+/**
+ * @brief   Check a slot id and the size of the value given for it.
+ *
+ * @param   id Slot id.
+ * @param   size Value size in bytes.
+ *
+ * @retval  Returns 0 if they match the slot table, -EINVAL otherwise.
+ */
+static int32_t service_state_check(service_state_id_e id, uint32_t size)
+{
+    if ((uint32_t)id >= SERVICE_STATE_NUM ||
+        !service_state_desc[id].size ||
+        service_state_desc[id].size > CONFIG_SERVICE_STATE_SIZE ||
+        service_state_desc[id].size != size)
+    {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Notify the subscribers of a slot.
+ *
+ * @param   id Slot id.
+ * @param   version Version written.
+ *
+ * @retval  Returns 0 on success, -EPIPE if a subscriber was not notified.
+ */
+static int32_t service_state_notify(service_state_id_e id, uint32_t version)
+{
+    message_t message;
+    uint32_t subscribers;
+    uint32_t i;
+    int32_t ret = 0;
+
+    subscribers = __atomic_load_n(&service_state_slots[id].subscribers, __ATOMIC_RELAXED);
+    if (!subscribers)
+    {
+        return 0;
+    }
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = MSG_ID_SYS_STATE_CHANGED;
+    message.param0 = (uint32_t)id;
+    message.param1 = version;
+
+    for (i = 0; subscribers; i++, subscribers >>= 1)
+    {
+        if ((subscribers & 1) && service_unicast_message(&module_service$$Base[i], &message))
+        {
+            ret = -EPIPE;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief   Write a state slot and notify its subscribers.
+ *
+ * @param   id Slot id.
+ * @param   value New value.
+ * @param   size Value size in bytes, the size of the slot type.
+ *
+ * @retval  Returns 0 on success, -ENOCHANGE if the slot already holds
+ *          the value, -EBUSY if another write of the slot is in progress,
+ *          -EPIPE if the value is written but a subscriber was not
+ *          notified, negative error code otherwise.
+ *
+ * @ingroup Service_State
+ */
+int32_t service_state_write(service_state_id_e id, const void* value, uint32_t size)
+{
+    service_state_slot_t* slot;
+    uint32_t words[SERVICE_STATE_WORDS];
+    uint32_t seq;
+    uint32_t i;
+
+    if (!value || service_state_check(id, size))
+    {
+        return -EINVAL;
+    }
+
+    slot = &service_state_slots[id];
+
+    (void)memset(words, 0, sizeof(words));
+    (void)memcpy(words, value, size);
+
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) ||
+        !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                     __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED))
+    {
+        return -EBUSY;
+    }
+
+    /* The slot is ours, nobody else writes the value while seq is odd. */
+    if (seq && !memcmp(words, slot->value, sizeof(words)))
+    {
+        __atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+        return -ENOCHANGE;
+    }
+
+    /* Readers that see any of the new words see the odd seq too. */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (i = 0; i < SERVICE_STATE_WORDS; i++)
+    {
+        __atomic_store_n(&slot->value[i], words[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+    return service_state_notify(id, (seq + 2) >> 1);
+}
+
+/**
+ * @brief   Read a state slot.
+ *
+ * A slot never written reads as zero with version 0.
+ *
+ * @param   id Slot id.
+ * @param   value Returns the current value.
+ * @param   size Value size in bytes, the size of the slot type.
+ * @param   version Returns the version of the value, may be NULL.
+ *
+ * @retval  Returns 0 on success, -EBUSY if an update kept the slot busy
+ *          in interrupt context, negative error code otherwise.
+ *
+ * @ingroup Service_State
+ */
+int32_t service_state_read(service_state_id_e id,
+                           void* value,
+                           uint32_t size,
+                           uint32_t* version)
+{
+    const service_state_slot_t* slot;
+    uint32_t words[SERVICE_STATE_WORDS];
+    uint32_t seq;
+    uint32_t spin;
+    uint32_t i;
+
+    if (!value || service_state_check(id, size))
+    {
+        return -EINVAL;
+    }
+
+    slot = &service_state_slots[id];
+
+    for (spin = 0; ; spin++)
+    {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1))
+        {
+            for (i = 0; i < SERVICE_STATE_WORDS; i++)
+            {
+                words[i] = __atomic_load_n(&slot->value[i], __ATOMIC_RELAXED);
+            }
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+            {
+                break;
+            }
+        }
+
+        if (spin >= SERVICE_STATE_READ_SPIN)
+        {
+            if (xPortIsInsideInterrupt())
+            {
+                return -EBUSY;
+            }
+
+            (void)osDelay(1);
+            spin = 0;
+        }
+    }
+
+    (void)memcpy(value, words, size);
+
+    if (version)
+    {
+        *version = seq >> 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Get the version of a state slot.
+ *
+ * @param   id Slot id.
+ *
+ * @retval  Returns the number of updates of the slot, 0 if never written.
+ *
+ * @ingroup Service_State
+ */
+uint32_t service_state_version(service_state_id_e id)
+{
+    if ((uint32_t)id >= SERVICE_STATE_NUM)
+    {
+        return 0;
+    }
+
+    return __atomic_load_n(&service_state_slots[id].seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+/**
+ * @brief   Get the subscriber bit of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the bit, 0 if the service cannot subscribe.
+ */
+static uint32_t service_state_bit(const service_t* svc)
+{
+    uint32_t index;
+
+    if (svc < module_service$$Base || svc >= module_service$$Limit)
+    {
+        return 0;
+    }
+
+    /* Replicas are notified through the service, as any unicast. */
+    index = (uint32_t)(svc - SERVICE_REPLICA_INDEX(svc) - module_service$$Base);
+
+    return index < 32 ? 1u << index : 0;
+}
+
+/**
+ * @brief   Subscribe a service to the changes of a state slot.
+ *
+ * Read the slot after subscribing, a change made before is not notified.
+ *
+ * @param   id Slot id.
+ * @param   svc Pointer to the service handle, one of the first 32 services.
+ *
+ * @retval  Returns 0 on success, -ERANGE if the service cannot subscribe,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_State
+ */
+int32_t service_state_subscribe(service_state_id_e id, const service_t* svc)
+{
+    uint32_t bit;
+
+    if ((uint32_t)id >= SERVICE_STATE_NUM || !svc)
+    {
+        return -EINVAL;
+    }
+
+    bit = service_state_bit(svc);
+    if (!bit)
+    {
+        return -ERANGE;
+    }
+
+    (void)__atomic_fetch_or(&service_state_slots[id].subscribers, bit, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+/**
+ * @brief   Unsubscribe a service from the changes of a state slot.
+ *
+ * @param   id Slot id.
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_State
+ */
+int32_t service_state_unsubscribe(service_state_id_e id, const service_t* svc)
+{
+    uint32_t bit;
+
+    if ((uint32_t)id >= SERVICE_STATE_NUM || !svc)
+    {
+        return -EINVAL;
+    }
+
+    bit = service_state_bit(svc);
+    if (!bit)
+    {
+        return -ERANGE;
+    }
+
+    (void)__atomic_fetch_and(&service_state_slots[id].subscribers, ~bit, __ATOMIC_SEQ_CST);
+
+    return 0;
+}
+
+/**
+ * @brief   Convert the state slot id to string.
+ *
+ * @param   id Slot id.
+ *
+ * @retval  Returns the slot name.
+ *
+ * @ingroup Service_State
+ */
+const char* service_state_to_str(service_state_id_e id)
+{
+    if ((uint32_t)id >= SERVICE_STATE_NUM || !service_state_desc[id].name)
+    {
+        return "STATE_UNKNOW";
+    }
+
+    return service_state_desc[id].name;
+}
+
+/**
+ * @brief   Dump the state board.
+ *
+ * @ingroup Service_State
+ */
+void service_state_dump(void)
+{
+    uint32_t words[SERVICE_STATE_WORDS];
+    uint32_t version;
+    uint32_t i;
+
+    for (i = 0; i < SERVICE_STATE_NUM; i++)
+    {
+        (void)memset(words, 0, sizeof(words));
+
+        if (service_state_read((service_state_id_e)i, words, service_state_desc[i].size, &version))
+        {
+            continue;
+        }
+
+        pr_info("State %s version %u, 0x%x, subscribers 0x%x.",
+                service_state_to_str((service_state_id_e)i),
+                version,
+                words[0],
+                __atomic_load_n(&service_state_slots[i].subscribers, __ATOMIC_RELAXED));
+    }
+}
+
+#endif /* CONFIG_SERVICE_STATE_ENABLE */
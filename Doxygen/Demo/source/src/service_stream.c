@@ -0,0 +1,548 @@
+/**
+ * @file source/src/service_stream.c
+ * @brief Definition the streaming data channel between two services.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_isr.h"
+#include "service_stream.h"
+
+#if CONFIG_SERVICE_STREAM_ENABLE
+
+/**
+ * @defgroup Service_Stream Service Stream
+ *
+ * @brief Move high-rate sample data between two services.
+ *
+ * A stream is a lock-free byte ring with one producer and one consumer.
+ * The producer copies data in with service_stream_write(), or fills the
+ * ring in place with service_stream_reserve() and service_stream_commit().
+ * The consumer copies data out with service_stream_read(), or works in
+ * place with service_stream_peek() and service_stream_release(). With a
+ * frame size above 1, every transfer is a whole number of frames.
+ *
+ * The consumer is notified through its message queue, with the
+ * configured message id, param0 the stream tag and param1 the buffered
+ * byte count. One notification is sent when the buffered data reaches
+ * the watermark, the next one only after the consumer handled it, read
+ * or not, so a stream never takes more than one slot of the consumer
+ * queue. If the consumer leaves data at or above the watermark, it is
+ * notified again and keeps draining from its message loop.
+ *
+ * A full ring cuts writes short instead of blocking the producer, which
+ * may be an interrupt. Notifications never wait either, a full consumer
+ * queue counts a failed notification and the next commit or flush tries
+ * again. From an interrupt they go through the ISR ring when it is
+ * enabled, see @ref Service_ISR.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Streams, indexed by the stream carried in the notification id.
+ */
+static service_stream_t* service_stream_table[CONFIG_SERVICE_STREAM_MAX];
+
+/**
+ * @brief   Notify the consumer if it waits and enough data is buffered.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   watermark Threshold in bytes.
+ *
+ * @retval  Returns 0 on success or if nothing was due, negative error code otherwise.
+ */
+static int32_t service_stream_notify(service_stream_t* stream, uint32_t watermark)
+{
+    message_t message;
+    uint32_t count = service_stream_count(stream);
+    uint32_t armed = 1;
+    int32_t ret;
+
+    if (!count || count < watermark)
+    {
+        return 0;
+    }
+
+    /* Producer and consumer may race here, only one of them wins the flag. */
+    if (!__atomic_compare_exchange_n(&stream->armed, &armed, 0, 0,
+                                     __ATOMIC_SEQ_CST,
+                                     __ATOMIC_SEQ_CST))
+    {
+        return 0;
+    }
+
+    (void)memset(&message, 0, sizeof(message));
+    message.id = stream->id | MSG_ID_FLAG_STREAM | (stream->index << MSG_ID_REQUEST_TAG_SHIFT);
+    message.param0 = stream->tag;
+    message.param1 = count;
+
+#if CONFIG_SERVICE_ISR_RING_ENABLE
+    if (xPortIsInsideInterrupt())
+    {
+        ret = service_unicast_message_isr(stream->consumer, &message);
+    }
+    else
+#endif
+    {
+        /* The consumer may notify itself, it must not wait on its own queue. */
+        ret = service_post_message(stream->consumer, &message);
+    }
+
+    if (ret)
+    {
+        /* The next commit tries again. */
+        __atomic_store_n(&stream->armed, 1, __ATOMIC_SEQ_CST);
+        (void)__atomic_add_fetch(&stream->stats.failed, 1, __ATOMIC_RELAXED);
+        return -EPIPE;
+    }
+
+    (void)__atomic_add_fetch(&stream->stats.notifies, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief   Initialize a stream.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   consumer Service receiving the data.
+ * @param   config Stream configuration.
+ *
+ * @retval  Returns 0 on success, -ENOSPC if all streams are used,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_init(service_stream_t* stream,
+                            const service_t* consumer,
+                            const service_stream_config_t* config)
+{
+    service_stream_t* expected;
+    uint32_t i;
+
+    if (!stream || !consumer || !config || !config->buf || (config->id & MSG_ID_FLAGS_MASK))
+    {
+        return -EINVAL;
+    }
+
+    /* The stream is armed again by the dispatch of the consumer, in this process. */
+    if (consumer < module_service$$Base || consumer >= module_service$$Limit)
+    {
+        return -EINVAL;
+    }
+
+    if (!config->size || (config->size & (config->size - 1)) ||
+        !config->frame || (config->frame & (config->frame - 1)) ||
+        config->frame > config->size || config->watermark > config->size)
+    {
+        return -EINVAL;
+    }
+
+    (void)memset(stream, 0, sizeof(*stream));
+    stream->buf = config->buf;
+    stream->mask = config->size - 1;
+    stream->frame = config->frame;
+    stream->watermark = config->watermark ? config->watermark : config->frame;
+    stream->id = config->id;
+    stream->tag = config->tag;
+    stream->consumer = consumer;
+    stream->armed = 1;
+
+    for (i = 0; i < CONFIG_SERVICE_STREAM_MAX; i++)
+    {
+        expected = NULL;
+        stream->index = i;
+
+        if (__atomic_compare_exchange_n(&service_stream_table[i], &expected, stream, 0,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        {
+            return 0;
+        }
+    }
+
+    return -ENOSPC;
+}
+
+/**
+ * @brief   Deinitialize a stream.
+ *
+ * @param   stream Pointer to the stream.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_deinit(service_stream_t* stream)
+{
+    if (!stream || stream->index >= CONFIG_SERVICE_STREAM_MAX ||
+        service_stream_table[stream->index] != stream)
+    {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&service_stream_table[stream->index], NULL, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief   Arm a stream again once its notification is handled or dropped.
+ *
+ * Called by the framework after the message handler, or when the
+ * notification is dropped.
+ *
+ * @param   index Stream carried in the message id.
+ * @param   handled Non-zero after the message handler, the consumer is
+ *          notified again if the data left is at or above the watermark.
+ *
+ * @ingroup Service_Stream
+ */
+void service_stream_grant(uint32_t index, uint32_t handled)
+{
+    service_stream_t* stream;
+
+    if (index >= CONFIG_SERVICE_STREAM_MAX)
+    {
+        return;
+    }
+
+    stream = __atomic_load_n(&service_stream_table[index], __ATOMIC_ACQUIRE);
+    if (!stream)
+    {
+        return;
+    }
+
+    /* Arm before checking the count, a commit in between sees the flag. */
+    __atomic_store_n(&stream->armed, 1, __ATOMIC_SEQ_CST);
+
+    if (handled)
+    {
+        (void)service_stream_notify(stream, stream->watermark);
+    }
+}
+
+/**
+ * @brief   Get the number of bytes buffered.
+ *
+ * @param   stream Pointer to the stream.
+ *
+ * @retval  Returns the byte count.
+ *
+ * @ingroup Service_Stream
+ */
+uint32_t service_stream_count(const service_stream_t* stream)
+{
+    return __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief   Get the number of bytes free.
+ *
+ * @param   stream Pointer to the stream.
+ *
+ * @retval  Returns the byte count.
+ *
+ * @ingroup Service_Stream
+ */
+uint32_t service_stream_space(const service_stream_t* stream)
+{
+    return stream->mask + 1 - service_stream_count(stream);
+}
+
+/**
+ * @brief   Claim the contiguous free space at the head.
+ *
+ * Only the producer may call this. The region may be shorter than the
+ * free space when it wraps around the end of the ring.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   len Output of the region length in bytes, whole frames.
+ *
+ * @retval  Returns the region, or NULL if the ring is full.
+ *
+ * @ingroup Service_Stream
+ */
+void* service_stream_reserve(service_stream_t* stream, uint32_t* len)
+{
+    uint32_t head;
+    uint32_t space;
+    uint32_t offset;
+
+    if (!stream || !len)
+    {
+        return NULL;
+    }
+
+    head = stream->head;
+    offset = head & stream->mask;
+    space = stream->mask + 1 - (head - __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE));
+
+    if (space > stream->mask + 1 - offset)
+    {
+        space = stream->mask + 1 - offset;
+    }
+
+    *len = space & ~(stream->frame - 1);
+
+    return *len ? &stream->buf[offset] : NULL;
+}
+
+/**
+ * @brief   Publish bytes written in place after service_stream_reserve().
+ *
+ * @param   stream Pointer to the stream.
+ * @param   len Bytes written, whole frames.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_commit(service_stream_t* stream, uint32_t len)
+{
+    if (!stream || (len & (stream->frame - 1)) || len > service_stream_space(stream))
+    {
+        return -EINVAL;
+    }
+
+    if (!len)
+    {
+        return 0;
+    }
+
+    __atomic_store_n(&stream->head, stream->head + len, __ATOMIC_SEQ_CST);
+    (void)__atomic_add_fetch(&stream->stats.written, len, __ATOMIC_RELAXED);
+
+    return service_stream_notify(stream, stream->watermark);
+}
+
+/**
+ * @brief   Copy data into the stream.
+ *
+ * Only the producer may call this, from a thread or an interrupt.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   data Data to write.
+ * @param   len Length in bytes.
+ *
+ * @retval  Returns the bytes written, whole frames, less than len if the ring is full.
+ *
+ * @ingroup Service_Stream
+ */
+uint32_t service_stream_write(service_stream_t* stream, const void* data, uint32_t len)
+{
+    const uint8_t* src = data;
+    uint32_t done = 0;
+    uint32_t chunk;
+    uint8_t* dst;
+
+    if (!stream || !data)
+    {
+        return 0;
+    }
+
+    len &= ~(stream->frame - 1);
+
+    /* At most two regions, before and after the wrap. */
+    while (done < len && (dst = service_stream_reserve(stream, &chunk)))
+    {
+        if (chunk > len - done)
+        {
+            chunk = len - done;
+        }
+
+        (void)memcpy(dst, &src[done], chunk);
+        __atomic_store_n(&stream->head, stream->head + chunk, __ATOMIC_SEQ_CST);
+        done += chunk;
+    }
+
+    if (done < len)
+    {
+        (void)__atomic_add_fetch(&stream->stats.overflows, 1, __ATOMIC_RELAXED);
+    }
+
+    if (done)
+    {
+        (void)__atomic_add_fetch(&stream->stats.written, done, __ATOMIC_RELAXED);
+        (void)service_stream_notify(stream, stream->watermark);
+    }
+
+    return done;
+}
+
+/**
+ * @brief   Notify the consumer of any data below the watermark.
+ *
+ * The producer calls this at the end of a burst.
+ *
+ * @param   stream Pointer to the stream.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_flush(service_stream_t* stream)
+{
+    if (!stream)
+    {
+        return -EINVAL;
+    }
+
+    return service_stream_notify(stream, 1);
+}
+
+/**
+ * @brief   Get the contiguous buffered data at the tail.
+ *
+ * Only the consumer may call this. The region may be shorter than the
+ * buffered data when it wraps around the end of the ring.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   len Output of the region length in bytes, whole frames.
+ *
+ * @retval  Returns the region, or NULL if the ring is empty.
+ *
+ * @ingroup Service_Stream
+ */
+const void* service_stream_peek(service_stream_t* stream, uint32_t* len)
+{
+    uint32_t tail;
+    uint32_t count;
+    uint32_t offset;
+
+    if (!stream || !len)
+    {
+        return NULL;
+    }
+
+    tail = stream->tail;
+    offset = tail & stream->mask;
+    count = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE) - tail;
+
+    if (count > stream->mask + 1 - offset)
+    {
+        count = stream->mask + 1 - offset;
+    }
+
+    *len = count & ~(stream->frame - 1);
+
+    return *len ? &stream->buf[offset] : NULL;
+}
+
+/**
+ * @brief   Give bytes returned by service_stream_peek() back to the producer.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   len Bytes consumed, whole frames.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_release(service_stream_t* stream, uint32_t len)
+{
+    if (!stream || (len & (stream->frame - 1)) || len > service_stream_count(stream))
+    {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&stream->tail, stream->tail + len, __ATOMIC_RELEASE);
+    (void)__atomic_add_fetch(&stream->stats.read, len, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief   Copy data out of the stream.
+ *
+ * Only the consumer may call this.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   data Output buffer.
+ * @param   len Buffer length in bytes.
+ *
+ * @retval  Returns the bytes read, whole frames.
+ *
+ * @ingroup Service_Stream
+ */
+uint32_t service_stream_read(service_stream_t* stream, void* data, uint32_t len)
+{
+    uint8_t* dst = data;
+    uint32_t done = 0;
+    uint32_t chunk;
+    const uint8_t* src;
+
+    if (!stream || !data)
+    {
+        return 0;
+    }
+
+    len &= ~(stream->frame - 1);
+
+    while (done < len && (src = service_stream_peek(stream, &chunk)))
+    {
+        if (chunk > len - done)
+        {
+            chunk = len - done;
+        }
+
+        (void)memcpy(&dst[done], src, chunk);
+        __atomic_store_n(&stream->tail, stream->tail + chunk, __ATOMIC_RELEASE);
+        done += chunk;
+    }
+
+    (void)__atomic_add_fetch(&stream->stats.read, done, __ATOMIC_RELAXED);
+
+    return done;
+}
+
+/**
+ * @brief   Get the stream statistics.
+ *
+ * @param   stream Pointer to the stream.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Stream
+ */
+int32_t service_stream_get_stats(const service_stream_t* stream,
+                                 service_stream_stats_t* stats)
+{
+    if (!stream || !stats)
+    {
+        return -EINVAL;
+    }
+
+    *stats = stream->stats;
+
+    return 0;
+}
+
+#endif /* CONFIG_SERVICE_STREAM_ENABLE */
@@ -0,0 +1,676 @@
+/**
+ * @file source/src/service_watchdog.c
+ * @brief Definition the message handler budget watchdog.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "service_watchdog.h"
+
+#if CONFIG_SERVICE_WATCHDOG_ENABLE
+
+/**
+ * @defgroup Service_Watchdog Service Watchdog
+ *
+ * @brief Catch message handlers that run over their time budget.
+ *
+ * The dispatch marks the start and the end of every message handler in
+ * the service handle, which costs a tick read and a few stores. Handlers
+ * over budget_ms are recorded when they return. A check from the monitor
+ * thread every CONFIG_SERVICE_WATCHDOG_PERIOD_MS also catches handlers
+ * that are still running, so a hung handler is reported while it hangs.
+ *
+ * Each overrun is recorded once in a small log, and optionally sent as
+ * MSG_ID_SYS_HANDLER_OVERRUN by the next check to the services
+ * subscribed with service_watchdog_subscribe(). The monitor never waits
+ * on a queue, a service with a full queue misses the notification. The
+ * check logs and sends, so it runs in a thread, never in the tick hook.
+ *
+ * The replicas of a replicated service are tracked one by one, the
+ * dump shows each, service_watchdog_get_stats() sums them.
+ *
+ * @ingroup Service_API
+ */
+
+/**
+ * @brief   Watchdog state of one service.
+ */
+typedef struct
+{
+    uint32_t    overruns;       /**< Messages over budget. */
+    uint32_t    worst;          /**< Longest handler time in ms. */
+    uint32_t    worst_id;       /**< Message id of the longest handler time. */
+    uint32_t    reported;       /**< Busy sequence of the message already recorded. */
+} service_watchdog_state_t;
+
+/**
+ * @brief   Entry of the overrun log.
+ */
+typedef struct
+{
+    uint32_t                    seq;    /**< Odd while written, 2 * (position + 1) once written. */
+    service_watchdog_record_t   record; /**< Overrun record. */
+} service_watchdog_entry_t;
+
+#ifndef DOC_HIDDEN
+extern service_t module_service$$Base[];
+extern service_t module_service$$Limit[];
+#endif
+
+/**
+ * @brief   Watchdog state, indexed like the module_service section.
+ */
+static service_watchdog_state_t service_watchdog_state[CONFIG_SERVICE_WATCHDOG_MAX];
+
+/**
+ * @brief   Overrun log.
+ */
+static service_watchdog_entry_t service_watchdog_log[CONFIG_SERVICE_WATCHDOG_LOG];
+
+/**
+ * @brief   Number of records written to the log.
+ */
+static uint32_t service_watchdog_log_head;
+
+/**
+ * @brief   Number of records broadcast.
+ */
+static uint32_t service_watchdog_notified;
+
+#if CONFIG_SERVICE_WATCHDOG_NOTIFY
+/**
+ * @brief   Bit n set if service n in module_service is notified of the overruns.
+ */
+static uint32_t service_watchdog_subscribers;
+#endif
+
+/**
+ * @brief   Get the watchdog state of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the state, or NULL if the service is not tracked.
+ */
+static service_watchdog_state_t* service_watchdog_get_state(const service_t* svc)
+{
+    if (svc < module_service$$Base || svc >= module_service$$Limit ||
+        svc - module_service$$Base >= CONFIG_SERVICE_WATCHDOG_MAX)
+    {
+        return NULL;
+    }
+
+    return &service_watchdog_state[svc - module_service$$Base];
+}
+
+/**
+ * @brief   Get the budget of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the budget in ms, 0 for none.
+ */
+static uint32_t service_watchdog_budget(const service_t* svc)
+{
+    if (!svc->owner || !svc->owner->object_config)
+    {
+        return 0;
+    }
+
+    return ((const service_config_t*)svc->owner->object_config)->budget_ms;
+}
+
+/**
+ * @brief   Convert kernel ticks to ms.
+ *
+ * @param   ticks Tick count.
+ *
+ * @retval  Returns the time in ms.
+ */
+static uint32_t service_watchdog_ms(uint32_t ticks)
+{
+    uint32_t freq = osKernelGetTickFreq();
+
+    return freq ? (uint32_t)((uint64_t)ticks * 1000 / freq) : ticks;
+}
+
+/**
+ * @brief   Append a record to the overrun log.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   id Message id being handled.
+ * @param   duration Handler time in ms.
+ * @param   running Non-zero if the handler is still running.
+ */
+static void service_watchdog_record(const service_t*    svc,
+                                    uint32_t            id,
+                                    uint32_t            duration,
+                                    uint32_t            running)
+{
+    uint32_t pos = __atomic_fetch_add(&service_watchdog_log_head, 1, __ATOMIC_RELAXED);
+    service_watchdog_entry_t* entry =
+        &service_watchdog_log[pos % CONFIG_SERVICE_WATCHDOG_LOG];
+
+    /* Odd while the fields change, the readers skip a torn record. */
+    __atomic_store_n(&entry->seq, 2 * pos + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    entry->record.obj = svc->owner;
+    entry->record.id = id;
+    entry->record.duration = duration;
+    entry->record.tick = osKernelGetTickCount();
+    entry->record.running = running;
+
+    __atomic_store_n(&entry->seq, 2 * pos + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Read a record of the overrun log.
+ *
+ * @param   pos Position of the record, as counted by the log head.
+ * @param   record Output of the record.
+ *
+ * @retval  Returns 0 on success, -EBUSY if the record is being written,
+ *          -ENOENT if it was overwritten by a newer one.
+ */
+static int32_t service_watchdog_read(uint32_t pos, service_watchdog_record_t* record)
+{
+    const service_watchdog_entry_t* entry =
+        &service_watchdog_log[pos % CONFIG_SERVICE_WATCHDOG_LOG];
+    uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+
+    if (seq == 2 * pos + 1)
+    {
+        return -EBUSY;
+    }
+
+    if (seq != 2 * pos + 2)
+    {
+        return -ENOENT;
+    }
+
+    *record = entry->record;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq)
+    {
+        return -ENOENT;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Mark the start of a message handler.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   id Message id, without the framework flags.
+ */
+void service_watchdog_begin(service_t* svc, uint32_t id)
+{
+    svc->busy_id = id;
+    svc->busy_start = osKernelGetTickCount();
+
+    /* Odd while busy, the check detects a handler that changed under it. */
+    __atomic_store_n(&svc->busy, svc->busy + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Mark the end of a message handler and record an overrun.
+ *
+ * @param   svc Pointer to the service handle.
+ */
+void service_watchdog_end(service_t* svc)
+{
+    service_watchdog_state_t* state = service_watchdog_get_state(svc);
+    uint32_t duration = service_watchdog_ms(osKernelGetTickCount() - svc->busy_start);
+    uint32_t budget = service_watchdog_budget(svc);
+    uint32_t seq = svc->busy;
+
+    __atomic_store_n(&svc->busy, seq + 1, __ATOMIC_RELEASE);
+
+    if (!state)
+    {
+        return;
+    }
+
+    if (duration > state->worst)
+    {
+        state->worst = duration;
+        state->worst_id = svc->busy_id;
+    }
+
+    if (!budget || duration <= budget)
+    {
+        return;
+    }
+
+    state->overruns++;
+
+    if (__atomic_load_n(&state->reported, __ATOMIC_RELAXED) != seq)
+    {
+        service_watchdog_record(svc, svc->busy_id, duration, 0);
+    }
+}
+
+/**
+ * @brief   Check the running message handlers and send the notifications.
+ *
+ * Called periodically by the monitor thread, thread context only.
+ *
+ * @ingroup Service_Watchdog
+ */
+void service_watchdog_check(void)
+{
+    service_watchdog_state_t* state;
+    service_watchdog_record_t record;
+    const service_t* svc;
+    uint32_t now = osKernelGetTickCount();
+    uint32_t seq;
+    uint32_t id;
+    uint32_t start;
+    uint32_t budget;
+    uint32_t elapsed;
+    uint32_t head;
+#if CONFIG_SERVICE_WATCHDOG_NOTIFY
+    uint32_t subscribers;
+    uint32_t i;
+    message_t message;
+#endif
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        budget = service_watchdog_budget(svc);
+        state = service_watchdog_get_state(svc);
+        if (!budget || !state)
+        {
+            continue;
+        }
+
+        seq = __atomic_load_n(&svc->busy, __ATOMIC_ACQUIRE);
+        if (!(seq & 1) || state->reported == seq)
+        {
+            continue;
+        }
+
+        id = svc->busy_id;
+        start = svc->busy_start;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&svc->busy, __ATOMIC_RELAXED) != seq)
+        {
+            continue;
+        }
+
+        elapsed = service_watchdog_ms(now - start);
+        if (elapsed > budget)
+        {
+            __atomic_store_n(&state->reported, seq, __ATOMIC_RELAXED);
+            service_watchdog_record(svc, id, elapsed, 1);
+        }
+    }
+
+    head = __atomic_load_n(&service_watchdog_log_head, __ATOMIC_RELAXED);
+    if (head - service_watchdog_notified > CONFIG_SERVICE_WATCHDOG_LOG)
+    {
+        service_watchdog_notified = head - CONFIG_SERVICE_WATCHDOG_LOG;
+    }
+
+    for (; service_watchdog_notified != head; service_watchdog_notified++)
+    {
+        switch (service_watchdog_read(service_watchdog_notified, &record))
+        {
+        case 0:
+            break;
+        case -EBUSY:
+            /* Still written by a service thread, the next check sends it. */
+            return;
+        default:
+            continue;
+        }
+
+        pr_error("Service <%s> handler %s(0x%x) over budget, %u ms%s.",
+                 record.obj ? record.obj->name : "",
+                 msg_id_to_str(record.id),
+                 record.id,
+                 record.duration,
+                 record.running ? " and running" : "");
+
+#if CONFIG_SERVICE_WATCHDOG_NOTIFY
+        subscribers = __atomic_load_n(&service_watchdog_subscribers, __ATOMIC_RELAXED);
+        if (!record.obj || !subscribers)
+        {
+            continue;
+        }
+
+        svc = service_get_svc(record.obj);
+
+        (void)memset(&message, 0, sizeof(message));
+        message.id = MSG_ID_SYS_HANDLER_OVERRUN;
+        message.param0 = (uint32_t)(svc - module_service$$Base);
+        message.param1 = record.id;
+        message.param2 = record.duration;
+        message.param3 = service_watchdog_budget(svc);
+
+        /* A hung handler must not stall the monitor behind its full queue. */
+        for (i = 0; subscribers; i++, subscribers >>= 1)
+        {
+            if (subscribers & 1)
+            {
+                (void)service_post_message(&module_service$$Base[i], &message);
+            }
+        }
+#endif
+    }
+}
+
+/**
+ * @brief   Watchdog monitor thread.
+ *
+ * @param   argument Not used.
+ */
+static void service_watchdog_thread(void* argument)
+{
+    uint32_t period = CONFIG_SERVICE_WATCHDOG_PERIOD_MS * osKernelGetTickFreq() / 1000;
+
+    (void)argument;
+
+    while (1)
+    {
+        (void)osDelay(period ? period : 1);
+
+        service_watchdog_check();
+    }
+}
+
+/**
+ * @brief   Start the monitor thread.
+ *
+ * @param   obj Pointer to the watchdog object handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ */
+static int32_t service_watchdog_probe(const object* obj)
+{
+    static const osThreadAttr_t attr =
+    {
+        .name       = "watchdog",
+        .stack_size = CONFIG_SERVICE_WATCHDOG_STACK_SIZE,
+        .priority   = osPriorityHigh,
+    };
+
+    if (!osThreadNew(service_watchdog_thread, NULL, &attr))
+    {
+        pr_error("Object <%s> create thread <%s> failed.", obj->name, attr.name);
+        return -EINVAL;
+    }
+
+    pr_info("Object <%s> probe succeed.", obj->name);
+
+    return 0;
+}
+
+#if CONFIG_SERVICE_WATCHDOG_NOTIFY
+/**
+ * @brief   Get the subscriber bit of a service.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns the bit, 0 if the service cannot subscribe.
+ */
+static uint32_t service_watchdog_bit(const service_t* svc)
+{
+    uint32_t index;
+
+    if (svc < module_service$$Base || svc >= module_service$$Limit)
+    {
+        return 0;
+    }
+
+    /* Replicas are notified through the service, as any unicast. */
+    index = (uint32_t)(svc - SERVICE_REPLICA_INDEX(svc) - module_service$$Base);
+
+    return index < 32 ? 1u << index : 0;
+}
+
+/**
+ * @brief   Subscribe a service to MSG_ID_SYS_HANDLER_OVERRUN.
+ *
+ * @param   svc Pointer to the service handle, one of the first 32 services.
+ *
+ * @retval  Returns 0 on success, -ERANGE if the service cannot subscribe,
+ *          negative error code otherwise.
+ *
+ * @ingroup Service_Watchdog
+ */
+int32_t service_watchdog_subscribe(const service_t* svc)
+{
+    uint32_t bit;
+
+    if (!svc)
+    {
+        return -EINVAL;
+    }
+
+    bit = service_watchdog_bit(svc);
+    if (!bit)
+    {
+        return -ERANGE;
+    }
+
+    (void)__atomic_fetch_or(&service_watchdog_subscribers, bit, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @brief   Unsubscribe a service from MSG_ID_SYS_HANDLER_OVERRUN.
+ *
+ * @param   svc Pointer to the service handle.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Watchdog
+ */
+int32_t service_watchdog_unsubscribe(const service_t* svc)
+{
+    uint32_t bit;
+
+    if (!svc)
+    {
+        return -EINVAL;
+    }
+
+    bit = service_watchdog_bit(svc);
+    if (!bit)
+    {
+        return -ERANGE;
+    }
+
+    (void)__atomic_fetch_and(&service_watchdog_subscribers, ~bit, __ATOMIC_RELAXED);
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief   Get the handler budget statistics of one replica.
+ *
+ * @param   svc Pointer to the service handle, one replica of a replicated service.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, -ENOENT if the replica is not tracked.
+ */
+static int32_t service_watchdog_get_replica_stats(const service_t* svc,
+                                                  service_watchdog_stats_t* stats)
+{
+    const service_watchdog_state_t* state = service_watchdog_get_state(svc);
+
+    if (!state)
+    {
+        return -ENOENT;
+    }
+
+    stats->budget = service_watchdog_budget(svc);
+    stats->overruns = state->overruns;
+    stats->worst = state->worst;
+    stats->worst_id = state->worst_id;
+
+    return 0;
+}
+
+/**
+ * @brief   Get the handler budget statistics of a service.
+ *
+ * The replicas of a replicated service are summed, worst is the longest
+ * handler time of any of them.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   stats Output of the statistics.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Service_Watchdog
+ */
+int32_t service_watchdog_get_stats(const object* obj,
+                                   service_watchdog_stats_t* stats)
+{
+    service_watchdog_stats_t replica;
+    const service_t* svc;
+    uint32_t count;
+    uint32_t n;
+
+    if (!obj || !stats)
+    {
+        return -EINVAL;
+    }
+
+    svc = service_get_svc(obj);
+    if (service_watchdog_get_replica_stats(svc, stats))
+    {
+        return -ENOENT;
+    }
+
+    count = SERVICE_REPLICA_COUNT(svc);
+    for (n = 1; n < count; n++)
+    {
+        if (service_watchdog_get_replica_stats(&svc[n], &replica))
+        {
+            break;
+        }
+
+        stats->overruns += replica.overruns;
+        if (replica.worst > stats->worst)
+        {
+            stats->worst = replica.worst;
+            stats->worst_id = replica.worst_id;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Copy the most recent overrun records, newest first.
+ *
+ * @param   records Output array.
+ * @param   count Size of the output array.
+ *
+ * @retval  Returns the number of records copied.
+ *
+ * @ingroup Service_Watchdog
+ */
+uint32_t service_watchdog_get_records(service_watchdog_record_t* records,
+                                      uint32_t count)
+{
+    uint32_t head = __atomic_load_n(&service_watchdog_log_head, __ATOMIC_RELAXED);
+    uint32_t num = 0;
+    uint32_t i;
+
+    if (!records)
+    {
+        return 0;
+    }
+
+    /* A record being written or overwritten meanwhile is skipped. */
+    for (i = 0; num < count && i < head && i < CONFIG_SERVICE_WATCHDOG_LOG; i++)
+    {
+        if (!service_watchdog_read(head - 1 - i, &records[num]))
+        {
+            num++;
+        }
+    }
+
+    return num;
+}
+
+/**
+ * @brief   Dump the handler budget statistics and the overrun log.
+ *
+ * @ingroup Service_Watchdog
+ */
+void service_watchdog_dump(void)
+{
+    service_watchdog_record_t records[CONFIG_SERVICE_WATCHDOG_LOG];
+    service_watchdog_stats_t stats;
+    const service_t* svc;
+    uint32_t num;
+    uint32_t i;
+
+    for (svc = module_service$$Base; svc < module_service$$Limit; svc++)
+    {
+        if (!svc->owner || service_watchdog_get_replica_stats(svc, &stats))
+        {
+            continue;
+        }
+
+        pr_info("Service <%s> replica %u budget %u ms, overruns %u, worst %u ms by %s(0x%x).",
+                svc->owner->name,
+                SERVICE_REPLICA_INDEX(svc),
+                stats.budget,
+                stats.overruns,
+                stats.worst,
+                msg_id_to_str(stats.worst_id),
+                stats.worst_id);
+    }
+
+    num = service_watchdog_get_records(records, CONFIG_SERVICE_WATCHDOG_LOG);
+    for (i = 0; i < num; i++)
+    {
+        pr_info("Overrun at %u, <%s> %s(0x%x) %u ms%s.",
+                records[i].tick,
+                records[i].obj ? records[i].obj->name : "",
+                msg_id_to_str(records[i].id),
+                records[i].id,
+                records[i].duration,
+                records[i].running ? " and running" : "");
+    }
+}
+
+module_core("watchdog",
+            watchdog,
+            service_watchdog_probe,
+            NULL,
+            NULL,
+            NULL,
+            NULL);
+
+#endif /* CONFIG_SERVICE_WATCHDOG_ENABLE */
@@ -0,0 +1,703 @@
+/**
+ * @file source/src/transport_shm.c
+ * @brief Definition the shared memory transport.
+ * @author Peter.Peng <27144363@qq.com>
+ * @date 2022
+ *
+ * Embedded Device Software
+ * Copyright (C) 2022 Peter.Peng
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framework_conf.h"
+
+#if CONFIG_TRANSPORT_SHM_ENABLE
+
+#ifndef __linux__
+#error "The shared memory transport needs a Linux host."
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "cmsis_os.h"
+#include "framework.h"
+#include "msg_ring.h"
+#include "transport_shm.h"
+
+/**
+ * @defgroup Transport_Shm Shared Memory Transport
+ *
+ * @brief Reach services that live in another process.
+ *
+ * A service configured with SERVICE_FLAG_SHM_EXPORT gets a POSIX shared
+ * memory segment named CONFIG_TRANSPORT_SHM_PREFIX + service name instead
+ * of an RTOS queue. The segment holds a lock-free multi-producer ring of
+ * message_t slots: senders in any process write the message in place,
+ * the service thread dispatches it in place, and a futex word in the
+ * segment wakes the service thread when it sleeps on an empty ring.
+ *
+ * Other processes find the service through object_get_binding(), which
+ * maps the segment into a proxy object when the name is not local.
+ * Broadcasts stay inside the process, payload handles and pointers
+ * carried in the parameters are not valid across processes. A message
+ * id with framework flags, a payload, request or credit, is refused by
+ * the put like on a full ring, the sender releases what it holds.
+ *
+ * Only the process that creates a segment initializes it. A segment
+ * left behind by an exporting process that is gone is replaced, one of
+ * a running process, or one still being initialized, makes the export
+ * fail. Exporters replacing the same segment are serialized by a file
+ * lock on it. A segment left half initialized by an exporter that
+ * crashed is never replaced, it must be removed from /dev/shm by hand.
+ *
+ * A sender writes its process id in the slot it claims. If it dies
+ * before publishing the slot, the consumer finds the slot claimed for
+ * CONFIG_TRANSPORT_SHM_STALL_MS, checks the process is gone and skips the
+ * slot, so the ring does not wedge. A sender killed in the few
+ * instructions between the claim and the process id write still wedges
+ * the ring until the service exports it again.
+ *
+ * @ingroup Service_API
+ */
+
+#ifndef DOC_HIDDEN
+#define TRANSPORT_SHM_MAGIC     0x53484D31
+#define TRANSPORT_SHM_HDR_SIZE  64
+#endif
+
+/**
+ * @brief   Shared memory segment header, followed by the message ring.
+ */
+typedef struct
+{
+    uint32_t    magic;      /**< TRANSPORT_SHM_MAGIC once the ring is ready. */
+    uint32_t    size;       /**< Segment size in bytes. */
+    uint32_t    futex;      /**< Wake-up event counter. */
+    uint32_t    sleeping;   /**< The consumer is about to sleep on the futex. */
+    uint32_t    owner;      /**< Process id of the exporting process. */
+} transport_shm_hdr_t;
+
+/**
+ * @brief   Proxy for a service exported by another process.
+ */
+typedef struct
+{
+    object      obj;                                /**< Object returned by object_get_binding(). */
+    service_t   svc;                                /**< Service handle routed to the transport. */
+    uint32_t    state;                              /**< 0 free, 1 ready. */
+    char        name[CONFIG_TRANSPORT_SHM_NAME_MAX];    /**< Service name. */
+} transport_shm_proxy_t;
+
+/**
+ * @brief   Proxies of the remote services seen so far.
+ */
+static transport_shm_proxy_t transport_shm_proxies[CONFIG_TRANSPORT_SHM_PROXY_MAX];
+
+/**
+ * @brief   Non-zero while a thread looks up or maps a remote service.
+ */
+static uint32_t transport_shm_binding;
+
+/**
+ * @brief   Get the message ring of a segment.
+ *
+ * @param   hdr Pointer to the segment header.
+ *
+ * @retval  Returns the message ring.
+ */
+static msg_ring_t* transport_shm_ring(transport_shm_hdr_t* hdr)
+{
+    return (msg_ring_t*)((uint8_t*)hdr + TRANSPORT_SHM_HDR_SIZE);
+}
+
+/**
+ * @brief   Build the segment name of a service.
+ *
+ * @param   name Service name.
+ * @param   path Output buffer.
+ * @param   len Output buffer length.
+ */
+static void transport_shm_path(const char* name, char* path, uint32_t len)
+{
+    uint32_t prefix = sizeof(CONFIG_TRANSPORT_SHM_PREFIX) - 1;
+    uint32_t i;
+
+    (void)memcpy(path, CONFIG_TRANSPORT_SHM_PREFIX, prefix);
+
+    for (i = 0; name[i] && prefix + i < len - 1; i++)
+    {
+        path[prefix + i] = (name[i] == '/' || name[i] == ' ') ? '_' : name[i];
+    }
+
+    path[prefix + i] = '\0';
+}
+
+/**
+ * @brief   Convert a timeout in ticks to a relative timespec.
+ *
+ * @param   ticks Timeout in ticks.
+ * @param   ts Output of the timespec.
+ *
+ * @retval  Returns ts, or NULL for osWaitForever.
+ */
+static struct timespec* transport_shm_timespec(uint32_t ticks,
+                                               struct timespec* ts)
+{
+    uint32_t freq = osKernelGetTickFreq();
+    uint64_t us;
+
+    if (ticks == osWaitForever)
+    {
+        return NULL;
+    }
+
+    us = (uint64_t)ticks * 1000000 / (freq ? freq : 1000);
+
+    ts->tv_sec = (time_t)(us / 1000000);
+    ts->tv_nsec = (long)(us % 1000000) * 1000;
+
+    return ts;
+}
+
+/**
+ * @brief   Deliver a message into a shared memory ring.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Message structure to send.
+ * @param   timeout Timeout in ticks to wait for a free slot.
+ *
+ * @retval  Returns the RTOS status.
+ */
+static osStatus_t transport_shm_put(const service_t*    svc,
+                                    const message_t*    message,
+                                    uint32_t            timeout)
+{
+    transport_shm_hdr_t* hdr = (transport_shm_hdr_t*)svc->transport_ctx;
+    const struct timespec backoff = { 0, 100000 };
+    struct timespec ts;
+    struct timespec now;
+    struct timespec end;
+    msg_ring_slot_t* slot;
+
+    /* The references behind the flags stay in the sending process. */
+    if (message->id & MSG_ID_FLAGS_MASK)
+    {
+        return osErrorParameter;
+    }
+
+    slot = msg_ring_reserve(transport_shm_ring(hdr));
+    if (!slot && timeout)
+    {
+        (void)clock_gettime(CLOCK_MONOTONIC, &end);
+        if (transport_shm_timespec(timeout, &ts))
+        {
+            end.tv_sec += ts.tv_sec + (end.tv_nsec + ts.tv_nsec) / 1000000000;
+            end.tv_nsec = (end.tv_nsec + ts.tv_nsec) % 1000000000;
+        }
+
+        /* The consumer may be in another process, poll for a free slot. */
+        while (!(slot = msg_ring_reserve(transport_shm_ring(hdr))))
+        {
+            (void)clock_gettime(CLOCK_MONOTONIC, &now);
+            if (timeout != osWaitForever &&
+                (now.tv_sec > end.tv_sec ||
+                 (now.tv_sec == end.tv_sec && now.tv_nsec >= end.tv_nsec)))
+            {
+                break;
+            }
+
+            (void)nanosleep(&backoff, NULL);
+        }
+    }
+
+    if (!slot)
+    {
+        return timeout ? osErrorTimeout : osErrorResource;
+    }
+
+    /* Tells the consumer who to check if the slot is never published. */
+    __atomic_store_n(&slot->tag, (uint32_t)getpid(), __ATOMIC_RELAXED);
+    slot->message = *message;
+    msg_ring_commit(transport_shm_ring(hdr), slot);
+
+    /* Pairs with the fence in transport_shm_get(). */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&hdr->sleeping, __ATOMIC_RELAXED))
+    {
+        __atomic_add_fetch(&hdr->futex, 1, __ATOMIC_RELEASE);
+        (void)syscall(SYS_futex, &hdr->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+
+    return osOK;
+}
+
+/**
+ * @brief   Skip the oldest slot if its sender died before publishing it.
+ *
+ * @param   ring Pointer to the ring.
+ *
+ * @retval  Returns non-zero if a slot was skipped.
+ */
+static int32_t transport_shm_recover(msg_ring_t* ring)
+{
+    uint32_t pos = ring->tail;
+    msg_ring_slot_t* slot = &ring->slots[pos & ring->mask];
+    uint32_t pid;
+
+    /* Claimed, not published. */
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos)
+    {
+        return 0;
+    }
+
+    pid = __atomic_load_n(&slot->tag, __ATOMIC_RELAXED);
+    if (!pid || !kill((pid_t)pid, 0) || errno != ESRCH)
+    {
+        return 0;
+    }
+
+    pr_error("Sender %d died with a message slot claimed, slot skipped.", pid);
+
+    slot->tag = 0;
+    msg_ring_consume(ring, slot);
+
+    return 1;
+}
+
+/**
+ * @brief   Wait for the next message of an exported service.
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   timeout Timeout in ticks.
+ *
+ * @retval  Returns the message in its ring slot, or NULL on timeout.
+ */
+static message_t* transport_shm_get(const service_t* svc, uint32_t timeout)
+{
+    transport_shm_hdr_t* hdr = (transport_shm_hdr_t*)svc->transport_ctx;
+    msg_ring_t* ring = transport_shm_ring(hdr);
+    msg_ring_slot_t* slot;
+    struct timespec ts;
+    uint32_t stall = CONFIG_TRANSPORT_SHM_STALL_MS * osKernelGetTickFreq() / 1000;
+    uint32_t wait;
+    uint32_t event;
+
+    while (1)
+    {
+        slot = msg_ring_peek(ring);
+        if (slot)
+        {
+            return &slot->message;
+        }
+
+        if (!timeout)
+        {
+            return NULL;
+        }
+
+        /* A claimed slot is published soon, or its sender is gone, check back. */
+        wait = timeout;
+        if (msg_ring_count(ring) && (wait == osWaitForever || wait > stall))
+        {
+            wait = stall ? stall : 1;
+        }
+
+        event = __atomic_load_n(&hdr->futex, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&hdr->sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        slot = msg_ring_peek(ring);
+        if (slot)
+        {
+            __atomic_store_n(&hdr->sleeping, 0, __ATOMIC_RELAXED);
+            return &slot->message;
+        }
+
+        if (syscall(SYS_futex, &hdr->futex, FUTEX_WAIT, event,
+                    transport_shm_timespec(wait, &ts), NULL, 0) &&
+            wait != osWaitForever &&
+            __atomic_load_n(&hdr->futex, __ATOMIC_ACQUIRE) == event)
+        {
+            __atomic_store_n(&hdr->sleeping, 0, __ATOMIC_RELAXED);
+
+            if (wait == timeout)
+            {
+                return NULL;
+            }
+
+            if (timeout != osWaitForever)
+            {
+                timeout -= wait;
+            }
+
+            (void)transport_shm_recover(ring);
+            continue;
+        }
+
+        __atomic_store_n(&hdr->sleeping, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief   Give back the ring slot returned by transport_shm_get().
+ *
+ * @param   svc Pointer to the service handle.
+ * @param   message Pointer to the message in the slot.
+ */
+static void transport_shm_release(const service_t* svc, message_t* message)
+{
+    transport_shm_hdr_t* hdr = (transport_shm_hdr_t*)svc->transport_ctx;
+    msg_ring_slot_t* slot = (msg_ring_slot_t*)((uint8_t*)message -
+                                               offsetof(msg_ring_slot_t,
+                                                        message));
+
+    slot->tag = 0;
+    msg_ring_consume(transport_shm_ring(hdr), slot);
+}
+
+/**
+ * @brief   Shared memory transport operations.
+ */
+static const service_transport_t transport_shm =
+{
+    .put        = transport_shm_put,
+    .get        = transport_shm_get,
+    .release    = transport_shm_release,
+};
+
+/**
+ * @brief   Remove a segment whose exporting process is gone.
+ *
+ * Only a ready segment whose owner process does not exist is removed. A
+ * segment smaller than the header or without the magic may be one an
+ * exporter is still initializing, it is left alone.
+ *
+ * @param   path Segment name.
+ *
+ * @retval  Returns 0 if the segment was removed, -EEXIST if it is in use.
+ */
+static int32_t transport_shm_reclaim(const char* path)
+{
+    transport_shm_hdr_t* hdr;
+    struct stat st;
+    int32_t ret = -EEXIST;
+    int fd;
+
+    fd = shm_open(path, O_RDWR, 0600);
+    if (fd < 0)
+    {
+        /* Removed in the meantime. */
+        return 0;
+    }
+
+    /* Another exporter may be on the same segment, one at a time. */
+    if (flock(fd, LOCK_EX) || fstat(fd, &st))
+    {
+        (void)close(fd);
+        return -EEXIST;
+    }
+
+    /* Removed by the exporter before us, the name is free or taken again. */
+    if (!st.st_nlink)
+    {
+        (void)close(fd);
+        return 0;
+    }
+
+    if (st.st_size >= TRANSPORT_SHM_HDR_SIZE)
+    {
+        hdr = mmap(NULL, TRANSPORT_SHM_HDR_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if (hdr != MAP_FAILED)
+        {
+            if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == TRANSPORT_SHM_MAGIC &&
+                hdr->owner &&
+                kill((pid_t)hdr->owner, 0) && errno == ESRCH)
+            {
+                (void)shm_unlink(path);
+                ret = 0;
+            }
+
+            (void)munmap(hdr, TRANSPORT_SHM_HDR_SIZE);
+        }
+    }
+
+    /* Unlinked under the lock, a concurrent exporter sees no link count. */
+    (void)close(fd);
+
+    return ret;
+}
+
+/**
+ * @brief   Export the queue of a local service as a shared memory ring.
+ *
+ * Called by the service initialization for services configured with
+ * SERVICE_FLAG_SHM_EXPORT, the ring has config->msg_count slots
+ * rounded up to a power of two.
+ *
+ * @param   obj Pointer to the service object handle.
+ * @param   config Pointer to the service configuration.
+ *
+ * @retval  Returns 0 on success, negative error code otherwise.
+ *
+ * @ingroup Transport_Shm
+ */
+int32_t transport_shm_export(const object*                  obj,
+                             const service_config_t* const  config)
+{
+    service_t* svc = (service_t*)obj->object_data;
+    char path[sizeof(CONFIG_TRANSPORT_SHM_PREFIX) + CONFIG_TRANSPORT_SHM_NAME_MAX];
+    transport_shm_hdr_t* hdr;
+    uint32_t size;
+    int fd;
+
+    size = TRANSPORT_SHM_HDR_SIZE + msg_ring_mem_size(config->msg_count);
+
+    transport_shm_path(obj->name, path, sizeof(path));
+
+    /* Never initialize a ring a running peer works on. */
+    fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        if (transport_shm_reclaim(path))
+        {
+            pr_error("Service <%s> is exported by a running process.", obj->name);
+            return -EEXIST;
+        }
+
+        fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            return -EACCES;
+        }
+    }
+
+    if (ftruncate(fd, size))
+    {
+        (void)close(fd);
+        (void)shm_unlink(path);
+        return -ENOMEM;
+    }
+
+    hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    (void)close(fd);
+    if (hdr == MAP_FAILED)
+    {
+        (void)shm_unlink(path);
+        return -ENOMEM;
+    }
+
+    hdr->size = size;
+    hdr->futex = 0;
+    hdr->sleeping = 0;
+    hdr->owner = (uint32_t)getpid();
+    (void)msg_ring_init(transport_shm_ring(hdr), config->msg_count);
+    __atomic_store_n(&hdr->magic, TRANSPORT_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    svc->transport_ctx = hdr;
+    svc->transport = &transport_shm;
+
+    pr_info("Service <%s> exported as %s, %d bytes.", obj->name, path, size);
+
+    return 0;
+}
+
+/**
+ * @brief   Remove the shared memory ring of a local service.
+ *
+ * @param   obj Pointer to the service object handle.
+ *
+ * @ingroup Transport_Shm
+ */
+void transport_shm_unexport(const object* obj)
+{
+    service_t* svc = (service_t*)obj->object_data;
+    transport_shm_hdr_t* hdr = (transport_shm_hdr_t*)svc->transport_ctx;
+    char path[sizeof(CONFIG_TRANSPORT_SHM_PREFIX) + CONFIG_TRANSPORT_SHM_NAME_MAX];
+
+    if (!hdr)
+    {
+        return;
+    }
+
+    transport_shm_path(obj->name, path, sizeof(path));
+
+    __atomic_store_n(&hdr->magic, 0, __ATOMIC_RELEASE);
+    (void)shm_unlink(path);
+    (void)munmap(hdr, hdr->size);
+
+    svc->transport = NULL;
+    svc->transport_ctx = NULL;
+}
+
+/**
+ * @brief   Find the ready proxy of a remote service.
+ *
+ * @param   name Service name.
+ *
+ * @retval  Returns the proxy object, or NULL if the name is not mapped yet.
+ */
+static const object* transport_shm_find(const char* const name)
+{
+    transport_shm_proxy_t* proxy;
+    uint32_t i;
+
+    for (i = 0; i < CONFIG_TRANSPORT_SHM_PROXY_MAX; i++)
+    {
+        proxy = &transport_shm_proxies[i];
+        if (__atomic_load_n(&proxy->state, __ATOMIC_ACQUIRE) &&
+            !strcmp(proxy->name, name))
+        {
+            return &proxy->obj;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Map the segment of a remote service into a free proxy.
+ *
+ * The caller holds transport_shm_binding.
+ *
+ * @param   name Service name.
+ *
+ * @retval  Returns the proxy object, or NULL if no process exports the name.
+ */
+static const object* transport_shm_map(const char* const name)
+{
+    char path[sizeof(CONFIG_TRANSPORT_SHM_PREFIX) + CONFIG_TRANSPORT_SHM_NAME_MAX];
+    transport_shm_proxy_t* proxy;
+    transport_shm_hdr_t* hdr;
+    struct stat st;
+    uint32_t i;
+    int fd;
+
+    transport_shm_path(name, path, sizeof(path));
+
+    fd = shm_open(path, O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) || st.st_size < TRANSPORT_SHM_HDR_SIZE)
+    {
+        (void)close(fd);
+        return NULL;
+    }
+
+    hdr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+               fd, 0);
+    (void)close(fd);
+    if (hdr == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != TRANSPORT_SHM_MAGIC)
+    {
+        (void)munmap(hdr, (size_t)st.st_size);
+        return NULL;
+    }
+
+    for (i = 0; i < CONFIG_TRANSPORT_SHM_PROXY_MAX; i++)
+    {
+        proxy = &transport_shm_proxies[i];
+
+        if (!__atomic_load_n(&proxy->state, __ATOMIC_RELAXED))
+        {
+            const object obj =
+            {
+                .name           = proxy->name,
+                .object_intf    = &service_intf,
+                .object_data    = &proxy->svc,
+            };
+
+            (void)strcpy(proxy->name, name);
+            (void)memcpy((void*)&proxy->obj, &obj, sizeof(obj));
+
+            (void)memset(&proxy->svc, 0, sizeof(proxy->svc));
+            proxy->svc.owner = &proxy->obj;
+            proxy->svc.transport = &transport_shm;
+            proxy->svc.transport_ctx = hdr;
+
+            __atomic_store_n(&proxy->state, 1, __ATOMIC_RELEASE);
+
+            return &proxy->obj;
+        }
+    }
+
+    pr_error("No proxy left for remote service <%s>.", name);
+    (void)munmap(hdr, (size_t)st.st_size);
+
+    return NULL;
+}
+
+/**
+ * @brief   Get the proxy of a service exported by another process.
+ *
+ * Called by object_get_binding() when the name is not a local object.
+ * Threads binding at the same time are serialized, so a name is mapped
+ * into one proxy only.
+ *
+ * @param   name Service name.
+ *
+ * @retval  Object handle for reference or NULL if no process exports the name.
+ *
+ * @ingroup Transport_Shm
+ */
+const object* transport_shm_get_binding(const char* const name)
+{
+    const object* obj;
+
+    if (!name || strlen(name) >= CONFIG_TRANSPORT_SHM_NAME_MAX)
+    {
+        return NULL;
+    }
+
+    obj = transport_shm_find(name);
+    if (obj)
+    {
+        return obj;
+    }
+
+    while (__atomic_exchange_n(&transport_shm_binding, 1, __ATOMIC_ACQUIRE))
+    {
+        (void)osDelay(1);
+    }
+
+    /* Mapped by the thread that held the lock before us. */
+    obj = transport_shm_find(name);
+    if (!obj)
+    {
+        obj = transport_shm_map(name);
+    }
+
+    __atomic_store_n(&transport_shm_binding, 0, __ATOMIC_RELEASE);
+
+    return obj;
+}
+
+#endif /* CONFIG_TRANSPORT_SHM_ENABLE */